@@ -19,27 +19,81 @@
 #include "enrichmentcalculator.h"
 
 #include <cmath>
-#include <set>
+#include <algorithm>
 #include <vector>
 #include <map>
-#include <random>
-#include <array>
+#include <atomic>
+#include <numeric>
 
 #include "shared/graph/igraphmodel.h"
 #include "shared/graph/igraph.h"
 #include "shared/commands/icommandmanager.h"
 
 #include "shared/utils/container.h"
+#include "shared/utils/threadpool.h"
 #include "shared/attributes/iattribute.h"
 
-static double combineLogs(double n, double r)
+namespace
 {
-    return std::lgamma(n + 1) - std::lgamma(r + 1) - std::lgamma(n - r + 1);
+// Each node's value is coded as the index of that value in sorted order,
+// so that counting doesn't involve any further string comparisons
+struct CodedAttribute
+{
+    std::vector<QString> _values;
+    std::vector<int> _codes;
+    std::vector<int> _counts;
+};
+
+CodedAttribute codeAttribute(const IAttribute* attribute, const std::vector<NodeId>& nodeIds)
+{
+    std::map<QString, int> valueIndices;
+    std::vector<std::map<QString, int>::iterator> nodeValues;
+    nodeValues.reserve(nodeIds.size());
+
+    for(auto nodeId : nodeIds)
+        nodeValues.push_back(valueIndices.emplace(attribute->stringValueOf(nodeId), 0).first);
+
+    CodedAttribute codedAttribute;
+    codedAttribute._values.reserve(valueIndices.size());
+
+    for(auto& [value, index] : valueIndices)
+    {
+        index = static_cast<int>(codedAttribute._values.size());
+        codedAttribute._values.push_back(value);
+    }
+
+    codedAttribute._counts.resize(valueIndices.size(), 0);
+    codedAttribute._codes.reserve(nodeValues.size());
+
+    for(const auto& it : nodeValues)
+    {
+        codedAttribute._codes.push_back(it->second);
+        codedAttribute._counts.at(static_cast<size_t>(it->second))++;
+    }
+
+    return codedAttribute;
 }
+} // namespace
+
+std::vector<double> EnrichmentCalculator::logFactorials(int n)
+{
+    std::vector<double> table(static_cast<size_t>(std::max(n, 0)) + 1, 0.0);
+
+    for(size_t i = 2; i < table.size(); i++)
+        table[i] = table[i - 1] + std::log(static_cast<double>(i));
 
-static double hyperGeometricProb(double x, double r1, double r2, double c1, double c2)
+    return table;
+}
+
+static double combineLogs(const std::vector<double>& logFactorials, int n, int r)
+{
+    return logFactorials[static_cast<size_t>(n)] - logFactorials[static_cast<size_t>(r)] -
+        logFactorials[static_cast<size_t>(n - r)];
+}
+
+double EnrichmentCalculator::fishers(int a, int b, int c, int d)
 {
-    return std::exp(combineLogs(r1, x) + combineLogs(r2, c1 - x) - combineLogs( c1 + c2, c1));
+    return fishers(a, b, c, d, logFactorials(a + b + c + d));
 }
 
 /*
@@ -48,25 +102,33 @@ static double hyperGeometricProb(double x, double r1, double r2, double c1, doub
  *  C: Selected NOT In Category
  *  D: Not Selected NOT In Category
  */
-double EnrichmentCalculator::fishers(int a, int b, int c, int d)
+double EnrichmentCalculator::fishers(int a, int b, int c, int d, const std::vector<double>& logFactorials)
 {
-    double ab = a + b;
-    double cd = c + d;
-    double ac = a + c;
-    double bd = b + d;
+    int ab = a + b;
+    int cd = c + d;
+    int ac = a + c;
+
+    Q_ASSERT(static_cast<size_t>(ab + cd) < logFactorials.size());
 
     double twoPval   = 0.0;
 
     // range of variation
-    double lm = (ac < cd) ? 0.0 : ac - cd;
-    double um = (ac < ab) ? ac  : ab;
+    int lm = (ac < cd) ? 0 : ac - cd;
+    int um = (ac < ab) ? ac : ab;
+
+    auto logDenominator = combineLogs(logFactorials, ab + cd, ac);
+    auto hyperGeometricProb = [&](int x)
+    {
+        return std::exp(combineLogs(logFactorials, ab, x) +
+            combineLogs(logFactorials, cd, ac - x) - logDenominator);
+    };
 
     // Fisher's exact test
-    double crit = hyperGeometricProb(a, ab, cd, ac, bd);
+    double crit = hyperGeometricProb(a);
 
-    for(auto x = static_cast<int>(lm); x <= static_cast<int>(um); x++)
+    for(auto x = lm; x <= um; x++)
     {
-        double prob = hyperGeometricProb(x, ab, cd, ac, bd);
+        double prob = hyperGeometricProb(x);
 
         if(prob <= crit)
             twoPval += prob;
@@ -79,128 +141,76 @@ EnrichmentTableModel::Table EnrichmentCalculator::overRepAgainstEachAttribute(
     const QString& attributeAName, const QString& attributeBName,
     IGraphModel* graphModel, ICommand& command)
 {
-    // Count of attribute values within the attribute
-    std::map<QString, int> attributeValueEntryCountATotal;
-    std::map<QString, int> attributeValueEntryCountBTotal;
-    EnrichmentTableModel::Table tableModel;
-
-    for(auto nodeId : graphModel->graph().nodeIds())
-    {
-        const auto* attributeA = graphModel->attributeByName(attributeAName);
-        const auto* attributeB = graphModel->attributeByName(attributeBName);
-        const auto& stringAttributeA = attributeA->stringValueOf(nodeId);
-        const auto& stringAttributeB = attributeB->stringValueOf(nodeId);
-        ++attributeValueEntryCountATotal[stringAttributeA];
-        ++attributeValueEntryCountBTotal[stringAttributeB];
-    }
-
-    // Comparing
-
-    uint64_t progress = 0;
-    auto iterations = static_cast<uint64_t>(attributeValueEntryCountBTotal.size() *
-        attributeValueEntryCountATotal.size());
-
-    // Get all the nodeIds for each AttributeFor value
-    // Maps of vectors uhoh.
     const auto* attributeA = graphModel->attributeByName(attributeAName);
     const auto* attributeB = graphModel->attributeByName(attributeBName);
+    const auto& nodeIds = graphModel->graph().nodeIds();
+    auto n = graphModel->graph().numNodes();
+
+    if(n == 0)
+        return {};
 
-    std::map<QString, std::vector<NodeId>> nodeIdsForAttributeValue;
-    for(auto nodeId : graphModel->graph().nodeIds())
-        nodeIdsForAttributeValue[attributeA->stringValueOf(nodeId)].push_back(nodeId);
+    auto codedA = codeAttribute(attributeA, nodeIds);
+    auto codedB = codeAttribute(attributeB, nodeIds);
+    auto numValuesA = codedA._values.size();
+    auto numValuesB = codedB._values.size();
 
-    for(auto& attributeValueA : u::keysFor(attributeValueEntryCountATotal))
+    // Contingency table of A value against B value, built in one pass
+    std::vector<int> observed(numValuesA * numValuesB, 0);
+    for(size_t i = 0; i < nodeIds.size(); i++)
     {
-        auto& selectedNodes = nodeIdsForAttributeValue[attributeValueA];
-
-        for(auto& attributeValueB : u::keysFor(attributeValueEntryCountBTotal))
-        {
-            EnrichmentTableModel::Row row(EnrichmentTableModel::Results::NumResultColumns);
-            command.setProgress(static_cast<int>(progress * 100U / iterations));
-            progress++;
-
-            auto n = graphModel->graph().numNodes();
-
-            int selectedInCategory = 0;
-            for(auto nodeId : selectedNodes)
-            {
-                if(attributeB->stringValueOf(nodeId) == attributeValueB)
-                    selectedInCategory++;
-            }
-
-            int r1 = attributeValueEntryCountBTotal[attributeValueB];
-            auto fexp = static_cast<double>(r1) / static_cast<double>(n);
-            auto stdevs = doRandomSampling(static_cast<int>(selectedNodes.size()), fexp);
-
-            auto expectedNo = (static_cast<double>(r1) / n) * selectedNodes.size();
-            auto expectedDev = stdevs[0] * static_cast<double>(selectedNodes.size());
-
-            auto nonSelectedInCategory = r1 - selectedInCategory;
-            auto c1 = static_cast<int>(selectedNodes.size());
-            auto selectedNotInCategory = c1 - selectedInCategory;
-            auto c2 = n - c1;
-            auto nonSelectedNotInCategory = c2 - nonSelectedInCategory;
-            auto f = fishers(selectedInCategory, nonSelectedInCategory, selectedNotInCategory, nonSelectedNotInCategory);
-
-            row[EnrichmentTableModel::Results::SelectionA] = attributeValueA;
-            row[EnrichmentTableModel::Results::SelectionB] = attributeValueB;
-            row[EnrichmentTableModel::Results::Observed] =
-                QString::number(selectedInCategory) + " / " + QString::number(selectedNodes.size());
-            row[EnrichmentTableModel::Results::ExpectedTrial] =
-                QString::number(expectedNo, 'f', 2) + " ± " +
-                QString::number(expectedDev) + " / " + QString::number(selectedNodes.size());
-            row[EnrichmentTableModel::Results::OverRep] = selectedInCategory / expectedNo;
-            row[EnrichmentTableModel::Results::Fishers] = f;
-            row[EnrichmentTableModel::Results::AdjustedFishers] = f * attributeValueEntryCountBTotal.size();
-
-            tableModel.push_back(row);
-        }
+        auto cell = static_cast<size_t>(codedA._codes[i]) * numValuesB +
+            static_cast<size_t>(codedB._codes[i]);
+        observed[cell]++;
     }
 
-    return tableModel;
-}
+    const auto logFactorialTable = logFactorials(n);
 
-std::vector<double> EnrichmentCalculator::doRandomSampling(int sampleCount, double expectedFrequency)
-{
-    const int NUMBER_OF_TRIALS = 1000;
-    std::array<double, NUMBER_OF_TRIALS> observed{};
-    std::array<double, NUMBER_OF_TRIALS> overRepresentation{};
-    double observationAvg = 0.0;
-    double overRepresentationAvg = 0.0;
-    double observationStdDev = 0.0;
-    double overRepresentationStdDev = 0.0;
-
-    std::random_device rd;
-    auto seededGenerator = std::mt19937(rd());
-    auto distribution = std::uniform_real_distribution<>(0.0f, 1.0f);
-
-    for(int i = 0; i < NUMBER_OF_TRIALS; i++)
-    {
-        int hits = 0;
-        for(int j = 0; j < sampleCount; j++)
-        {
-            if(static_cast<double>(distribution(seededGenerator)) <= expectedFrequency)
-                hits++;
-        }
-
-        observed.at(i) = hits / static_cast<double>(sampleCount);
-        overRepresentation.at(i) = observed.at(i) / expectedFrequency;
-        observationAvg += observed.at(i);
-        overRepresentationAvg += overRepresentation.at(i);
-    }
+    EnrichmentTableModel::Table tableModel(observed.size(),
+        EnrichmentTableModel::Row(EnrichmentTableModel::Results::NumResultColumns));
 
-    observationAvg = observationAvg / static_cast<double>(NUMBER_OF_TRIALS);
-    overRepresentationAvg = overRepresentationAvg / static_cast<double>(NUMBER_OF_TRIALS);
+    std::vector<size_t> cells(observed.size());
+    std::iota(cells.begin(), cells.end(), 0);
 
-    for(int i = 0; i < NUMBER_OF_TRIALS; i++)
-    {
-        observationStdDev += (observed.at(i) - observationAvg) * (observed.at(i) - observationAvg);
-        overRepresentationStdDev += (overRepresentation.at(i) - overRepresentationAvg) * (overRepresentation.at(i) - overRepresentationAvg);
-    }
+    std::atomic_int progress(0);
 
-    observationStdDev = std::sqrt(observationStdDev / static_cast<double>(NUMBER_OF_TRIALS));
-    overRepresentationStdDev = std::sqrt(overRepresentationStdDev / static_cast<double>(NUMBER_OF_TRIALS));
+    concurrent_for(cells.begin(), cells.end(), [&](size_t cell)
+    {
+        auto valueIndexA = cell / numValuesB;
+        auto valueIndexB = cell % numValuesB;
+
+        auto c1 = codedA._counts[valueIndexA];
+        auto r1 = codedB._counts[valueIndexB];
+        auto selectedInCategory = observed[cell];
+
+        // Under the null model each of the c1 selected nodes is in the category with
+        // probability r1 / n, so the number in it is binomially distributed
+        auto fexp = static_cast<double>(r1) / static_cast<double>(n);
+        auto expectedNo = fexp * c1;
+        auto expectedDev = std::sqrt(expectedNo * (1.0 - fexp));
+
+        auto nonSelectedInCategory = r1 - selectedInCategory;
+        auto selectedNotInCategory = c1 - selectedInCategory;
+        auto c2 = n - c1;
+        auto nonSelectedNotInCategory = c2 - nonSelectedInCategory;
+        auto f = fishers(selectedInCategory, nonSelectedInCategory, selectedNotInCategory,
+            nonSelectedNotInCategory, logFactorialTable);
+
+        auto& row = tableModel[cell];
+        row[EnrichmentTableModel::Results::SelectionA] = codedA._values[valueIndexA];
+        row[EnrichmentTableModel::Results::SelectionB] = codedB._values[valueIndexB];
+        row[EnrichmentTableModel::Results::Observed] =
+            QString::number(selectedInCategory) + " / " + QString::number(c1);
+        row[EnrichmentTableModel::Results::ExpectedTrial] =
+            QString::number(expectedNo, 'f', 2) + " ± " +
+            QString::number(expectedDev) + " / " + QString::number(c1);
+        row[EnrichmentTableModel::Results::OverRep] = selectedInCategory / expectedNo;
+        row[EnrichmentTableModel::Results::Fishers] = f;
+        row[EnrichmentTableModel::Results::AdjustedFishers] = f * static_cast<double>(numValuesB);
+
+        command.setProgress(++progress * 100 / static_cast<int>(cells.size()));
+    });
+
+    command.setProgress(-1);
 
-    return { observationStdDev, overRepresentationStdDev, observationAvg, overRepresentationAvg };
+    return tableModel;
 }
-
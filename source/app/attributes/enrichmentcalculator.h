@@ -29,8 +29,11 @@ class ICommand;
 class EnrichmentCalculator
 {
 public:
+    // log(i!) for each i in [0, n]
+    static std::vector<double> logFactorials(int n);
+
     static double fishers(int a, int b, int c, int d);
-    static std::vector<double> doRandomSampling(int sampleCount, double expectedFrequency);
+    static double fishers(int a, int b, int c, int d, const std::vector<double>& logFactorials);
     static EnrichmentTableModel::Table overRepAgainstEachAttribute(const QString& attributeAName,
         const QString& attributeBName, IGraphModel* graphModel, ICommand& command);
 };
@@ -0,0 +1,76 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "adjacencysnapshot.h"
+
+#include "graph.h"
+
+#include <algorithm>
+#include <numeric>
+
+AdjacencySnapshot::AdjacencySnapshot(const Graph& graph, const EdgeWeightFn& edgeWeightFn) :
+    _nodeIds(graph.nodeIds())
+{
+    int maxNodeId = -1;
+    for(auto nodeId : _nodeIds)
+        maxNodeId = std::max(maxNodeId, static_cast<int>(nodeId));
+
+    _indices.assign(static_cast<size_t>(maxNodeId + 1), -1);
+    for(int index = 0; index < numNodes(); index++)
+        _indices[static_cast<size_t>(static_cast<int>(_nodeIds[index]))] = index;
+
+    // Count the degrees, then prefix sum them into offsets
+    _offsets.assign(_nodeIds.size() + 1, 0);
+    for(auto edgeId : graph.edgeIds())
+    {
+        const auto& edge = graph.edgeById(edgeId);
+        _offsets[indexOf(edge.sourceId()) + 1]++;
+        _offsets[indexOf(edge.targetId()) + 1]++;
+    }
+
+    std::partial_sum(_offsets.begin(), _offsets.end(), _offsets.begin());
+
+    auto numEntries = static_cast<size_t>(_offsets.back());
+    _neighbours.resize(numEntries);
+    _edgeIds.resize(numEntries);
+
+    if(edgeWeightFn)
+        _weights.resize(numEntries);
+
+    std::vector<int> cursors(_offsets.begin(), _offsets.end() - 1);
+    auto append = [&](int index, int neighbour, EdgeId edgeId, float weight)
+    {
+        auto i = static_cast<size_t>(cursors[index]++);
+        _neighbours[i] = neighbour;
+        _edgeIds[i] = edgeId;
+
+        if(!_weights.empty())
+            _weights[i] = weight;
+    };
+
+    for(auto edgeId : graph.edgeIds())
+    {
+        const auto& edge = graph.edgeById(edgeId);
+        auto sourceIndex = indexOf(edge.sourceId());
+        auto targetIndex = indexOf(edge.targetId());
+        float weight = edgeWeightFn ? edgeWeightFn(edgeId) : 1.0f;
+
+        append(sourceIndex, targetIndex, edgeId, weight);
+        append(targetIndex, sourceIndex, edgeId, weight);
+    }
+}
@@ -0,0 +1,99 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ADJACENCYSNAPSHOT_H
+#define ADJACENCYSNAPSHOT_H
+
+#include "shared/graph/elementid.h"
+#include "shared/utils/iterator_range.h"
+
+#include <QtGlobal>
+
+#include <vector>
+#include <functional>
+
+class Graph;
+
+// An immutable compressed sparse row representation of a Graph's adjacency,
+// for algorithms that only need to traverse it. Nodes are assigned contiguous
+// indices in the order of Graph::nodeIds(); each edge appears in the adjacency
+// of both its source and target, so a node's degree here matches INode::degree()
+class AdjacencySnapshot
+{
+public:
+    using EdgeWeightFn = std::function<float(EdgeId)>;
+
+    explicit AdjacencySnapshot(const Graph& graph, const EdgeWeightFn& edgeWeightFn = {});
+
+    int numNodes() const { return static_cast<int>(_nodeIds.size()); }
+    int numEntries() const { return static_cast<int>(_neighbours.size()); }
+
+    const std::vector<NodeId>& nodeIds() const { return _nodeIds; }
+    NodeId nodeIdAt(int index) const { return _nodeIds[index]; }
+
+    // Returns -1 if nodeId isn't in the snapshot
+    int indexOf(NodeId nodeId) const
+    {
+        auto i = static_cast<size_t>(static_cast<int>(nodeId));
+        return !nodeId.isNull() && i < _indices.size() ? _indices[i] : -1;
+    }
+
+    int degree(int index) const { return _offsets[index + 1] - _offsets[index]; }
+
+    auto neighbours(int index) const
+    {
+        return make_iterator_range(_neighbours.data() + _offsets[index],
+            _neighbours.data() + _offsets[index + 1]);
+    }
+
+    auto edgeIds(int index) const
+    {
+        return make_iterator_range(_edgeIds.data() + _offsets[index],
+            _edgeIds.data() + _offsets[index + 1]);
+    }
+
+    // True if other has the same nodes, adjacent to each other in the same order
+    bool sameStructureAs(const AdjacencySnapshot& other) const
+    {
+        return _nodeIds == other._nodeIds &&
+            _offsets == other._offsets &&
+            _neighbours == other._neighbours;
+    }
+
+    bool weighted() const { return !_weights.empty(); }
+
+    auto weights(int index) const
+    {
+        Q_ASSERT(weighted());
+        return make_iterator_range(_weights.data() + _offsets[index],
+            _weights.data() + _offsets[index + 1]);
+    }
+
+private:
+    std::vector<NodeId> _nodeIds;
+    std::vector<int> _indices;
+
+    // The adjacency of node i is the range [_offsets[i], _offsets[i + 1])
+    // in each of _neighbours, _edgeIds and _weights (if present)
+    std::vector<int> _offsets;
+    std::vector<int> _neighbours;
+    std::vector<EdgeId> _edgeIds;
+    std::vector<float> _weights;
+};
+
+#endif // ADJACENCYSNAPSHOT_H
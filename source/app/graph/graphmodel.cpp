@@ -58,8 +58,8 @@
 #include "ui/visualisations/visualisationconfigparser.h"
 #include "ui/visualisations/visualisationbuilder.h"
 #include "ui/visualisations/visualisationinfo.h"
-#include "ui/visualisations/elementvisual.h"
 
+#include "shared/ui/visualisations/elementvisual.h"
 #include "shared/plugins/iplugin.h"
 #include "shared/commands/icommand.h"
 
@@ -69,9 +69,11 @@
 #include "shared/utils/pair_iterator.h"
 #include "shared/utils/flags.h"
 #include "shared/utils/string.h"
+#include "shared/utils/stringtable.h"
 
 #include <QRegularExpression>
 
+#include <mutex>
 #include <utility>
 
 using NodeVisuals = NodeArray<ElementVisual>;
@@ -84,7 +86,6 @@ class GraphModelImpl
 public:
     explicit GraphModelImpl(GraphModel& graphModel) :
         _transformedGraph(graphModel, _graph),
-        _nodePositions(_graph),
         _nodeVisuals(_graph),
         _edgeVisuals(_graph),
         _mappedNodeVisuals(_graph),
@@ -104,6 +105,11 @@ private:
     EdgeVisuals _mappedEdgeVisuals;
     VisualisationInfosMap _visualisationInfos;
 
+    // Text visuals refer to their strings by handle
+    StringTable _visualStrings;
+    StringTable::Snapshot _visualStringsSnapshot;
+    mutable std::mutex _visualStringsSnapshotMutex;
+
     NodeArray<QString> _nodeNames;
 
     std::map<QString, Attribute> _attributes;
@@ -209,6 +215,8 @@ GraphModel::GraphModel(QString name, IPlugin* plugin) :
     _->_graphTransformFactories.emplace(tr("MCL Cluster"),              std::make_unique<MCLTransformFactory>(this));
     _->_graphTransformFactories.emplace(tr("Louvain Cluster"),          std::make_unique<LouvainTransformFactory>(this));
     _->_graphTransformFactories.emplace(tr("Weighted Louvain Cluster"), std::make_unique<WeightedLouvainTransformFactory>(this));
+    _->_graphTransformFactories.emplace(tr("Leiden Cluster"),           std::make_unique<LeidenTransformFactory>(this));
+    _->_graphTransformFactories.emplace(tr("Weighted Leiden Cluster"),  std::make_unique<WeightedLeidenTransformFactory>(this));
     _->_graphTransformFactories.emplace(tr("PageRank"),                 std::make_unique<PageRankTransformFactory>(this));
     _->_graphTransformFactories.emplace(tr("Eccentricity"),             std::make_unique<EccentricityTransformFactory>(this));
     _->_graphTransformFactories.emplace(tr("Betweenness"),              std::make_unique<BetweennessTransformFactory>(this));
@@ -227,7 +235,7 @@ GraphModel::GraphModel(QString name, IPlugin* plugin) :
 
     _->_visualisationChannels.emplace(tr("Colour"), std::make_unique<ColorVisualisationChannel>());
     _->_visualisationChannels.emplace(tr("Size"), std::make_unique<SizeVisualisationChannel>());
-    _->_visualisationChannels.emplace(tr("Text"), std::make_unique<TextVisualisationChannel>());
+    _->_visualisationChannels.emplace(tr("Text"), std::make_unique<TextVisualisationChannel>(_->_visualStrings));
 }
 
 GraphModel::~GraphModel() // NOLINT
@@ -278,8 +286,8 @@ IMutableGraph& GraphModel::mutableGraphImpl() { return mutableGraph(); }
 const IMutableGraph& GraphModel::mutableGraphImpl() const { return mutableGraph(); }
 const IGraph& GraphModel::graphImpl() const { return graph(); }
 
-const IElementVisual& GraphModel::nodeVisualImpl(NodeId nodeId) const { return nodeVisual(nodeId); }
-const IElementVisual& GraphModel::edgeVisualImpl(EdgeId edgeId) const { return edgeVisual(edgeId); }
+const ElementVisual& GraphModel::nodeVisualImpl(NodeId nodeId) const { return nodeVisual(nodeId); }
+const ElementVisual& GraphModel::edgeVisualImpl(EdgeId edgeId) const { return edgeVisual(edgeId); }
 
 MutableGraph& GraphModel::mutableGraph() { return _->_graph; }
 const MutableGraph& GraphModel::mutableGraph() const { return _->_graph; }
@@ -288,6 +296,12 @@ const Graph& GraphModel::graph() const { return _->_transformedGraph; }
 const ElementVisual& GraphModel::nodeVisual(NodeId nodeId) const { return _->_nodeVisuals.at(nodeId); }
 const ElementVisual& GraphModel::edgeVisual(EdgeId edgeId) const { return _->_edgeVisuals.at(edgeId); }
 
+StringTable::Snapshot GraphModel::visualStrings() const
+{
+    std::unique_lock<std::mutex> lock(_->_visualStringsSnapshotMutex);
+    return _->_visualStringsSnapshot;
+}
+
 NodePositions& GraphModel::nodePositions() { return _->_nodePositions; }
 const NodePositions& GraphModel::nodePositions() const { return _->_nodePositions; }
 
@@ -885,7 +899,9 @@ void GraphModel::clearHighlightedNodes()
         return;
 
     _->_highlightedNodeIds.clear();
-    updateVisuals();
+
+    // Highlighting only ever affects the state of selected nodes
+    updateVisualStates(_->_selectedNodeIds);
 }
 
 void GraphModel::highlightNodes(const NodeIdSet& nodeIds)
@@ -894,7 +910,7 @@ void GraphModel::highlightNodes(const NodeIdSet& nodeIds)
         return;
 
     _->_highlightedNodeIds = nodeIds;
-    updateVisuals();
+    updateVisualStates(_->_selectedNodeIds);
 }
 
 void GraphModel::enableVisualUpdates()
@@ -921,17 +937,27 @@ void GraphModel::updateVisuals()
 
     emit visualsWillChange();
 
-    auto nodeColor      = u::pref("visuals/defaultNodeColor").value<QColor>();
-    auto edgeColor      = u::pref("visuals/defaultEdgeColor").value<QColor>();
-    auto multiColor     = u::pref("visuals/multiElementColor").value<QColor>();
+    auto nodeColor      = PackedColor(u::pref("visuals/defaultNodeColor").value<QColor>());
+    auto edgeColor      = PackedColor(u::pref("visuals/defaultEdgeColor").value<QColor>());
+    auto multiColor     = PackedColor(u::pref("visuals/multiElementColor").value<QColor>());
     auto nodeSize       = u::pref("visuals/defaultNodeSize").toFloat();
     auto edgeSize       = u::pref("visuals/defaultEdgeSize").toFloat();
     auto meIndicators   = u::pref("visuals/showMultiElementIndicators").toBool();
 
-    // Clear all edge flags as we can't know what to
-    // change unless we have the previous state to hand
-    for(auto edgeId : graph().edgeIds())
-        _->_edgeVisuals[edgeId]._state.reset(VisualFlags::Selected, VisualFlags::Unhighlighted);
+    // Reintern only the strings that are still in use, so that text that is no
+    // longer referred to by any visual doesn't accumulate in the table
+    StringTable visualStrings;
+    auto reintern = [&](StringTable::Handle& handle)
+    {
+        if(handle != StringTable::Empty)
+            handle = visualStrings.intern(_->_visualStrings.at(handle));
+    };
+
+    for(int i = 0; i < _->_mappedNodeVisuals.size(); i++)
+        reintern(_->_mappedNodeVisuals[NodeId(i)]._text);
+
+    for(int i = 0; i < _->_mappedEdgeVisuals.size(); i++)
+        reintern(_->_mappedEdgeVisuals[EdgeId(i)]._text);
 
     for(auto nodeId : graph().nodeIds())
     {
@@ -955,34 +981,12 @@ void GraphModel::updateVisuals()
             _->_nodeVisuals[nodeId]._outerColor : multiColor;
 
         // Text
-        if(!_->_mappedNodeVisuals[nodeId]._text.isEmpty())
+        if(_->_mappedNodeVisuals[nodeId]._text != StringTable::Empty)
             _->_nodeVisuals[nodeId]._text = _->_mappedNodeVisuals[nodeId]._text;
         else
-            _->_nodeVisuals[nodeId]._text = nodeName(nodeId);
-
-        auto nodeIsSelected = u::contains(_->_selectedNodeIds, nodeId);
-
-        _->_nodeVisuals[nodeId]._state.setState(VisualFlags::Selected, nodeIsSelected);
-
-        if(nodeIsSelected)
-        {
-            for(auto edgeId : graph().edgeIdsForNodeId(nodeId))
-                _->_edgeVisuals[edgeId]._state.setState(VisualFlags::Selected, nodeIsSelected);
-        }
-
-        auto isNotFound = !_->_foundNodeIds.empty() && !u::contains(_->_foundNodeIds, nodeId);
-        auto isNotHighlighted = !_->_highlightedNodeIds.empty() && nodeIsSelected &&
-            !u::contains(_->_highlightedNodeIds, nodeId);
+            _->_nodeVisuals[nodeId]._text = visualStrings.intern(nodeName(nodeId));
 
-        auto nodeUnhighlighted = (isNotFound && _->_nodesMaskActive) || isNotHighlighted;
-
-        _->_nodeVisuals[nodeId]._state.setState(VisualFlags::Unhighlighted, nodeUnhighlighted);
-
-        if(nodeUnhighlighted)
-        {
-            for(auto edgeId : graph().edgeIdsForNodeId(nodeId))
-                _->_edgeVisuals[edgeId]._state.set(VisualFlags::Unhighlighted);
-        }
+        updateNodeVisualState(nodeId);
     }
 
     for(auto edgeId : graph().edgeIds())
@@ -1013,10 +1017,76 @@ void GraphModel::updateVisuals()
             _->_edgeVisuals[edgeId]._outerColor : multiColor;
 
         // Text
-        if(!_->_mappedEdgeVisuals[edgeId]._text.isEmpty())
+        if(_->_mappedEdgeVisuals[edgeId]._text != StringTable::Empty)
             _->_edgeVisuals[edgeId]._text = _->_mappedEdgeVisuals[edgeId]._text;
         else
-            _->_edgeVisuals[edgeId]._text.clear();
+            _->_edgeVisuals[edgeId]._text = StringTable::Empty;
+
+        updateEdgeVisualState(edgeId);
+    }
+
+    _->_visualStrings.replaceWith(std::move(visualStrings));
+
+    {
+        std::unique_lock<std::mutex> lock(_->_visualStringsSnapshotMutex);
+        _->_visualStringsSnapshot = _->_visualStrings.snapshot();
+    }
+
+    emit visualsChanged();
+}
+
+void GraphModel::updateNodeVisualState(NodeId nodeId)
+{
+    auto& state = _->_nodeVisuals[nodeId]._state;
+
+    auto nodeIsSelected = u::contains(_->_selectedNodeIds, nodeId);
+    state.setState(VisualFlags::Selected, nodeIsSelected);
+
+    auto isNotFound = !_->_foundNodeIds.empty() && !u::contains(_->_foundNodeIds, nodeId);
+    auto isNotHighlighted = !_->_highlightedNodeIds.empty() && nodeIsSelected &&
+        !u::contains(_->_highlightedNodeIds, nodeId);
+
+    state.setState(VisualFlags::Unhighlighted, (isNotFound && _->_nodesMaskActive) || isNotHighlighted);
+}
+
+// An edge takes on the selection and unhighlighted states of either of its nodes
+void GraphModel::updateEdgeVisualState(EdgeId edgeId)
+{
+    const auto& edge = graph().edgeById(edgeId);
+    const auto& sourceState = _->_nodeVisuals[edge.sourceId()]._state;
+    const auto& targetState = _->_nodeVisuals[edge.targetId()]._state;
+    auto& state = _->_edgeVisuals[edgeId]._state;
+
+    state.setState(VisualFlags::Selected, sourceState.test(VisualFlags::Selected) ||
+        targetState.test(VisualFlags::Selected));
+    state.setState(VisualFlags::Unhighlighted, sourceState.test(VisualFlags::Unhighlighted) ||
+        targetState.test(VisualFlags::Unhighlighted));
+}
+
+template<typename C>
+void GraphModel::updateVisualStates(const C& nodeIds)
+{
+    if(!_visualUpdatesEnabled || nodeIds.empty())
+        return;
+
+    emit visualsWillChange();
+
+    // The nodes must all be updated before any of the edges, as
+    // an edge's state depends on that of both of its nodes
+    for(auto nodeId : nodeIds)
+    {
+        // Changes may refer to nodes that have since been removed
+        if(graph().containsNodeId(nodeId))
+            updateNodeVisualState(nodeId);
+    }
+
+    for(auto nodeId : nodeIds)
+    {
+        if(!graph().containsNodeId(nodeId))
+            continue;
+
+        for(auto edgeId : graph().edgeIdsForNodeId(nodeId))
+            updateEdgeVisualState(edgeId);
     }
 
     emit visualsChanged();
@@ -1025,15 +1095,45 @@ void GraphModel::updateVisuals()
 void GraphModel::onSelectionChanged(const SelectionManager* selectionManager)
 {
     _->_selectedNodeIds = selectionManager->selectedNodes();
-    _->_nodesMaskActive = selectionManager->nodesMaskActive();
-    clearHighlightedNodes();
-    updateVisuals();
+
+    auto nodesMaskActive = selectionManager->nodesMaskActive();
+    auto nodesMaskChanged = _->_nodesMaskActive != nodesMaskActive;
+    _->_nodesMaskActive = nodesMaskActive;
+
+    // The mask determines whether or not every node that hasn't been found is unhighlighted
+    if(nodesMaskChanged)
+    {
+        _->_highlightedNodeIds.clear();
+        updateVisualStates(graph().nodeIds());
+        return;
+    }
+
+    NodeIdSet changedNodeIds = selectionManager->changedNodeIds();
+
+    // Any highlight is cleared by a change of selection, which affects every selected node
+    if(!_->_highlightedNodeIds.empty())
+    {
+        _->_highlightedNodeIds.clear();
+        changedNodeIds.insert(_->_selectedNodeIds.begin(), _->_selectedNodeIds.end());
+    }
+
+    updateVisualStates(changedNodeIds);
 }
 
 void GraphModel::onFoundNodeIdsChanged(const SearchManager* searchManager)
 {
+    auto noneWereFound = _->_foundNodeIds.empty();
     _->_foundNodeIds = searchManager->foundNodeIds();
-    updateVisuals();
+
+    // Found nodes only affect visuals by way of the nodes mask
+    if(!_->_nodesMaskActive)
+        return;
+
+    // Going from no nodes found to some, or vice versa, changes the state of every node
+    if(noneWereFound != _->_foundNodeIds.empty())
+        updateVisualStates(graph().nodeIds());
+    else
+        updateVisualStates(searchManager->changedNodeIds());
 }
 
 void GraphModel::onPreferenceChanged(const QString& name, const QVariant&)
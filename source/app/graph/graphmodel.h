@@ -24,6 +24,7 @@
 #include "shared/graph/igraphmodel.h"
 
 #include "shared/utils/preferenceswatcher.h"
+#include "shared/utils/stringtable.h"
 
 #include "attributes/attribute.h"
 
@@ -77,12 +78,18 @@ private:
     void removeDynamicAttributes();
     QString normalisedAttributeName(QString attribute) const;
 
+    void updateNodeVisualState(NodeId nodeId);
+    void updateEdgeVisualState(EdgeId edgeId);
+
+    // Update only the selection and highlight state of some nodes and their edges
+    template<typename C> void updateVisualStates(const C& nodeIds);
+
     IMutableGraph& mutableGraphImpl() override;
     const IMutableGraph& mutableGraphImpl() const override;
     const IGraph& graphImpl() const override;
 
-    const IElementVisual& nodeVisualImpl(NodeId nodeId) const override;
-    const IElementVisual& edgeVisualImpl(EdgeId edgeId) const override;
+    const ElementVisual& nodeVisualImpl(NodeId nodeId) const override;
+    const ElementVisual& edgeVisualImpl(EdgeId edgeId) const override;
 
 public:
     MutableGraph& mutableGraph();
@@ -91,6 +98,10 @@ public:
     const ElementVisual& nodeVisual(NodeId nodeId) const;
     const ElementVisual& edgeVisual(EdgeId edgeId) const;
 
+    // The strings referred to by the text of the current visuals; this is safe to
+    // read from any thread, but must be retaken after visualsChanged is emitted
+    StringTable::Snapshot visualStrings() const;
+
     NodePositions& nodePositions();
     const NodePositions& nodePositions() const;
 
@@ -161,6 +172,8 @@ public:
     void highlightNodes(const NodeIdSet& nodeIds);
 
     void enableVisualUpdates();
+
+    // Rebuild the visuals of every node and edge
     void updateVisuals();
 
 public slots:
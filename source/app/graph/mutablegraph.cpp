@@ -98,33 +98,20 @@ std::vector<EdgeId> MutableGraph::edgeIdsBetween(NodeId nodeIdA, NodeId nodeIdB)
 {
     std::vector<EdgeId> edgeIds;
 
-    auto undirectedEdge = UndirectedEdge(nodeIdA, nodeIdB);
-    if(u::contains(_e._connections, undirectedEdge))
-    {
-        const auto& edgeIdDistinctSet = _e._connections.at(undirectedEdge);
-        std::copy(edgeIdDistinctSet.begin(), edgeIdDistinctSet.end(), std::back_inserter(edgeIds));
-    }
+    const auto* edgeIdDistinctSet = _e._connections.find(nodeIdA, nodeIdB);
+    if(edgeIdDistinctSet != nullptr)
+        std::copy(edgeIdDistinctSet->begin(), edgeIdDistinctSet->end(), std::back_inserter(edgeIds));
 
     return edgeIds;
 }
 
 EdgeId MutableGraph::firstEdgeIdBetween(NodeId nodeIdA, NodeId nodeIdB) const
 {
-    const auto& nodeA = nodeById(nodeIdA);
-
-    for(auto edgeId : nodeA._outEdgeIds)
-    {
-        if(edgeById(edgeId).targetId() == nodeIdB)
-            return edgeId;
-    }
+    const auto* edgeIdDistinctSet = _e._connections.find(nodeIdA, nodeIdB);
+    if(edgeIdDistinctSet == nullptr || edgeIdDistinctSet->empty())
+        return {};
 
-    for(auto edgeId : nodeA._inEdgeIds)
-    {
-        if(edgeById(edgeId).sourceId() == nodeIdB)
-            return edgeId;
-    }
-
-    return {};
+    return *edgeIdDistinctSet->begin();
 }
 
 bool MutableGraph::edgeExistsBetween(NodeId nodeIdA, NodeId nodeIdB) const
@@ -335,6 +322,10 @@ void MutableGraph::reserveEdgeId(EdgeId edgeId)
     Graph::reserveEdgeId(edgeId);
     _e.resize(static_cast<int>(nextEdgeId()));
 
+    // Loaders reserve the largest edge id up front, which gives us a good
+    // estimate of the number of connections and saves rehashing as they're added
+    _e._connections.reserve(static_cast<size_t>(static_cast<int>(nextEdgeId())));
+
     while(unusedEdgeId < edgeId)
         _unusedEdgeIds.push_back(unusedEdgeId++);
 }
@@ -393,11 +384,12 @@ EdgeId MutableGraph::addEdge(EdgeId edgeId, NodeId sourceId, NodeId targetId)
     nodeBy(sourceId)._outEdgeIds.add(edgeId);
     nodeBy(targetId)._inEdgeIds.add(edgeId);
 
-    auto undirectedEdge = UndirectedEdge(sourceId, targetId);
-    if(!u::contains(_e._connections, undirectedEdge))
-        _e._connections.emplace(undirectedEdge, EdgeIdDistinctSet(&_e._mergedEdgeIds));
+    auto* connection = _e._connections.findOrInsert(sourceId, targetId,
+        EdgeIdDistinctSet(&_e._mergedEdgeIds));
+    Q_ASSERT(connection != nullptr);
 
-    _e._connections[undirectedEdge].add(edgeId);
+    if(connection != nullptr)
+        connection->add(edgeId);
 
     emit edgeAdded(this, edgeId);
     _updateRequired = true;
@@ -423,13 +415,12 @@ void MutableGraph::removeEdge(EdgeId edgeId)
     nodeBy(edge.sourceId())._outEdgeIds.remove(edgeId);
     nodeBy(edge.targetId())._inEdgeIds.remove(edgeId);
 
-    auto undirectedEdge = UndirectedEdge(edge.sourceId(), edge.targetId());
-    auto& connection = _e._connections[undirectedEdge];
-    Q_ASSERT(!connection.empty());
-    connection.remove(edgeId);
+    auto* connection = _e._connections.find(edge.sourceId(), edge.targetId());
+    Q_ASSERT(connection != nullptr && !connection->empty());
+    connection->remove(edgeId);
 
-    if(connection.empty())
-        _e._connections.erase(undirectedEdge);
+    if(connection->empty())
+        _e._connections.erase(edge.sourceId(), edge.targetId());
 
     releaseEdgeId(edgeId);
     _unusedEdgeIds.push_back(edgeId);
@@ -550,8 +541,8 @@ MutableGraph& MutableGraph::clone(const MutableGraph& other)
         node._outEdgeIds.setCollection(&_e._outEdgeIdsCollection);
     }
 
-    for(auto& connection : _e._connections)
-        connection.second.setCollection(&_e._mergedEdgeIds);
+    _e._connections.forEachValue([this](auto& connection)
+        { connection.setCollection(&_e._mergedEdgeIds); });
 
     // Signal all the changes based on the diff before we cloned
     for(NodeId nodeId : diff._nodesAdded)
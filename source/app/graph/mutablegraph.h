@@ -20,33 +20,12 @@
 #define MUTABLEGRAPH_H
 
 #include "graph.h"
+#include "nodepairmap.h"
 #include "shared/graph/imutablegraph.h"
 
 #include <deque>
 #include <mutex>
 #include <vector>
-#include <map>
-
-class UndirectedEdge
-{
-private:
-    NodeId lo;
-    NodeId hi;
-
-public:
-    UndirectedEdge(NodeId a, NodeId b)
-    {
-        std::tie(lo, hi) = std::minmax(a, b);
-    }
-
-    bool operator<(const UndirectedEdge& other) const
-    {
-        if(lo == other.lo)
-            return hi < other.hi;
-
-        return lo < other.lo;
-    }
-};
 
 class MutableGraph : public Graph, public virtual IMutableGraph
 {
@@ -96,7 +75,7 @@ private:
         EdgeIdDistinctSetCollection _inEdgeIdsCollection;
         EdgeIdDistinctSetCollection _outEdgeIdsCollection;
 
-        std::map<UndirectedEdge, EdgeIdDistinctSet> _connections;
+        NodePairMap<EdgeIdDistinctSet> _connections;
 
         void resize(std::size_t size)
         {
@@ -0,0 +1,220 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NODEPAIRMAP_H
+#define NODEPAIRMAP_H
+
+#include "shared/graph/elementid.h"
+
+#include <QtGlobal>
+
+#include <cstdint>
+#include <vector>
+#include <utility>
+
+// An open addressing hash map keyed on an unordered pair of NodeIds, i.e. (a, b)
+// and (b, a) are the same key; the pair is packed into a single 64 bit integer
+// and collisions are resolved by linear probing, with backward shift deletion so
+// that there are never any tombstones to skip over; pairs that include a null
+// NodeId are never present, and can't be inserted
+template<typename Value> class NodePairMap
+{
+private:
+    using Key = uint64_t;
+    static constexpr Key EmptyKey = ~Key(0);
+    static constexpr size_t MinCapacity = 16;
+
+    std::vector<Key> _keys;
+    std::vector<Value> _values;
+    size_t _size = 0;
+    size_t _mask = 0;
+
+    static bool validPair(NodeId a, NodeId b)
+    {
+        // Null ids are negative
+        return static_cast<int>(a) >= 0 && static_cast<int>(b) >= 0;
+    }
+
+    // Only valid pairs have keys; (-1, -1) would otherwise pack to EmptyKey
+    static Key keyFor(NodeId a, NodeId b)
+    {
+        Q_ASSERT(validPair(a, b));
+
+        int lo = static_cast<int>(a);
+        int hi = static_cast<int>(b);
+        if(lo > hi)
+            std::swap(lo, hi);
+
+        return (static_cast<Key>(static_cast<uint32_t>(lo)) << 32) |
+            static_cast<Key>(static_cast<uint32_t>(hi));
+    }
+
+    // Finaliser from splitmix64; the node ids in a key are typically small and
+    // sequential, so they need thoroughly mixing before being masked
+    static size_t hash(Key key)
+    {
+        key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        key = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+        return static_cast<size_t>(key ^ (key >> 31));
+    }
+
+    size_t slotFor(Key key) const
+    {
+        if(_keys.empty())
+            return 0;
+
+        auto slot = hash(key) & _mask;
+        while(_keys[slot] != key && _keys[slot] != EmptyKey)
+            slot = (slot + 1) & _mask;
+
+        return slot;
+    }
+
+    // Keep the load factor at or below 3/4
+    static size_t capacityFor(size_t size)
+    {
+        size_t capacity = MinCapacity;
+        while(capacity - (capacity / 4) < size)
+            capacity *= 2;
+
+        return capacity;
+    }
+
+    void rehash(size_t capacity)
+    {
+        std::vector<Key> keys(capacity, EmptyKey);
+        std::vector<Value> values(capacity);
+        std::swap(_keys, keys);
+        std::swap(_values, values);
+        _mask = capacity - 1;
+
+        for(size_t i = 0; i < keys.size(); i++)
+        {
+            if(keys[i] == EmptyKey)
+                continue;
+
+            auto slot = slotFor(keys[i]);
+            _keys[slot] = keys[i];
+            _values[slot] = std::move(values[i]);
+        }
+    }
+
+public:
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    void reserve(size_t size)
+    {
+        auto capacity = capacityFor(size);
+        if(capacity > _keys.size())
+            rehash(capacity);
+    }
+
+    void clear()
+    {
+        _keys.clear();
+        _values.clear();
+        _size = 0;
+        _mask = 0;
+    }
+
+    Value* find(NodeId a, NodeId b)
+    {
+        if(!validPair(a, b))
+            return nullptr;
+
+        auto key = keyFor(a, b);
+        auto slot = slotFor(key);
+
+        return !_keys.empty() && _keys[slot] == key ? &_values[slot] : nullptr;
+    }
+
+    const Value* find(NodeId a, NodeId b) const
+    {
+        return const_cast<NodePairMap*>(this)->find(a, b);
+    }
+
+    bool contains(NodeId a, NodeId b) const { return find(a, b) != nullptr; }
+
+    // Returns the existing value for (a, b), or inserts defaultValue and returns that;
+    // returns nullptr if either id is null
+    Value* findOrInsert(NodeId a, NodeId b, const Value& defaultValue = {})
+    {
+        if(!validPair(a, b))
+            return nullptr;
+
+        if(_size + 1 > _keys.size() - (_keys.size() / 4))
+            rehash(capacityFor(_size + 1));
+
+        auto key = keyFor(a, b);
+        auto slot = slotFor(key);
+
+        if(_keys[slot] == EmptyKey)
+        {
+            _keys[slot] = key;
+            _values[slot] = defaultValue;
+            _size++;
+        }
+
+        return &_values[slot];
+    }
+
+    void erase(NodeId a, NodeId b)
+    {
+        if(!validPair(a, b))
+            return;
+
+        auto key = keyFor(a, b);
+        auto slot = slotFor(key);
+
+        if(_keys.empty() || _keys[slot] != key)
+            return;
+
+        // Shift any following entries in the same probe sequence back into the
+        // hole, unless doing so would move them before their home slot
+        auto hole = slot;
+        auto next = (hole + 1) & _mask;
+        while(_keys[next] != EmptyKey)
+        {
+            auto home = hash(_keys[next]) & _mask;
+            if(((next - home) & _mask) >= ((next - hole) & _mask))
+            {
+                _keys[hole] = _keys[next];
+                _values[hole] = std::move(_values[next]);
+                hole = next;
+            }
+
+            next = (next + 1) & _mask;
+        }
+
+        _keys[hole] = EmptyKey;
+        _values[hole] = Value();
+        _size--;
+    }
+
+    template<typename Fn> void forEachValue(Fn&& fn)
+    {
+        for(size_t i = 0; i < _keys.size(); i++)
+        {
+            if(_keys[i] != EmptyKey)
+                fn(_values[i]);
+        }
+    }
+};
+
+#endif // NODEPAIRMAP_H
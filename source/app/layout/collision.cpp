@@ -20,7 +20,7 @@
 
 #include "graph/graph.h"
 #include "graph/graphmodel.h"
-#include "ui/visualisations/elementvisual.h"
+#include "shared/ui/visualisations/elementvisual.h"
 
 #include "maths/ray.h"
 #include "maths/plane.h"
@@ -31,12 +31,14 @@ NodeId Collision::nodeClosestToLine(const std::vector<NodeId>& nodeIds, const QV
     NodeId closestNodeId;
     float minimumDistance = std::numeric_limits<float>::max();
 
+    auto nodePositions = _graphModel->nodePositions().snapshot();
+
     for(NodeId nodeId : nodeIds)
     {
         if(!_includeNotFound && _graphModel->nodeVisual(nodeId).state().test(VisualFlags::Unhighlighted))
             continue;
 
-        const QVector3D position = _graphModel->nodePositions().get(nodeId) + _offset;
+        const QVector3D position = nodePositions.get(nodeId) + _offset;
 
         if(plane.sideForPoint(position) != Plane::Side::Front)
             continue;
@@ -70,12 +72,13 @@ void Collision::nodesInsideCylinder(const QVector3D &point, const QVector3D &dir
     Q_ASSERT(!_componentId.isNull());
     const auto* component = _graphModel->graph().componentById(_componentId);
     const auto& nodeIds = component->nodeIds();
+    auto nodePositions = _graphModel->nodePositions().snapshot();
     for(NodeId nodeId : nodeIds)
     {
         if(!_includeNotFound && _graphModel->nodeVisual(nodeId).state().test(VisualFlags::Unhighlighted))
             continue;
 
-        const QVector3D position = _graphModel->nodePositions().get(nodeId) + _offset;
+        const QVector3D position = nodePositions.get(nodeId) + _offset;
 
         if(plane.sideForPoint(position) != Plane::Side::Front)
             continue;
@@ -101,12 +104,14 @@ NodeId Collision::nearestNodeInsideCylinder(const QVector3D& point, const QVecto
     NodeId closestNodeId;
     float minimumDistance = std::numeric_limits<float>::max();
 
+    auto nodePositions = _graphModel->nodePositions().snapshot();
+
     for(NodeId nodeId : nodeIds)
     {
         if(!_includeNotFound && _graphModel->nodeVisual(nodeId).state().test(VisualFlags::Unhighlighted))
             continue;
 
-        float distance = _graphModel->nodePositions().get(nodeId).distanceToPoint(point);
+        float distance = nodePositions.get(nodeId).distanceToPoint(point);
 
         if(distance < minimumDistance)
         {
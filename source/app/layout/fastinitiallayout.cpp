@@ -182,6 +182,8 @@ void FastInitialLayout::execute(bool, Dimensionality dimensionality)
         }
     }
 
+    // Other components may be being laid out concurrently,
+    // so only the positions of this one may be touched
     if(dimensionality == Layout::Dimensionality::TwoDee)
-        positions().flatten();
+        positions().flatten(nodeIds());
 }
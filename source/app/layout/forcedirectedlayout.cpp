@@ -27,6 +27,7 @@
 #include "shared/utils/preferences.h"
 #include "shared/utils/scopetimer.h"
 
+#include <algorithm>
 #include <cmath>
 
 template<typename T> float meanWeightedAvgBuffer(int start, int end, const T& buffer)
@@ -148,14 +149,13 @@ void ForceDirectedLayout::execute(bool firstIteration, Dimensionality dimensiona
         barnesHutTree = std::make_unique<BarnesHutTree2D>();
     }
 
-    barnesHutTree->build(graphComponent(), positions());
+    barnesHutTree->build(graphComponent(), positions(), concurrent());
 
     const float SHORT_RANGE = _settings->value(QStringLiteral("ShortRangeRepulseTerm"));
     const float LONG_RANGE = 0.01f + _settings->value(QStringLiteral("LongRangeRepulseTerm"));
 
     // Repulsive forces
-    auto repulsiveResults = concurrent_for(nodeIds().begin(), nodeIds().end(),
-    [this, &barnesHutTree, SHORT_RANGE, LONG_RANGE](NodeId nodeId)
+    auto repulsive = [this, &barnesHutTree, SHORT_RANGE, LONG_RANGE](NodeId nodeId)
     {
         if(cancelled())
             return;
@@ -165,11 +165,10 @@ void ForceDirectedLayout::execute(bool firstIteration, Dimensionality dimensiona
         {
             return difference * (static_cast<float>(mass) * repulse(distanceSq, SHORT_RANGE, LONG_RANGE));
         });
-    }, ThreadPool::NonBlocking);
+    };
 
     // Attractive forces
-    auto attractiveResults = concurrent_for(edgeIds().begin(), edgeIds().end(),
-    [this](EdgeId edgeId)
+    auto attractive = [this](EdgeId edgeId)
     {
         if(cancelled())
             return;
@@ -184,19 +183,36 @@ void ForceDirectedLayout::execute(bool firstIteration, Dimensionality dimensiona
             _displacements->at(edge.targetId())._attractive -= (force * difference);
             _displacements->at(edge.sourceId())._attractive += (force * difference);
         }
-    }, ThreadPool::NonBlocking);
+    };
 
-    repulsiveResults.wait();
-    attractiveResults.wait();
+    if(concurrent())
+    {
+        auto repulsiveResults = concurrent_for(nodeIds().begin(), nodeIds().end(),
+            repulsive, ThreadPool::NonBlocking);
+        auto attractiveResults = concurrent_for(edgeIds().begin(), edgeIds().end(),
+            attractive, ThreadPool::NonBlocking);
+
+        repulsiveResults.wait();
+        attractiveResults.wait();
+    }
+    else
+    {
+        std::for_each(nodeIds().begin(), nodeIds().end(), repulsive);
+        std::for_each(edgeIds().begin(), edgeIds().end(), attractive);
+    }
 
     if(cancelled())
         return;
 
-    concurrent_for(nodeIds().begin(), nodeIds().end(),
-    [this](NodeId nodeId)
+    auto computeAndDamp = [this](NodeId nodeId)
     {
         _displacements->at(nodeId).computeAndDamp();
-    });
+    };
+
+    if(concurrent())
+        concurrent_for(nodeIds().begin(), nodeIds().end(), computeAndDamp);
+    else
+        std::for_each(nodeIds().begin(), nodeIds().end(), computeAndDamp);
 
     // Apply the forces
     for(auto nodeId : nodeIds())
@@ -18,6 +18,7 @@
 
 #include "layout.h"
 #include "shared/utils/thread.h"
+#include "shared/utils/threadpool.h"
 #include "shared/utils/container.h"
 
 #include "graph/graph.h"
@@ -26,6 +27,8 @@
 
 #include <QDebug>
 
+#include <algorithm>
+
 template<> constexpr bool EnableBitMaskOperators<Layout::Dimensionality> = true;
 
 static bool layoutIsFinished(const Layout& layout)
@@ -200,37 +203,17 @@ void LayoutThread::run()
     {
         u::setCurrentThreadName(QStringLiteral("Layout >"));
 
-        for(auto& [componentId, layout] : _layouts)
-        {
-            if(layoutIsFinished(*layout))
-                continue;
+        executeLayouts();
 
-            if(_dimensionalityMode == Layout::Dimensionality::TwoDee &&
-               (layout->dimensionality() & _dimensionalityMode))
+        bool requiresFlattening = _dimensionalityMode == Layout::Dimensionality::TwoDee &&
+            std::any_of(_layouts.begin(), _layouts.end(),
+            [](const auto& layout)
             {
-                // If we're in 2D mode and the layout can handle it, flatten the positions
-                _nodeLayoutPositions.flatten();
-            }
-
-            layout->execute(!_executedAtLeastOnce.get(componentId), _dimensionalityMode);
-            _executedAtLeastOnce.set(componentId, true);
-        }
+                return layout.second->dimensionality() ==
+                    Layout::Dimensionality::ThreeDee;
+            });
 
-        {
-            std::unique_lock<NodePositions> lock(_graphModel->nodePositions());
-            _graphModel->nodePositions().update(_nodeLayoutPositions);
-
-            bool requiresFlattening = _dimensionalityMode == Layout::Dimensionality::TwoDee &&
-                std::any_of(_layouts.begin(), _layouts.end(),
-                [](const auto& layout)
-                {
-                    return layout.second->dimensionality() ==
-                        Layout::Dimensionality::ThreeDee;
-                });
-
-            if(requiresFlattening)
-                _graphModel->nodePositions().flatten();
-        }
+        _graphModel->nodePositions().update(_nodeLayoutPositions, requiresFlattening);
 
         _performanceCounter.tick();
         emit executed();
@@ -279,6 +262,65 @@ void LayoutThread::run()
     if(_debug != 0) qDebug() << "Layout stopped";
 }
 
+void LayoutThread::executeLayouts()
+{
+    struct Task
+    {
+        Layout* _layout;
+        bool _firstIteration;
+
+        uint64_t computeCostHint() const { return _layout->cost(); }
+    };
+
+    std::vector<Task> tasks;
+    bool flatten = false;
+
+    for(auto& [componentId, layout] : _layouts)
+    {
+        if(layoutIsFinished(*layout))
+            continue;
+
+        // If we're in 2D mode and the layout can handle it, flatten the positions
+        flatten = flatten || (_dimensionalityMode == Layout::Dimensionality::TwoDee &&
+            (layout->dimensionality() & _dimensionalityMode));
+
+        tasks.push_back({layout.get(), !_executedAtLeastOnce.get(componentId)});
+        _executedAtLeastOnce.set(componentId, true);
+    }
+
+    if(flatten)
+        _nodeLayoutPositions.flatten();
+
+    // Most costly first, so that the cheap layouts end up in the small
+    // chunks at the end of the range, which balance the load between threads
+    std::stable_sort(tasks.begin(), tasks.end(), [](const auto& a, const auto& b)
+    {
+        return a._layout->cost() > b._layout->cost();
+    });
+
+    auto firstConcurrentTask = std::find_if(tasks.begin(), tasks.end(),
+        [](const auto& task) { return task._layout->cost() < MinimumConcurrentLayoutCost; });
+
+    // Large components are laid out one by one, each parallelising its own work...
+    for(auto it = tasks.begin(); it != firstConcurrentTask; ++it)
+    {
+        it->_layout->setConcurrent(true);
+        it->_layout->execute(it->_firstIteration, _dimensionalityMode);
+    }
+
+    if(firstConcurrentTask == tasks.end())
+        return;
+
+    // ...whereas there tend to be many small components, for which the overhead of
+    // parallelising each outweighs the benefit, so instead they are grouped into
+    // chunks of similar total cost and executed concurrently
+    concurrent_for(firstConcurrentTask, tasks.end(), [this](const Task& task)
+    {
+        task._layout->setConcurrent(false);
+        task._layout->execute(task._firstIteration, _dimensionalityMode);
+    });
+}
+
 void LayoutThread::addComponent(ComponentId componentId)
 {
     if(!u::contains(_layouts, componentId))
@@ -76,6 +76,7 @@ private:
     int _smoothing;
     const IGraphComponent* _graphComponent;
     NodeLayoutPositions* _positions;
+    bool _concurrent = true;
 
 protected:
     const LayoutSettings* _settings; // NOLINT cppcoreguidelines-non-private-member-variables-in-classes
@@ -106,6 +107,14 @@ public:
     const std::vector<NodeId>& nodeIds() const { return _graphComponent->nodeIds(); }
     const std::vector<EdgeId>& edgeIds() const { return _graphComponent->edgeIds(); }
 
+    // A rough measure of how much work an iteration of the layout involves
+    uint64_t cost() const { return _graphComponent->numNodes() + _graphComponent->numEdges(); }
+
+    // Whether the layout may distribute its work over the thread pool; when
+    // it is itself being executed concurrently with others it shouldn't
+    bool concurrent() const { return _concurrent; }
+    void setConcurrent(bool concurrent) { _concurrent = concurrent; }
+
     virtual void execute(bool firstIteration, Dimensionality dimensionalityMode) = 0;
 
     // Indicates that the algorithm is doing no useful work
@@ -187,6 +196,10 @@ private:
 
     std::unique_ptr<LayoutFactory> _layoutFactory;
     std::map<ComponentId, std::unique_ptr<Layout>> _layouts;
+
+    // Layouts at least this costly are executed one at a time, each using the
+    // whole thread pool; cheaper ones are executed concurrently with each other
+    static constexpr uint64_t MinimumConcurrentLayoutCost = 5000;
     ComponentArray<bool> _executedAtLeastOnce;
 
     Layout::Dimensionality _dimensionalityMode =
@@ -247,6 +260,7 @@ private:
     void uncancel();
     void unfinish();
     void run();
+    void executeLayouts();
 
     void addComponent(ComponentId componentId);
     void removeComponent(ComponentId componentId);
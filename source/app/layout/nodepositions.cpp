@@ -18,131 +18,253 @@
 
 #include "nodepositions.h"
 
+#include <algorithm>
 #include <cmath>
 #include <numeric>
+#include <thread>
 
-const QVector3D& NodePositions::getUnsafe(NodeId nodeId) const
+template<typename GetFn>
+static QVector3D centreOfMassWithFn(const std::vector<NodeId>& nodeIds, GetFn&& getFn)
+{
+    float reciprocal = 1.0f / nodeIds.size();
+
+    return std::accumulate(nodeIds.begin(), nodeIds.end(), QVector3D(),
+    [&](const auto& com, auto nodeId)
+    {
+        return com + (getFn(nodeId) * reciprocal);
+    });
+}
+
+static size_t indexOf(NodeId nodeId)
 {
-    return elementFor(nodeId).newest();
+    return static_cast<size_t>(static_cast<int>(nodeId));
 }
 
-void NodePositions::lock() const
+void NodePositions::Buffer::resize(size_t size)
 {
-    _mutex.lock();
-    _threadId = std::this_thread::get_id();
+    for(auto* v : {&_xs, &_ys, &_zs, &_rawXs, &_rawYs, &_rawZs})
+        v->resize(size);
 }
 
-void NodePositions::unlock() const
+NodePositions::Snapshot& NodePositions::Snapshot::operator=(Snapshot&& other) noexcept
 {
-    _threadId = {};
-    _mutex.unlock();
+    if(this != &other)
+    {
+        if(_nodePositions != nullptr)
+            _nodePositions->release(_index);
+
+        _nodePositions = other._nodePositions;
+        _index = other._index;
+        other._nodePositions = nullptr;
+        other._index = -1;
+    }
+
+    return *this;
 }
 
-bool NodePositions::unlocked() const
+NodePositions::Snapshot::~Snapshot()
 {
-    return _threadId == std::thread::id{};
+    if(_nodePositions != nullptr)
+        _nodePositions->release(_index);
 }
 
-QVector3D NodePositions::get(NodeId nodeId) const
+QVector3D NodePositions::Snapshot::get(NodeId nodeId) const
 {
-    std::unique_lock<const NodePositions> lock(*this);
+    const auto& b = buffer();
+    auto i = indexOf(nodeId);
 
-    return elementFor(nodeId).mean(_smoothing) * _scale;
+    return i < b._xs.size() ? QVector3D(b._xs[i], b._ys[i], b._zs[i]) : QVector3D();
 }
 
-void NodePositions::flatten()
+QVector3D NodePositions::Snapshot::raw(NodeId nodeId) const
 {
-    std::unique_lock<std::recursive_mutex> lock(_mutex);
+    const auto& b = buffer();
+    auto i = indexOf(nodeId);
+
+    return i < b._rawXs.size() ? QVector3D(b._rawXs[i], b._rawYs[i], b._rawZs[i]) : QVector3D();
+}
+
+QVector3D NodePositions::Snapshot::centreOfMass(const std::vector<NodeId>& nodeIds) const
+{
+    return centreOfMassWithFn(nodeIds, [this](NodeId nodeId) { return get(nodeId); });
+}
 
-    generate([this](NodeId nodeId)
+NodePositions::Snapshot NodePositions::snapshot() const
+{
+    while(true)
     {
-        auto positions = elementFor(nodeId);
+        int index = _current;
+        _readerCounts.at(static_cast<size_t>(index))++;
 
-        for(size_t i = 0; i < positions.size(); i++)
-            positions.at(i).setZ(0.0f);
+        // If a new buffer was published in the meantime, the writer may
+        // already be reusing this one, so drop it and try again
+        if(_current == index)
+            return {this, index};
 
-        return positions;
-    });
+        release(index);
+    }
 }
 
-void NodePositions::update(const NodePositions& other)
+void NodePositions::release(int index) const
 {
-    std::unique_lock<const NodePositions> lock(*this);
-
-    _array = other._array;
+    // The decrement and the writer's flag are both sequentially consistent, so
+    // either this sees the writer waiting, or the writer sees the buffer free
+    if(--_readerCounts.at(static_cast<size_t>(index)) == 0 && _writerWaiting)
+    {
+        std::lock_guard<std::mutex> lock(_releasedMutex);
+        _released.notify_one();
+    }
 }
 
-template<typename GetFn>
-static QVector3D centreOfMassWithFn(const std::vector<NodeId>& nodeIds, GetFn&& getFn)
+void NodePositions::update(const NodeLayoutPositions& layoutPositions, bool flatten)
 {
-    float reciprocal = 1.0f / nodeIds.size();
+    std::unique_lock<std::mutex> lock(_updateMutex);
 
-    return std::accumulate(nodeIds.begin(), nodeIds.end(), QVector3D(),
-    [&](const auto& com, auto nodeId)
+    // Find a buffer that is neither current nor held by a reader; a reader can
+    // only newly acquire the current buffer, so once found it stays free
+    int index = -1;
+    auto findFreeBuffer = [this, &index]
     {
-        return com + (getFn(nodeId) * reciprocal);
-    });
+        for(int i = 0; i < NumBuffers && index < 0; i++)
+        {
+            if(i != _current && _readerCounts.at(static_cast<size_t>(i)) == 0)
+                index = i;
+        }
+
+        return index >= 0;
+    };
+
+    // Readers normally let go quickly, so spin briefly before sleeping
+    for(int spins = 0; !findFreeBuffer() && spins < 16; spins++)
+        std::this_thread::yield();
+
+    if(index < 0)
+    {
+        // Only a reader releasing a buffer can free one up, since _current
+        // only changes here, under _updateMutex
+        _writerWaiting = true;
+        std::unique_lock<std::mutex> releasedLock(_releasedMutex);
+        _released.wait(releasedLock, findFreeBuffer);
+        _writerWaiting = false;
+    }
+
+    auto& buffer = _buffers.at(static_cast<size_t>(index));
+    auto size = static_cast<size_t>(layoutPositions.size());
+    buffer.resize(size);
+
+    layoutPositions.smoothed(_smoothing, _scale, buffer._xs.data(), buffer._ys.data(), buffer._zs.data());
+    layoutPositions.newest(buffer._rawXs.data(), buffer._rawYs.data(), buffer._rawZs.data());
+
+    if(flatten)
+    {
+        std::fill(buffer._zs.begin(), buffer._zs.end(), 0.0f);
+        std::fill(buffer._rawZs.begin(), buffer._rawZs.end(), 0.0f);
+    }
+
+    _current = index;
 }
 
-QVector3D NodePositions::centreOfMass(const std::vector<NodeId>& nodeIds) const
+NodeLayoutPositions::NodeLayoutPositions(const IGraphArrayClient& graph) :
+    _graph(&graph)
 {
-    std::unique_lock<const NodePositions> lock(*this);
+    resize(static_cast<int>(graph.nextNodeId()));
+    graph.insertNodeArray(this);
+}
 
-    return centreOfMassWithFn(nodeIds, [this](NodeId nodeId) { return get(nodeId); });
+NodeLayoutPositions::~NodeLayoutPositions()
+{
+    if(_graph != nullptr)
+        _graph->eraseNodeArray(this);
 }
 
-const QVector3D& NodePositions::at(NodeId nodeId) const
+void NodeLayoutPositions::resize(int size)
 {
-    std::unique_lock<const NodePositions> lock(*this);
+    auto s = static_cast<size_t>(size);
 
-    return getUnsafe(nodeId);
+    // New nodes start with a single position at the origin
+    for(size_t slot = 0; slot < MAX_SMOOTHING; slot++)
+    {
+        _xs.at(slot).resize(s, 0.0f);
+        _ys.at(slot).resize(s, 0.0f);
+        _zs.at(slot).resize(s, 0.0f);
+    }
+
+    _newest.resize(s, 0);
+    _counts.resize(s, 1);
 }
 
-const QVector3D& NodeLayoutPositions::get(NodeId nodeId) const
+QVector3D NodeLayoutPositions::get(NodeId nodeId) const
 {
-    Q_ASSERT(unlocked());
+    auto i = indexOf(nodeId);
+    Q_ASSERT(i < _newest.size());
+    auto slot = _newest[i];
 
-    return getUnsafe(nodeId);
+    return {_xs[slot][i], _ys[slot][i], _zs[slot][i]};
 }
 
 void NodeLayoutPositions::set(NodeId nodeId, const QVector3D& position)
 {
-    Q_ASSERT(unlocked());
     Q_ASSERT(!std::isnan(position.x()) && !std::isnan(position.y()) && !std::isnan(position.z()));
 
-    elementFor(nodeId).push_back(position);
+    auto i = indexOf(nodeId);
+    Q_ASSERT(i < _newest.size());
+    auto slot = static_cast<uint8_t>((_newest[i] + 1) & (MAX_SMOOTHING - 1));
+
+    _xs[slot][i] = position.x();
+    _ys[slot][i] = position.y();
+    _zs[slot][i] = position.z();
+
+    _newest[i] = slot;
+    _counts[i] = static_cast<uint8_t>(std::min(_counts[i] + 1, MAX_SMOOTHING));
 }
 
 void NodeLayoutPositions::set(const std::vector<NodeId>& nodeIds, const ExactNodePositions& nodePositions)
 {
-    Q_ASSERT(unlocked());
-
     for(auto nodeId : nodeIds)
     {
         auto position = nodePositions.at(nodeId);
-
         Q_ASSERT(!std::isnan(position.x()) && !std::isnan(position.y()) && !std::isnan(position.z()));
-        elementFor(nodeId).fill(position);
+
+        auto i = indexOf(nodeId);
+        for(size_t slot = 0; slot < MAX_SMOOTHING; slot++)
+        {
+            _xs[slot][i] = position.x();
+            _ys[slot][i] = position.y();
+            _zs[slot][i] = position.z();
+        }
+
+        _counts[i] = MAX_SMOOTHING;
     }
 }
 
-QVector3D NodeLayoutPositions::centreOfMass(const std::vector<NodeId>& nodeIds) const
+void NodeLayoutPositions::flatten()
 {
-    Q_ASSERT(unlocked());
+    for(auto& zs : _zs)
+        std::fill(zs.begin(), zs.end(), 0.0f);
+}
 
-    return centreOfMassWithFn(nodeIds, [this](NodeId nodeId) { return getUnsafe(nodeId); });
+void NodeLayoutPositions::flatten(const std::vector<NodeId>& nodeIds)
+{
+    for(auto nodeId : nodeIds)
+    {
+        auto i = indexOf(nodeId);
+
+        for(auto& zs : _zs)
+            zs[i] = 0.0f;
+    }
 }
 
-BoundingBox3D NodeLayoutPositions::boundingBox(const std::vector<NodeId>& nodeIds) const
+QVector3D NodeLayoutPositions::centreOfMass(const std::vector<NodeId>& nodeIds) const
 {
-    Q_ASSERT(unlocked());
+    return centreOfMassWithFn(nodeIds, [this](NodeId nodeId) { return get(nodeId); });
+}
 
+BoundingBox3D NodeLayoutPositions::boundingBox(const std::vector<NodeId>& nodeIds) const
+{
     if(nodeIds.empty())
         return {};
 
-    Q_ASSERT(!nodeIds.empty());
-
-    auto firstPosition = getUnsafe(nodeIds.front());
+    auto firstPosition = get(nodeIds.front());
     BoundingBox3D boundingBox(firstPosition, firstPosition);
 
     for(NodeId nodeId : nodeIds)
@@ -150,3 +272,57 @@ BoundingBox3D NodeLayoutPositions::boundingBox(const std::vector<NodeId>& nodeId
 
     return boundingBox;
 }
+
+void NodeLayoutPositions::smoothed(int smoothing, float scale, float* xs, float* ys, float* zs) const
+{
+    const auto size = _newest.size();
+    const auto* newest = _newest.data();
+    const auto* counts = _counts.data();
+    const auto samples = static_cast<uint8_t>(std::clamp(smoothing, 1, MAX_SMOOTHING));
+
+    std::fill(xs, xs + size, 0.0f);
+    std::fill(ys, ys + size, 0.0f);
+    std::fill(zs, zs + size, 0.0f);
+
+    // Rather than gathering each node's history in turn, stream through every
+    // slot and accumulate those that are among the node's newest samples; the
+    // loop bodies are branch free so that the compiler can vectorise them
+    for(size_t slot = 0; slot < MAX_SMOOTHING; slot++)
+    {
+        const auto* slotXs = _xs[slot].data();
+        const auto* slotYs = _ys[slot].data();
+        const auto* slotZs = _zs[slot].data();
+
+        for(size_t i = 0; i < size; i++)
+        {
+            auto age = static_cast<uint8_t>((newest[i] - slot) & (MAX_SMOOTHING - 1));
+            auto numSamples = std::min(samples, counts[i]);
+            float weight = age < numSamples ? 1.0f : 0.0f;
+
+            xs[i] += slotXs[i] * weight;
+            ys[i] += slotYs[i] * weight;
+            zs[i] += slotZs[i] * weight;
+        }
+    }
+
+    for(size_t i = 0; i < size; i++)
+    {
+        float factor = scale / static_cast<float>(std::min(samples, counts[i]));
+
+        xs[i] *= factor;
+        ys[i] *= factor;
+        zs[i] *= factor;
+    }
+}
+
+void NodeLayoutPositions::newest(float* xs, float* ys, float* zs) const
+{
+    for(size_t i = 0; i < _newest.size(); i++)
+    {
+        auto slot = _newest[i];
+
+        xs[i] = _xs[slot][i];
+        ys[i] = _ys[slot][i];
+        zs[i] = _zs[slot][i];
+    }
+}
@@ -20,86 +20,185 @@
 #define NODEPOSITIONS_H
 
 #include "shared/graph/grapharray.h"
-#include "shared/utils/circularbuffer.h"
 #include "maths/boundingsphere.h"
 #include "maths/boundingbox.h"
 
 #include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
 #include <mutex>
-#include <thread>
+#include <vector>
 
 #include <QVector3D>
 
 static const int MAX_SMOOTHING = 8;
+static_assert((MAX_SMOOTHING & (MAX_SMOOTHING - 1)) == 0, "MAX_SMOOTHING must be a power of 2");
 
-class MeanPosition : public CircularBuffer<QVector3D, MAX_SMOOTHING>
-{ public: MeanPosition() { push_back({}); } };
+using ExactNodePositions = NodeArray<QVector3D>;
 
-class NodePositions : public NodeArray<MeanPosition>
+// This interface is exposed to the Layout algorithms only, giving
+// them a fast interface to getting and setting node positions; it
+// is only ever accessed from the layout thread
+//
+// Each node keeps a short history of positions, for smoothing. The
+// history is stored as a structure of arrays, with contiguous x, y
+// and z arrays per history slot, so that the smoothed positions of
+// all the nodes can be computed together in vectorisable loops
+class NodeLayoutPositions : public IGraphArray
 {
 private:
-    mutable std::recursive_mutex _mutex;
-    mutable std::thread::id _threadId;
+    const IGraphArrayClient* _graph;
+
+    using Coordinates = std::array<std::vector<float>, MAX_SMOOTHING>;
+
+    // e.g. _xs[slot][nodeId] is the x coordinate of nodeId in history slot slot
+    Coordinates _xs;
+    Coordinates _ys;
+    Coordinates _zs;
 
-    float _scale = 1.0f;
-    int _smoothing = 1;
+    // Per node, the slot containing the newest position
+    // and the number of slots that hold a position
+    std::vector<uint8_t> _newest;
+    std::vector<uint8_t> _counts;
 
 protected:
-    const QVector3D& getUnsafe(NodeId nodeId) const;
+    void resize(int size) override;
+    void invalidate() override { _graph = nullptr; }
 
 public:
-    using NodeArray::NodeArray;
+    explicit NodeLayoutPositions(const IGraphArrayClient& graph);
+    ~NodeLayoutPositions() override;
 
-    void lock() const;
-    void unlock() const;
-    bool unlocked() const;
+    NodeLayoutPositions(const NodeLayoutPositions&) = delete;
+    NodeLayoutPositions& operator=(const NodeLayoutPositions&) = delete;
 
-    void setScale(float scale) { _scale = scale; }
-    float scale() const { return _scale; }
-
-    void setSmoothing(int smoothing) { Q_ASSERT(smoothing <= MAX_SMOOTHING); _smoothing = smoothing; }
-    int smoothing() const { return _smoothing; }
+    int size() const { return static_cast<int>(_newest.size()); }
 
+    // These accessors get and set the raw node positions, i.e. before
+    // they are scaled and/or smoothed
     QVector3D get(NodeId nodeId) const;
+    void set(NodeId nodeId, const QVector3D& position);
+    void set(const std::vector<NodeId>& nodeIds, const ExactNodePositions& nodePositions);
 
     void flatten();
 
-    void update(const NodePositions& other);
+    // Only touches the given nodes, so may be called concurrently for disjoint sets
+    void flatten(const std::vector<NodeId>& nodeIds);
 
     QVector3D centreOfMass(const std::vector<NodeId>& nodeIds) const;
+    BoundingBox3D boundingBox(const std::vector<NodeId>& nodeIds) const;
 
-    // This is only here as NativeSaver requires its interface
-    const QVector3D& at(NodeId nodeId) const;
+    // Write the mean of each node's newest smoothing positions, multiplied by
+    // scale, to xs, ys and zs, which must all have space for size() elements
+    void smoothed(int smoothing, float scale, float* xs, float* ys, float* zs) const;
 
-    // Delete base accessors that could be harmful
-    MeanPosition& operator[](NodeId nodeId) = delete;
-    const MeanPosition& operator[](NodeId nodeId) const = delete;
-    MeanPosition& at(NodeId nodeId) = delete;
+    // Write each node's newest position to xs, ys and zs
+    void newest(float* xs, float* ys, float* zs) const;
 };
 
-using ExactNodePositions = NodeArray<QVector3D>;
-
-// This interface is exposed to the Layout algorithms only, giving
-// them a fast interface to getting and setting node positions,
-// without needing to lock
-class NodeLayoutPositions : public NodePositions
+// The node positions as published by the layout thread, for everything else to read.
+// Positions are triple buffered: the layout writes into a buffer that no reader holds,
+// then publishes it by swapping the current buffer index. Readers take a Snapshot,
+// which pins the current buffer for its lifetime, so neither side ever blocks the
+// other and there is no locking per node
+class NodePositions
 {
+private:
+    struct Buffer
+    {
+        // Smoothed and scaled
+        std::vector<float> _xs;
+        std::vector<float> _ys;
+        std::vector<float> _zs;
+
+        // The newest unsmoothed, unscaled positions, as the layout sees them
+        std::vector<float> _rawXs;
+        std::vector<float> _rawYs;
+        std::vector<float> _rawZs;
+
+        void resize(size_t size);
+    };
+
+    static constexpr int NumBuffers = 3;
+
+    std::array<Buffer, NumBuffers> _buffers;
+    mutable std::array<std::atomic_int, NumBuffers> _readerCounts{};
+    std::atomic_int _current{0};
+
+    // Serialises writers only; readers never take it
+    std::mutex _updateMutex;
+
+    // For a writer to sleep on when every buffer is held; readers only
+    // touch these when releasing a buffer while a writer is waiting
+    std::atomic_bool _writerWaiting{false};
+    mutable std::mutex _releasedMutex;
+    mutable std::condition_variable _released;
+
+    void release(int index) const;
+
+    std::atomic<float> _scale{1.0f};
+    std::atomic_int _smoothing{1};
+
 public:
-    using NodePositions::NodePositions;
-    using NodePositions::set;
+    class Snapshot
+    {
+        friend class NodePositions;
 
-    // These accessors get and set the raw node positions, i.e. before
-    // they are scaled and/or smoothed
-    const QVector3D& get(NodeId nodeId) const;
-    void set(NodeId nodeId, const QVector3D& position);
-    void set(const std::vector<NodeId>& nodeIds, const ExactNodePositions& nodePositions);
+    private:
+        const NodePositions* _nodePositions = nullptr;
+        int _index = -1;
 
-    QVector3D centreOfMass(const std::vector<NodeId>& nodeIds) const;
-    BoundingBox3D boundingBox(const std::vector<NodeId>& nodeIds) const;
-};
+        Snapshot(const NodePositions* nodePositions, int index) :
+            _nodePositions(nodePositions), _index(index)
+        {}
+
+        const Buffer& buffer() const { return _nodePositions->_buffers.at(static_cast<size_t>(_index)); }
+
+    public:
+        Snapshot(const Snapshot&) = delete;
+        Snapshot& operator=(const Snapshot&) = delete;
+
+        Snapshot(Snapshot&& other) noexcept :
+            _nodePositions(other._nodePositions), _index(other._index)
+        {
+            other._nodePositions = nullptr;
+            other._index = -1;
+        }
+
+        Snapshot& operator=(Snapshot&& other) noexcept;
+
+        ~Snapshot();
 
-// Ensure data members aren't added to NodeLayoutPositions, so that
-// NodePositions::update doesn't slice
-static_assert(sizeof(NodePositions) == sizeof(NodeLayoutPositions));
+        // Nodes that were added since the positions were last published have a default position
+        QVector3D get(NodeId nodeId) const;
+        QVector3D raw(NodeId nodeId) const;
+
+        QVector3D centreOfMass(const std::vector<NodeId>& nodeIds) const;
+    };
+
+    NodePositions() = default;
+
+    NodePositions(const NodePositions&) = delete;
+    NodePositions& operator=(const NodePositions&) = delete;
+
+    // A view of the most recently published positions
+    Snapshot snapshot() const;
+
+    // Convenience accessors for one off reads; when reading many
+    // positions, take a Snapshot and read from that instead
+    QVector3D get(NodeId nodeId) const { return snapshot().get(nodeId); }
+    QVector3D centreOfMass(const std::vector<NodeId>& nodeIds) const { return snapshot().centreOfMass(nodeIds); }
+
+    void setScale(float scale) { _scale = scale; }
+    float scale() const { return _scale; }
+
+    void setSmoothing(int smoothing) { Q_ASSERT(smoothing <= MAX_SMOOTHING); _smoothing = smoothing; }
+    int smoothing() const { return _smoothing; }
+
+    // Publish new positions; this only waits if readers are holding
+    // on to both of the previously published buffers
+    void update(const NodeLayoutPositions& layoutPositions, bool flatten = false);
+};
 
 #endif // NODEPOSITIONS_H
@@ -39,7 +39,8 @@ class AbstractSpatialTree
 {
 public:
     virtual ~AbstractSpatialTree() = default;
-    virtual void build(const IGraphComponent& graph, const NodeLayoutPositions& nodePositions) = 0;
+    virtual void build(const IGraphComponent& graph, const NodeLayoutPositions& nodePositions,
+        bool concurrent = true) = 0;
 };
 
 template<size_t NumDimensions>
@@ -227,40 +228,56 @@ private:
     // same, at the point when this is called
     virtual void initialise(const NodeLayoutPositions&, const std::vector<NodeId>&) {}
 
-    void build(const std::vector<NodeId>& nodeIds, const NodeLayoutPositions& nodePositions)
+    void build(const std::vector<NodeId>& nodeIds, const NodeLayoutPositions& nodePositions,
+        bool concurrent = true)
     {
         SCOPE_TIMER_MULTISAMPLES(50)
 
         std::vector<NewTree> newTrees;
         newTrees.emplace_back(this, nodeIds);
 
-        while(!newTrees.empty())
+        auto distribute = [&nodePositions](typename std::vector<NewTree>::iterator it)
         {
-            auto results = concurrent_for(newTrees.begin(), newTrees.end(),
-            [&nodePositions](typename std::vector<NewTree>::iterator it)
+            auto* subTree = it->_tree;
+            const auto& nodeIdsToDistribute = it->_nodeIds;
+
+            subTree->distributeNodesOverSubVolumes(nodePositions, nodeIdsToDistribute);
+
+            std::vector<NewTree> newChildTrees;
+            for(int i = 0; i < subTree->_numInternalNodes; i++)
             {
-                auto* subTree = it->_tree;
-                const auto& nodeIdsToDistribute = it->_nodeIds;
+                const auto* subVolume = subTree->_internalNodes.at(i);
+                newChildTrees.emplace_back(subVolume->_subTree.get(),
+                    std::move(subVolume->_nodeIds));
+            }
 
-                subTree->distributeNodesOverSubVolumes(nodePositions, nodeIdsToDistribute);
+            subTree->initialise(nodePositions, nodeIdsToDistribute);
 
-                std::vector<NewTree> newChildTrees;
-                for(int i = 0; i < subTree->_numInternalNodes; i++)
-                {
-                    const auto* subVolume = subTree->_internalNodes.at(i);
-                    newChildTrees.emplace_back(subVolume->_subTree.get(),
-                        std::move(subVolume->_nodeIds));
-                }
+            return newChildTrees;
+        };
 
-                subTree->initialise(nodePositions, nodeIdsToDistribute);
+        while(!newTrees.empty())
+        {
+            std::vector<NewTree> results;
 
-                return newChildTrees;
-            });
+            if(concurrent)
+            {
+                auto concurrentResults = concurrent_for(newTrees.begin(), newTrees.end(), distribute);
+                results.insert(results.end(), std::make_move_iterator(concurrentResults.begin()),
+                    std::make_move_iterator(concurrentResults.end()));
+            }
+            else
+            {
+                for(auto it = newTrees.begin(); it != newTrees.end(); ++it)
+                {
+                    auto childTrees = distribute(it);
+                    results.insert(results.end(), std::make_move_iterator(childTrees.begin()),
+                        std::make_move_iterator(childTrees.end()));
+                }
+            }
 
             // subTrees has now been processsed, but may have resulted in more subTrees
-            newTrees.clear();
-            newTrees.insert(newTrees.end(), std::make_move_iterator(results.begin()),
-                std::make_move_iterator(results.end()));
+            newTrees = std::move(results);
         }
 
         std::stack<const SpatialTree*> stack;
@@ -316,7 +333,8 @@ protected:
     void setMaxNodesPerLeaf(unsigned int maxNodesPerLeaf) { _maxNodesPerLeaf = maxNodesPerLeaf; }
 
 public:
-    void build(const IGraphComponent& graph, const NodeLayoutPositions& nodePositions) override
+    void build(const IGraphComponent& graph, const NodeLayoutPositions& nodePositions,
+        bool concurrent = true) override
     {
         if constexpr(NumDimensions == 2)
         {
@@ -327,7 +345,7 @@ public:
             _boundingBox = nodePositions.boundingBox(graph.nodeIds());
 
         Q_ASSERT(_boundingBox.valid());
-        build(graph.nodeIds(), nodePositions);
+        build(graph.nodeIds(), nodePositions, concurrent);
     }
 };
 
@@ -112,7 +112,7 @@ bool GraphMLSaver::save()
         keyId++;
     }
 
-    std::unique_lock<NodePositions> lock(graphModel->nodePositions());
+    auto nodePositions = graphModel->nodePositions().snapshot();
 
     _graphModel->mutableGraph().setPhase(QObject::tr("Nodes"));
     for(auto nodeId : _graphModel->graph().nodeIds())
@@ -135,7 +135,7 @@ bool GraphMLSaver::save()
         stream.writeCharacters(_graphModel->nodeName(nodeId).toHtmlEscaped());
         stream.writeEndElement();
 
-        const auto& pos = graphModel->nodePositions().get(nodeId);
+        const auto pos = nodePositions.get(nodeId);
         stream.writeStartElement(QStringLiteral("data"));
         stream.writeAttribute(QStringLiteral("key"), QStringLiteral("x"));
         stream.writeCharacters(QString::number(static_cast<double>(pos.x())));
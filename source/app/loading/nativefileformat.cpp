@@ -0,0 +1,288 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "nativefileformat.h"
+
+#include "shared/utils/progressable.h"
+#include "shared/utils/threadpool.h"
+
+#include <limits>
+
+#include <zlib.h>
+
+namespace NativeFileFormat
+{
+const QByteArray Magic = QByteArrayLiteral("\x89GRAPHIA\r\n\x1a\n");
+
+// Compressing tiny sections is a waste of time
+static const int MinimumCompressibleSize = 1 << 10;
+
+void initialise(QDataStream& stream)
+{
+    stream.setVersion(QDataStream::Qt_5_6);
+    stream.setByteOrder(QDataStream::LittleEndian);
+    stream.setFloatingPointPrecision(QDataStream::SinglePrecision);
+}
+
+static QByteArray compress(const QByteArray& byteArray)
+{
+    auto size = compressBound(static_cast<uLong>(byteArray.size()));
+    QByteArray compressed(static_cast<int>(size), Qt::Uninitialized);
+
+    if(compress2(reinterpret_cast<Bytef*>(compressed.data()), &size, // NOLINT
+        reinterpret_cast<const Bytef*>(byteArray.constData()), // NOLINT
+        static_cast<uLong>(byteArray.size()), Z_DEFAULT_COMPRESSION) != Z_OK)
+    {
+        return {};
+    }
+
+    compressed.resize(static_cast<int>(size));
+    return compressed;
+}
+
+static QByteArray decompress(const QByteArray& byteArray, quint64 size)
+{
+    if(size > static_cast<quint64>(std::numeric_limits<int>::max()))
+        return {};
+
+    auto decompressedSize = static_cast<uLongf>(size);
+    QByteArray decompressed(static_cast<int>(size), Qt::Uninitialized);
+
+    if(uncompress(reinterpret_cast<Bytef*>(decompressed.data()), &decompressedSize, // NOLINT
+        reinterpret_cast<const Bytef*>(byteArray.constData()), // NOLINT
+        static_cast<uLong>(byteArray.size())) != Z_OK || decompressedSize != size)
+    {
+        return {};
+    }
+
+    return decompressed;
+}
+
+static bool readPreamble(QFile& file, QByteArray& header, quint64& indexOffset)
+{
+    if(file.read(Magic.size()) != Magic)
+        return false;
+
+    QDataStream stream(&file);
+    initialise(stream);
+
+    quint32 headerSize = 0;
+    stream >> headerSize;
+
+    if(stream.status() != QDataStream::Ok || headerSize > static_cast<quint32>(file.bytesAvailable()))
+        return false;
+
+    header = file.read(headerSize);
+    stream >> indexOffset;
+
+    return stream.status() == QDataStream::Ok;
+}
+
+bool isNativeFile(const QString& filePath)
+{
+    QFile file(filePath);
+
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+
+    return file.read(Magic.size()) == Magic;
+}
+
+bool write(const QString& filePath, const QByteArray& header,
+    const std::vector<Section>& sections, Progressable& progressable)
+{
+    struct StoredSection
+    {
+        const Section* _section = nullptr;
+        Compression _compression = Compression::None;
+        QByteArray _data;
+    };
+
+    std::vector<StoredSection> storedSections;
+    storedSections.reserve(sections.size());
+    for(const auto& section : sections)
+        storedSections.push_back({&section, Compression::None, {}});
+
+    progressable.setProgress(-1);
+
+    concurrent_for(storedSections.begin(), storedSections.end(),
+    [](StoredSection& storedSection)
+    {
+        const auto& data = storedSection._section->_data;
+
+        if(data.size() < MinimumCompressibleSize)
+            return;
+
+        auto compressed = compress(data);
+
+        // Keep whichever is smaller, in case the data is already compressed
+        if(!compressed.isNull() && compressed.size() < data.size())
+        {
+            storedSection._compression = Compression::Zlib;
+            storedSection._data = compressed;
+        }
+    });
+
+    QFile file(filePath);
+
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+        return false;
+
+    QDataStream stream(&file);
+    initialise(stream);
+
+    stream.writeRawData(Magic.constData(), Magic.size());
+    stream << static_cast<quint32>(header.size());
+    stream.writeRawData(header.constData(), header.size());
+
+    // The index offset is filled in once it is known
+    auto indexOffsetPosition = file.pos();
+    stream << static_cast<quint64>(0);
+
+    std::vector<quint64> offsets;
+    offsets.reserve(storedSections.size());
+
+    size_t i = 0;
+    for(const auto& storedSection : storedSections)
+    {
+        const auto& data = storedSection._compression == Compression::None ?
+            storedSection._section->_data : storedSection._data;
+
+        offsets.push_back(static_cast<quint64>(file.pos()));
+
+        if(stream.writeRawData(data.constData(), data.size()) != data.size())
+            return false;
+
+        progressable.setProgress(static_cast<int>((++i * 100) / storedSections.size()));
+    }
+
+    auto indexOffset = static_cast<quint64>(file.pos());
+
+    stream << static_cast<quint32>(storedSections.size());
+    for(i = 0; i < storedSections.size(); i++)
+    {
+        const auto& storedSection = storedSections.at(i);
+        const auto& data = storedSection._section->_data;
+        auto storedSize = storedSection._compression == Compression::None ?
+            data.size() : storedSection._data.size();
+
+        stream << storedSection._section->_name <<
+            static_cast<quint32>(storedSection._compression) << offsets.at(i) <<
+            static_cast<quint64>(storedSize) << static_cast<quint64>(data.size());
+    }
+
+    if(!file.seek(indexOffsetPosition))
+        return false;
+
+    stream << indexOffset;
+
+    progressable.setProgress(-1);
+
+    return stream.status() == QDataStream::Ok;
+}
+
+bool Reader::open(const QString& filePath)
+{
+    _file.setFileName(filePath);
+
+    if(!_file.open(QIODevice::ReadOnly))
+        return false;
+
+    quint64 indexOffset = 0;
+    if(!readPreamble(_file, _header, indexOffset))
+        return false;
+
+    if(indexOffset >= static_cast<quint64>(_file.size()) || !_file.seek(static_cast<qint64>(indexOffset)))
+        return false;
+
+    QDataStream stream(&_file);
+    initialise(stream);
+
+    quint32 numSections = 0;
+    stream >> numSections;
+
+    for(quint32 i = 0; i < numSections && stream.status() == QDataStream::Ok; i++)
+    {
+        QByteArray name;
+        quint32 compression = 0;
+        IndexEntry entry;
+
+        stream >> name >> compression >> entry._offset >> entry._storedSize >> entry._size;
+        entry._compression = static_cast<Compression>(compression);
+
+        if(entry._offset + entry._storedSize > indexOffset)
+            return false;
+
+        _index[name] = entry;
+    }
+
+    return stream.status() == QDataStream::Ok;
+}
+
+bool Reader::contains(const QByteArray& name) const
+{
+    return _index.find(name) != _index.end();
+}
+
+bool Reader::read(const QByteArray& name, QByteArray& data)
+{
+    auto it = _index.find(name);
+    if(it == _index.end())
+        return false;
+
+    const auto& entry = it->second;
+
+    if(entry._storedSize > static_cast<quint64>(std::numeric_limits<int>::max()))
+        return false;
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        if(!_file.seek(static_cast<qint64>(entry._offset)))
+            return false;
+
+        data = _file.read(static_cast<qint64>(entry._storedSize));
+    }
+
+    if(static_cast<quint64>(data.size()) != entry._storedSize)
+        return false;
+
+    switch(entry._compression)
+    {
+    case Compression::None:
+        return true;
+
+    case Compression::Zlib:
+        data = decompress(data, entry._size);
+        return !data.isNull();
+    }
+
+    return false;
+}
+
+bool readHeader(const QString& filePath, QByteArray& header)
+{
+    QFile file(filePath);
+
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+
+    quint64 indexOffset = 0;
+    return readPreamble(file, header, indexOffset);
+}
+} // namespace NativeFileFormat
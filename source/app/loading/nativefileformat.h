@@ -0,0 +1,127 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef NATIVEFILEFORMAT_H
+#define NATIVEFILEFORMAT_H
+
+#include <QByteArray>
+#include <QDataStream>
+#include <QFile>
+#include <QString>
+
+#include <map>
+#include <mutex>
+#include <vector>
+
+class Progressable;
+
+// From version 6, native files are a binary container of individually compressed sections,
+// so that the bulk of a document can be read (or skipped) without parsing any JSON:
+//
+//   Magic
+//   Header size (quint32), header (JSON)
+//   Index offset (quint64)
+//   Sections...
+//   Index: section count (quint32), then for each section:
+//       name (QByteArray), compression (quint32), offset, stored size, size (quint64)
+//
+// Values are little endian; the contents of each section are up to the saver
+namespace NativeFileFormat
+{
+extern const QByteArray Magic;
+
+enum class Compression : quint32
+{
+    None = 0,
+    Zlib = 1
+};
+
+struct Section
+{
+    QByteArray _name;
+    QByteArray _data;
+};
+
+// Configures a stream for section data; floating point values are single precision
+void initialise(QDataStream& stream);
+
+template<typename T>
+void writeArray(QDataStream& stream, const std::vector<T>& values)
+{
+    stream << static_cast<quint64>(values.size());
+
+    for(const auto& value : values)
+        stream << value;
+}
+
+template<typename T>
+bool readArray(QDataStream& stream, std::vector<T>& values)
+{
+    quint64 size = 0;
+    stream >> size;
+
+    // Guard against allocating something silly when the data is corrupt
+    if(stream.status() != QDataStream::Ok || size > static_cast<quint64>(stream.device()->bytesAvailable()))
+        return false;
+
+    values.resize(size);
+
+    for(auto& value : values)
+        stream >> value;
+
+    return stream.status() == QDataStream::Ok;
+}
+
+bool isNativeFile(const QString& filePath);
+
+// Sections are compressed concurrently, then written in the given order
+bool write(const QString& filePath, const QByteArray& header,
+    const std::vector<Section>& sections, Progressable& progressable);
+
+class Reader
+{
+private:
+    struct IndexEntry
+    {
+        Compression _compression = Compression::None;
+        quint64 _offset = 0;
+        quint64 _storedSize = 0;
+        quint64 _size = 0;
+    };
+
+    QFile _file;
+    std::mutex _mutex;
+    QByteArray _header;
+    std::map<QByteArray, IndexEntry> _index;
+
+public:
+    // Reads the header and index only
+    bool open(const QString& filePath);
+
+    const QByteArray& header() const { return _header; }
+    bool contains(const QByteArray& name) const;
+
+    // Returns false if the section is absent or corrupt; sections may be read concurrently
+    bool read(const QByteArray& name, QByteArray& data);
+};
+
+// Cheaper than a Reader when only the header is of interest
+bool readHeader(const QString& filePath, QByteArray& header);
+} // namespace NativeFileFormat
+
+#endif // NATIVEFILEFORMAT_H
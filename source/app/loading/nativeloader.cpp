@@ -17,6 +17,7 @@
  */
 
 #include "nativeloader.h"
+#include "nativefileformat.h"
 #include "nativesaver.h"
 
 #include "application.h"
@@ -27,6 +28,7 @@
 #include "shared/plugins/iplugin.h"
 #include "shared/utils/scope_exit.h"
 #include "shared/utils/container.h"
+#include "shared/utils/threadpool.h"
 #include "shared/loading/progress_iterator.h"
 #include "shared/loading/jsongraphparser.h"
 
@@ -189,10 +191,42 @@ struct Header
     int _pluginDataVersion = -1;
 };
 
+static bool parseHeaderJson(const QByteArray& byteArray, Header* header)
+{
+    json jsonHeader = json::parse(byteArray.begin(), byteArray.end(), nullptr, false);
+
+    if(jsonHeader.is_discarded() || jsonHeader.is_null() || !jsonHeader.is_object())
+        return false;
+
+    if(!u::contains(jsonHeader, "version"))
+        return false;
+
+    if(!u::contains(jsonHeader, "pluginName"))
+        return false;
+
+    if(!u::contains(jsonHeader, "pluginDataVersion"))
+        return false;
+
+    if(header != nullptr)
+    {
+        header->_version            = jsonHeader["version"];
+        header->_pluginName         = QString::fromStdString(jsonHeader["pluginName"]);
+        header->_pluginDataVersion  = jsonHeader["pluginDataVersion"];
+    }
+
+    return true;
+}
+
 static bool parseHeader(const QUrl& url, Header* header = nullptr)
 {
     QByteArray byteArray;
 
+    if(NativeFileFormat::isNativeFile(url.toLocalFile()))
+    {
+        return NativeFileFormat::readHeader(url.toLocalFile(), byteArray) &&
+            parseHeaderJson(byteArray, header);
+    }
+
     if(!load(url.toLocalFile(), byteArray, NativeSaver::MaxHeaderSize))
         return false;
 
@@ -229,29 +263,67 @@ static bool parseHeader(const QUrl& url, Header* header = nullptr)
     }
 
     QString headerString = fragment.left(position);
-    auto headerByteArray = headerString.toUtf8();
-    json jsonHeader = json::parse(headerByteArray.begin(), headerByteArray.end(), nullptr, false);
+    return parseHeaderJson(headerString.toUtf8(), header);
+}
 
-    if(jsonHeader.is_discarded() || jsonHeader.is_null() || !jsonHeader.is_object())
-        return false;
+static std::map<QString, NodeIdSet> bookmarksFromJson(const json& bookmarks)
+{
+    std::map<QString, NodeIdSet> bookmarksMap;
 
-    if(!u::contains(jsonHeader, "version"))
-        return false;
+    if(!bookmarks.is_object())
+        return bookmarksMap;
 
-    if(!u::contains(jsonHeader, "pluginName"))
-        return false;
+    for(auto bookmarkIt = bookmarks.begin(); bookmarkIt != bookmarks.end(); ++bookmarkIt)
+    {
+        QString name = QString::fromStdString(bookmarkIt.key());
+        const auto& array = bookmarkIt.value();
 
-    if(!u::contains(jsonHeader, "pluginDataVersion"))
-        return false;
+        if(array.is_array())
+        {
+            NodeIdSet nodeIds;
+            nodeIds.reserve(array.size());
 
-    if(header != nullptr)
+            for(const auto& nodeId : array)
+                nodeIds.insert(nodeId.get<int>());
+
+            bookmarksMap.insert({name, nodeIds});
+        }
+    }
+
+    return bookmarksMap;
+}
+
+static std::vector<EnrichmentTableModel::Table> enrichmentTablesFromJson(const json& enrichmentTables)
+{
+    std::vector<EnrichmentTableModel::Table> tables;
+
+    if(!enrichmentTables.is_array())
+        return tables;
+
+    for(const auto& tableModel : enrichmentTables)
     {
-        header->_version            = jsonHeader["version"];
-        header->_pluginName         = QString::fromStdString(jsonHeader["pluginName"]);
-        header->_pluginDataVersion  = jsonHeader["pluginDataVersion"];
+        tables.emplace_back();
+        auto& table = tables.back();
+        // If Data is empty then it's just an empty table
+        if(u::contains(tableModel, "data"))
+        {
+            for(const auto& dataRow : tableModel["data"])
+            {
+                table.emplace_back();
+                auto& row = table.back();
+                row.reserve(dataRow.size());
+                for(const auto& value : dataRow)
+                {
+                    if(value.is_number())
+                        row.emplace_back(value.get<std::double_t>());
+                    else
+                        row.emplace_back(QString::fromStdString(value.get<std::string>()));
+                }
+            }
+        }
     }
 
-    return true;
+    return tables;
 }
 
 bool Loader::parse(const QUrl& url, IGraphModel* graphModel)
@@ -273,6 +345,9 @@ bool Loader::parse(const QUrl& url, IGraphModel* graphModel)
         return false;
     }
 
+    if(NativeFileFormat::isNativeFile(url.toLocalFile()))
+        return parseNativeFile(url.toLocalFile(), version, header._pluginDataVersion, graphModel);
+
     QByteArray byteArray;
 
     if(!load(url.toLocalFile(), byteArray, -1, &graphModel->mutableGraph(), this))
@@ -335,6 +410,233 @@ bool Loader::parse(const QUrl& url, IGraphModel* graphModel)
         }
     }
 
+    if(!parseDocument(jsonBody, version))
+        return false;
+
+    if(u::contains(jsonBody, "layout") && u::contains(jsonBody["layout"], "positions"))
+    {
+        const auto& jsonPositions = jsonBody["layout"]["positions"];
+        _nodePositions = std::make_unique<ExactNodePositions>(graphModel->mutableGraph());
+
+        if(version >= 4)
+        {
+            u::forEachJsonGraphArray(jsonPositions, [&](NodeId nodeId, const json& position)
+            {
+                Q_ASSERT(graphModel->mutableGraph().containsNodeId(nodeId));
+
+                _nodePositions->set(nodeId, QVector3D(
+                    position.at(0),
+                    position.at(1),
+                    position.at(2)));
+            });
+        }
+        else
+        {
+            NodeId nodeId(0);
+            for(const auto& jsonPosition : jsonPositions)
+            {
+                if(graphModel->mutableGraph().containsNodeId(nodeId))
+                {
+                    const auto& jsonPositionArray = jsonPosition;
+
+                    _nodePositions->set(nodeId, QVector3D(
+                        jsonPositionArray.at(0),
+                        jsonPositionArray.at(1),
+                        jsonPositionArray.at(2)));
+                }
+
+                ++nodeId;
+            }
+        }
+    }
+
+    if(!u::contains(jsonBody, "pluginData"))
+        return false;
+
+    const auto& pluginDataJsonValue = jsonBody["pluginData"];
+
+    QByteArray pluginData;
+
+    if(pluginDataJsonValue.is_object() || pluginDataJsonValue.is_array())
+        pluginData = QByteArray::fromStdString(pluginDataJsonValue.dump());
+    else if(pluginDataJsonValue.is_string())
+        pluginData = QByteArray::fromHex(QByteArray::fromStdString(pluginDataJsonValue));
+    else
+        return false;
+
+    if(!loadPluginData(pluginData, header._pluginDataVersion, graphModel))
+        return false;
+
+    const auto* pluginUiDataKey = version >= 2 ? "pluginUiData" : "ui";
+    if(u::contains(jsonBody, pluginUiDataKey))
+    {
+        const auto& pluginUiDataJsonValue = jsonBody[pluginUiDataKey];
+
+        if(pluginUiDataJsonValue.is_object() || pluginUiDataJsonValue.is_array())
+            _pluginUiData = QByteArray::fromStdString(pluginUiDataJsonValue.dump());
+        else if(pluginUiDataJsonValue.is_string())
+            _pluginUiData = QByteArray::fromHex(QByteArray::fromStdString(pluginUiDataJsonValue));
+        else
+            return false;
+
+        _pluginUiDataVersion = header._pluginDataVersion;
+    }
+
+    return true;
+}
+
+bool Loader::parseNativeFile(const QString& filePath, int version,
+    int pluginDataVersion, IGraphModel* graphModel)
+{
+    _reader = std::make_shared<NativeFileFormat::Reader>();
+
+    if(!_reader->open(filePath))
+        return false;
+
+    // The plugin data is typically the largest section by far,
+    // so decompress it in the background while the graph is built
+    auto pluginDataFuture = execute_on_threadpool([reader = _reader]
+    {
+        QByteArray pluginData;
+        bool success = reader->read("pluginData", pluginData);
+
+        return std::make_pair(success, pluginData);
+    });
+
+    QByteArray byteArray;
+
+    if(!_reader->read("graph", byteArray))
+        return false;
+
+    std::vector<qint32> nodeIds;
+
+    {
+        QDataStream stream(byteArray);
+        NativeFileFormat::initialise(stream);
+
+        std::vector<qint32> edgeIds;
+        std::vector<qint32> sourceIds;
+        std::vector<qint32> targetIds;
+
+        if(!NativeFileFormat::readArray(stream, nodeIds) ||
+            !NativeFileFormat::readArray(stream, edgeIds) ||
+            !NativeFileFormat::readArray(stream, sourceIds) ||
+            !NativeFileFormat::readArray(stream, targetIds))
+        {
+            return false;
+        }
+
+        if(sourceIds.size() != edgeIds.size() || targetIds.size() != edgeIds.size())
+            return false;
+
+        auto& mutableGraph = graphModel->mutableGraph();
+
+        mutableGraph.setPhase(QObject::tr("Nodes"));
+        for(size_t i = 0; i < nodeIds.size(); i++)
+        {
+            if(nodeIds.at(i) < 0)
+                return false;
+
+            NodeId nodeId = nodeIds.at(i);
+            mutableGraph.reserveNodeId(nodeId);
+            mutableGraph.addNode(nodeId);
+
+            setProgress(static_cast<int>((i * 100) / nodeIds.size()));
+        }
+
+        setProgress(-1);
+
+        mutableGraph.setPhase(QObject::tr("Edges"));
+        for(size_t i = 0; i < edgeIds.size(); i++)
+        {
+            if(edgeIds.at(i) < 0 || sourceIds.at(i) < 0 || targetIds.at(i) < 0)
+                return false;
+
+            EdgeId edgeId = edgeIds.at(i);
+            NodeId sourceId = sourceIds.at(i);
+            NodeId targetId = targetIds.at(i);
+
+            if(!mutableGraph.containsNodeId(sourceId) || !mutableGraph.containsNodeId(targetId))
+                return false;
+
+            mutableGraph.reserveEdgeId(edgeId);
+            mutableGraph.addEdge(edgeId, sourceId, targetId);
+
+            setProgress(static_cast<int>((i * 100) / edgeIds.size()));
+        }
+
+        setProgress(-1);
+    }
+
+    if(cancelled())
+        return false;
+
+    // Per node sections are in the same order as the node IDs in the graph section
+    if(_reader->read("nodeNames", byteArray))
+    {
+        QDataStream stream(byteArray);
+        NativeFileFormat::initialise(stream);
+
+        std::vector<QByteArray> nodeNames;
+
+        if(!NativeFileFormat::readArray(stream, nodeNames) || nodeNames.size() != nodeIds.size())
+            return false;
+
+        for(size_t i = 0; i < nodeIds.size(); i++)
+            graphModel->setNodeName(nodeIds.at(i), QString::fromUtf8(nodeNames.at(i)));
+    }
+
+    if(!_reader->read("document", byteArray))
+        return false;
+
+    auto jsonDocument = parseJsonFrom(byteArray, this);
+
+    if(!jsonDocument.is_object() || !parseDocument(jsonDocument, version))
+        return false;
+
+    if(_reader->read("positions", byteArray))
+    {
+        QDataStream stream(byteArray);
+        NativeFileFormat::initialise(stream);
+
+        std::vector<float> xs;
+        std::vector<float> ys;
+        std::vector<float> zs;
+
+        if(!NativeFileFormat::readArray(stream, xs) ||
+            !NativeFileFormat::readArray(stream, ys) ||
+            !NativeFileFormat::readArray(stream, zs))
+        {
+            return false;
+        }
+
+        if(xs.size() != nodeIds.size() || ys.size() != nodeIds.size() || zs.size() != nodeIds.size())
+            return false;
+
+        _nodePositions = std::make_unique<ExactNodePositions>(graphModel->mutableGraph());
+
+        for(size_t i = 0; i < nodeIds.size(); i++)
+            _nodePositions->set(nodeIds.at(i), QVector3D(xs.at(i), ys.at(i), zs.at(i)));
+    }
+
+    if(cancelled())
+        return false;
+
+    graphModel->mutableGraph().setPhase(QObject::tr("Loading"));
+
+    auto [pluginDataRead, pluginData] = pluginDataFuture.get();
+
+    if(!pluginDataRead || !loadPluginData(pluginData, pluginDataVersion, graphModel))
+        return false;
+
+    if(_reader->read("pluginUiData", _pluginUiData))
+        _pluginUiDataVersion = pluginDataVersion;
+
+    return true;
+}
+
+bool Loader::parseDocument(const json& jsonBody, int version)
+{
     if(u::contains(jsonBody, "transforms"))
     {
         for(const auto& transform : jsonBody["transforms"])
@@ -357,51 +659,10 @@ bool Loader::parse(const QUrl& url, IGraphModel* graphModel)
         _shading = jsonBody["3dshading"];
 
     if(u::contains(jsonBody, "bookmarks"))
-    {
-        const auto bookmarks = jsonBody["bookmarks"];
-        for(auto bookmarkIt = bookmarks.begin(); bookmarkIt != bookmarks.end(); ++bookmarkIt)
-        {
-            QString name = QString::fromStdString(bookmarkIt.key());
-            const auto& array = bookmarkIt.value();
-
-            if(array.is_array())
-            {
-                NodeIdSet nodeIds;
-                nodeIds.reserve(array.size());
-
-                for(const auto& nodeId : array)
-                    nodeIds.insert(nodeId.get<int>());
-
-                _bookmarks.insert({name, nodeIds});
-            }
-        }
-    }
+        _deferredData._bookmarks = bookmarksFromJson(jsonBody["bookmarks"]);
 
     if(u::contains(jsonBody, "enrichmentTables"))
-    {
-        for(const auto& tableModel : jsonBody["enrichmentTables"])
-        {
-            _enrichmentTablesData.emplace_back();
-            auto& table = _enrichmentTablesData.back();
-            // If Data is empty then it's just an empty table
-            if(u::contains(tableModel, "data"))
-            {
-                for(const auto& dataRow : tableModel["data"])
-                {
-                    table.emplace_back();
-                    auto& row = table.back();
-                    row.reserve(dataRow.size());
-                    for(const auto& value : dataRow)
-                    {
-                        if(value.is_number())
-                            row.emplace_back(value.get<std::double_t>());
-                        else
-                            row.emplace_back(QString::fromStdString(value.get<std::string>()));
-                    }
-                }
-            }
-        }
-    }
+        _deferredData._enrichmentTables = enrichmentTablesFromJson(jsonBody["enrichmentTables"]);
 
     if(u::contains(jsonBody, "layout"))
     {
@@ -423,42 +684,6 @@ bool Loader::parse(const QUrl& url, IGraphModel* graphModel)
             }
         }
 
-        if(u::contains(jsonLayout, "positions"))
-        {
-            _nodePositions = std::make_unique<ExactNodePositions>(graphModel->mutableGraph());
-
-            if(version >= 4)
-            {
-                u::forEachJsonGraphArray(jsonLayout["positions"], [&](NodeId nodeId, const json& position)
-                {
-                    Q_ASSERT(graphModel->mutableGraph().containsNodeId(nodeId));
-
-                    _nodePositions->set(nodeId, QVector3D(
-                        position.at(0),
-                        position.at(1),
-                        position.at(2)));
-                });
-            }
-            else
-            {
-                NodeId nodeId(0);
-                for(const auto& jsonPosition : jsonLayout["positions"])
-                {
-                    if(graphModel->mutableGraph().containsNodeId(nodeId))
-                    {
-                        const auto& jsonPositionArray = jsonPosition;
-
-                        _nodePositions->set(nodeId, QVector3D(
-                            jsonPositionArray.at(0),
-                            jsonPositionArray.at(1),
-                            jsonPositionArray.at(2)));
-                    }
-
-                    ++nodeId;
-                }
-            }
-        }
-
         _layoutPaused = jsonLayout["paused"];
     }
 
@@ -472,49 +697,47 @@ bool Loader::parse(const QUrl& url, IGraphModel* graphModel)
             return false;
     }
 
-    if(!u::contains(jsonBody, "pluginData"))
-        return false;
-
-    const auto& pluginDataJsonValue = jsonBody["pluginData"];
-
-    QByteArray pluginData;
-
-    if(pluginDataJsonValue.is_object() || pluginDataJsonValue.is_array())
-        pluginData = QByteArray::fromStdString(pluginDataJsonValue.dump());
-    else if(pluginDataJsonValue.is_string())
-        pluginData = QByteArray::fromHex(QByteArray::fromStdString(pluginDataJsonValue));
-    else
-        return false;
+    return true;
+}
 
-    if(header._pluginDataVersion > _pluginInstance->plugin()->dataVersion())
+bool Loader::loadPluginData(const QByteArray& pluginData, int pluginDataVersion, IGraphModel* graphModel)
+{
+    if(pluginDataVersion > _pluginInstance->plugin()->dataVersion())
     {
         setFailureReason(QObject::tr("Produced using a newer version of the plugin '%1'.")
             .arg(_pluginInstance->plugin()->name()));
         return false;
     }
 
-    if(!_pluginInstance->load(pluginData, header._pluginDataVersion, graphModel->mutableGraph(), *this))
+    if(!_pluginInstance->load(pluginData, pluginDataVersion, graphModel->mutableGraph(), *this))
     {
         setFailureReason(_pluginInstance->failureReason());
         return false;
     }
 
-    const auto* pluginUiDataKey = version >= 2 ? "pluginUiData" : "ui";
-    if(u::contains(jsonBody, pluginUiDataKey))
+    return true;
+}
+
+Loader::DeferredDataFn Loader::deferredDataFn() const
+{
+    if(_reader == nullptr)
+        return [deferredData = _deferredData] { return deferredData; };
+
+    // Native files have the deferred data in separate sections, so it can be
+    // decompressed and parsed separately from (i.e. after) everything else
+    return [reader = _reader]
     {
-        const auto& pluginUiDataJsonValue = jsonBody[pluginUiDataKey];
+        DeferredData deferredData;
+        QByteArray byteArray;
 
-        if(pluginUiDataJsonValue.is_object() || pluginUiDataJsonValue.is_array())
-            _pluginUiData = QByteArray::fromStdString(pluginUiDataJsonValue.dump());
-        else if(pluginUiDataJsonValue.is_string())
-            _pluginUiData = QByteArray::fromHex(QByteArray::fromStdString(pluginUiDataJsonValue));
-        else
-            return false;
+        if(reader->read("bookmarks", byteArray))
+            deferredData._bookmarks = bookmarksFromJson(parseJsonFrom(byteArray));
 
-        _pluginUiDataVersion = header._pluginDataVersion;
-    }
+        if(reader->read("enrichmentTables", byteArray))
+            deferredData._enrichmentTables = enrichmentTablesFromJson(parseJsonFrom(byteArray));
 
-    return true;
+        return deferredData;
+    };
 }
 
 void Loader::setPluginInstance(IPluginInstance* pluginInstance)
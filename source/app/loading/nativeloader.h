@@ -30,23 +30,38 @@
 #include "rendering/shading.h"
 #include "attributes/enrichmenttablemodel.h"
 
+#include <json_helper.h>
+
 #include <QString>
 #include <QStringList>
 #include <QByteArray>
 
+#include <functional>
 #include <memory>
 #include <map>
 
+namespace NativeFileFormat { class Reader; }
+
 class Loader : public IParser
 {
+public:
+    // Document data that isn't needed in order to display the graph
+    struct DeferredData
+    {
+        std::map<QString, NodeIdSet> _bookmarks;
+        std::vector<EnrichmentTableModel::Table> _enrichmentTables;
+    };
+
+    using DeferredDataFn = std::function<DeferredData()>;
+
 private:
     IPluginInstance *_pluginInstance = nullptr;
     QStringList _transforms;
     QStringList _visualisations;
 
-    std::map<QString, NodeIdSet> _bookmarks;
-
-    std::vector<EnrichmentTableModel::Table> _enrichmentTablesData;
+    // Native files are kept open so that deferred data can be read from them later
+    std::shared_ptr<NativeFileFormat::Reader> _reader;
+    DeferredData _deferredData;
 
     QByteArray _uiData;
     QByteArray _pluginUiData;
@@ -60,15 +75,20 @@ private:
     Projection _projection = Projection::Perspective;
     Shading _shading = Shading::Smooth;
 
+    bool parseNativeFile(const QString& filePath, int version,
+        int pluginDataVersion, IGraphModel* graphModel);
+    bool parseDocument(const json& jsonBody, int version);
+    bool loadPluginData(const QByteArray& pluginData, int pluginDataVersion, IGraphModel* graphModel);
+
 public:
     bool parse(const QUrl& url, IGraphModel* graphModel) override;
     void setPluginInstance(IPluginInstance* pluginInstance);
 
     QStringList transforms() const { return _transforms; }
     QStringList visualisations() const { return _visualisations; }
-    const auto& bookmarks() const { return _bookmarks; }
-    const std::vector<EnrichmentTableModel::Table>& enrichmentTableModels() const
-    { return _enrichmentTablesData; }
+
+    // The returned function may be called on any thread, after the Loader is destroyed
+    DeferredDataFn deferredDataFn() const;
 
     const QByteArray& uiData() const { return _uiData; }
     const QByteArray& pluginUiData() const { return _pluginUiData; }
@@ -17,13 +17,10 @@
  */
 
 #include "nativesaver.h"
-#include "jsongraphsaver.h"
-
-#include "shared/graph/grapharray_json.h"
+#include "nativefileformat.h"
 
 #include "shared/plugins/iplugin.h"
 #include "shared/utils/iterator_range.h"
-#include "shared/utils/scope_exit.h"
 #include "shared/utils/string.h"
 
 #include "graph/graphmodel.h"
@@ -32,76 +29,92 @@
 #include "ui/document.h"
 
 #include <QDataStream>
-#include <QFile>
 #include <QStringList>
 
 #include <vector>
 
-#include <zlib.h>
-
-const int NativeSaver::Version = 5;
+const int NativeSaver::Version = 6;
 const int NativeSaver::MaxHeaderSize = 1 << 12;
 
-static bool compress(const QByteArray& byteArray, const QString& filePath, Progressable& progressable)
+static QByteArray graphAsBinary(const IGraph& graph)
 {
-    QFile file(filePath);
-
-    if(!file.open(QIODevice::WriteOnly))
-        return false;
+    QByteArray byteArray;
+    QDataStream stream(&byteArray, QIODevice::WriteOnly);
+    NativeFileFormat::initialise(stream);
+
+    std::vector<qint32> nodeIds;
+    nodeIds.reserve(graph.nodeIds().size());
+    for(auto nodeId : graph.nodeIds())
+        nodeIds.push_back(static_cast<int>(nodeId));
+
+    // Edges are stored as three parallel arrays, which compress better than triples
+    std::vector<qint32> edgeIds;
+    std::vector<qint32> sourceIds;
+    std::vector<qint32> targetIds;
+    edgeIds.reserve(graph.edgeIds().size());
+    sourceIds.reserve(graph.edgeIds().size());
+    targetIds.reserve(graph.edgeIds().size());
+    for(auto edgeId : graph.edgeIds())
+    {
+        const auto& edge = graph.edgeById(edgeId);
 
-    uint64_t totalBytes = byteArray.size();
-    uint64_t bytePosition = 0;
-    QDataStream input(byteArray);
-    QDataStream output(&file);
+        edgeIds.push_back(static_cast<int>(edgeId));
+        sourceIds.push_back(static_cast<int>(edge.sourceId()));
+        targetIds.push_back(static_cast<int>(edge.targetId()));
+    }
 
-    z_stream zstream = {};
-    auto ret = deflateInit2(&zstream, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
-                            MAX_WBITS + 16, // 16 means write gzip header/trailer
-                            8, Z_DEFAULT_STRATEGY);
-    if(ret != Z_OK)
-        return false;
+    NativeFileFormat::writeArray(stream, nodeIds);
+    NativeFileFormat::writeArray(stream, edgeIds);
+    NativeFileFormat::writeArray(stream, sourceIds);
+    NativeFileFormat::writeArray(stream, targetIds);
 
-    auto atExit = std::experimental::make_scope_exit([&zstream] { deflateEnd(&zstream); });
-    Q_UNUSED(atExit);
+    return byteArray;
+}
 
-    int flush = Z_ERRNO;
+// Per node values are stored in the same order as the node IDs in the graph section
+static QByteArray nodeNamesAsBinary(const GraphModel& graphModel)
+{
+    QByteArray byteArray;
+    QDataStream stream(&byteArray, QIODevice::WriteOnly);
+    NativeFileFormat::initialise(stream);
 
-    do
-    {
-        const int ChunkSize = 1 << 14;
-        std::vector<unsigned char> inBuffer(ChunkSize);
+    std::vector<QByteArray> nodeNames;
+    nodeNames.reserve(graphModel.mutableGraph().nodeIds().size());
+    for(auto nodeId : graphModel.mutableGraph().nodeIds())
+        nodeNames.push_back(graphModel.nodeNames().at(nodeId).toUtf8());
 
-        auto numBytes = input.readRawData(reinterpret_cast<char*>(inBuffer.data()), ChunkSize); // NOLINT
+    NativeFileFormat::writeArray(stream, nodeNames);
 
-        bytePosition += numBytes;
-        progressable.setProgress(static_cast<int>((bytePosition * 100u) / totalBytes));
+    return byteArray;
+}
 
-        zstream.avail_in = numBytes;
-        zstream.next_in = static_cast<z_const Bytef*>(inBuffer.data());
-        flush = input.atEnd() ? Z_FINISH : Z_NO_FLUSH;
+static QByteArray nodePositionsAsBinary(const GraphModel& graphModel)
+{
+    QByteArray byteArray;
+    QDataStream stream(&byteArray, QIODevice::WriteOnly);
+    NativeFileFormat::initialise(stream);
 
-        do
-        {
-            std::vector<unsigned char> outBuffer(ChunkSize);
-            zstream.avail_out = ChunkSize;
-            zstream.next_out = static_cast<Bytef*>(outBuffer.data());
+    const auto& nodeIds = graphModel.mutableGraph().nodeIds();
+    std::vector<float> xs(nodeIds.size());
+    std::vector<float> ys(nodeIds.size());
+    std::vector<float> zs(nodeIds.size());
 
-            ret = deflate(&zstream, flush);
-            if(ret == Z_STREAM_ERROR)
-                return false;
+    auto nodePositions = graphModel.nodePositions().snapshot();
 
-            numBytes = ChunkSize - zstream.avail_out;
-            if(output.writeRawData(reinterpret_cast<const char*>(outBuffer.data()), numBytes) !=
-               numBytes) // NOLINT
-                return false;
+    for(size_t i = 0; i < nodeIds.size(); i++)
+    {
+        const auto position = nodePositions.raw(nodeIds.at(i));
 
-        } while(zstream.avail_out == 0);
-        Q_ASSERT(zstream.avail_in == 0);
+        xs[i] = position.x();
+        ys[i] = position.y();
+        zs[i] = position.z();
+    }
 
-    } while(flush != Z_FINISH);
-    Q_ASSERT(ret == Z_STREAM_END);
+    NativeFileFormat::writeArray(stream, xs);
+    NativeFileFormat::writeArray(stream, ys);
+    NativeFileFormat::writeArray(stream, zs);
 
-    return true;
+    return byteArray;
 }
 
 static json bookmarksAsJson(const Document& document)
@@ -162,8 +175,6 @@ static json enrichmentTableModelAsJson(const EnrichmentTableModel& table)
 
 bool NativeSaver::save()
 {
-    json jsonArray;
-
     auto* graphModel = dynamic_cast<GraphModel*>(_document->graphModel());
 
     Q_ASSERT(graphModel != nullptr);
@@ -174,73 +185,58 @@ bool NativeSaver::save()
     header["version"] = NativeSaver::Version;
     header["pluginName"] = graphModel->pluginName();
     header["pluginDataVersion"] = graphModel->pluginDataVersion();
-    jsonArray.emplace_back(header);
 
     // The header must fit within a certain size, which is the maximum the loader will look at
-    if(json({header}).dump().size() > MaxHeaderSize)
+    auto headerByteArray = QByteArray::fromStdString(header.dump());
+    if(headerByteArray.size() > MaxHeaderSize)
         return false;
 
-    json content;
+    std::vector<NativeFileFormat::Section> sections;
 
-    content["graph"] = JSONGraphSaver::graphAsJson(graphModel->mutableGraph(), *this);
-    content["nodeNames"] = u::graphArrayAsJson(graphModel->nodeNames(), graphModel->mutableGraph().nodeIds(), this);
+    graphModel->mutableGraph().setPhase(QObject::tr("Graph"));
+    setProgress(-1);
+    sections.push_back({"graph", graphAsBinary(graphModel->mutableGraph())});
+    sections.push_back({"nodeNames", nodeNamesAsBinary(*graphModel)});
+    sections.push_back({"positions", nodePositionsAsBinary(*graphModel)});
 
-    json layout;
+    // Everything else is small enough that JSON is the path of least resistance
+    json document;
 
+    json layout;
     layout["algorithm"] = _document->layoutName();
     layout["settings"] = layoutSettingsAsJson(*_document);
-
-    layout["positions"] = u::graphArrayAsJson(graphModel->nodePositions(), graphModel->mutableGraph().nodeIds(), this,
-    [](const auto& v)
-    {
-        return json({v.x(), v.y(), v.z()});
-    });
-
     layout["paused"] = _document->layoutPauseState() == LayoutPauseState::Paused;
-    content["layout"] = layout;
-
-    content["projection"] = _document->projection();
-    content["2dshading"] = _document->shading2D();
-    content["3dshading"] = _document->shading3D();
-
-    content["transforms"] = u::toQStringVector(_document->transforms());
-    content["visualisations"] = u::toQStringVector(_document->visualisations());
+    document["layout"] = layout;
 
-    content["bookmarks"] = bookmarksAsJson(*_document);
+    document["projection"] = _document->projection();
+    document["2dshading"] = _document->shading2D();
+    document["3dshading"] = _document->shading3D();
 
-    for(const auto* table : *_document->enrichmentTableModels())
-        content["enrichmentTables"].push_back(enrichmentTableModelAsJson(*table));
+    document["transforms"] = u::toQStringVector(_document->transforms());
+    document["visualisations"] = u::toQStringVector(_document->visualisations());
 
     auto uiDataJson = json::parse(_uiData.begin(), _uiData.end(), nullptr, false);
 
     if(uiDataJson.is_object() || uiDataJson.is_array())
-        content["ui"] = uiDataJson;
-
-    graphModel->mutableGraph().setPhase(graphModel->pluginName());
-    auto pluginData = _pluginInstance->save(graphModel->mutableGraph(), *this);
-
-    setProgress(-1);
-
-    auto pluginDataJson = json::parse(pluginData.begin(), pluginData.end(), nullptr, false);
+        document["ui"] = uiDataJson;
 
-    // If the plugin data is itself JSON, just whack it in
-    // as is, but if it's not, hex encode it
-    if(!pluginDataJson.is_discarded() && (pluginDataJson.is_object() || pluginDataJson.is_array()))
-        content["pluginData"] = pluginDataJson;
-    else
-        content["pluginData"] = QString(pluginData.toHex());
+    sections.push_back({"document", QByteArray::fromStdString(document.dump())});
 
-    auto pluginUiDataJson = json::parse(_pluginUiData.begin(), _pluginUiData.end(), nullptr, false);
+    // These aren't needed to display the graph, so the loader defers reading them
+    json enrichmentTables = json::array();
+    for(const auto* table : *_document->enrichmentTableModels())
+        enrichmentTables.push_back(enrichmentTableModelAsJson(*table));
 
-    if(!pluginUiDataJson.is_discarded() && (pluginUiDataJson.is_object() || pluginUiDataJson.is_array()))
-        content["pluginUiData"] = pluginUiDataJson;
-    else
-        content["pluginUiData"] = QString(_pluginUiData.toHex());
+    sections.push_back({"bookmarks", QByteArray::fromStdString(bookmarksAsJson(*_document).dump())});
+    sections.push_back({"enrichmentTables", QByteArray::fromStdString(enrichmentTables.dump())});
 
-    jsonArray.emplace_back(content);
+    // Plugin data is stored verbatim, whatever its format
+    graphModel->mutableGraph().setPhase(graphModel->pluginName());
+    sections.push_back({"pluginData", _pluginInstance->save(graphModel->mutableGraph(), *this)});
+    sections.push_back({"pluginUiData", _pluginUiData});
 
     graphModel->mutableGraph().setPhase(QObject::tr("Compressing"));
-    return compress(QByteArray::fromStdString(jsonArray.dump()), _fileUrl.toLocalFile(), *this);
+    return NativeFileFormat::write(_fileUrl.toLocalFile(), headerByteArray, sections, *this);
 }
 
 std::unique_ptr<ISaver> NativeSaverFactory::create(const QUrl& url, Document* document,
@@ -221,11 +221,21 @@ int start(int argc, char *argv[])
 
     u::definePref(QStringLiteral("visuals/projection"),                     QVariant::fromValue(static_cast<int>(Projection::Perspective)));
 
+    // Sizes are in pixels; elements smaller than these are left out or aggregated
+    u::definePref(QStringLiteral("visuals/levelOfDetail"),                  true);
+    u::definePref(QStringLiteral("visuals/levelOfDetailMinimumEdgeSize"),   0.25);
+    u::definePref(QStringLiteral("visuals/levelOfDetailNodeAggregationSize"), 1.0);
+    u::definePref(QStringLiteral("visuals/levelOfDetailMinimumTextSize"),   4.0);
+    u::definePref(QStringLiteral("visuals/levelOfDetailMaximumGlyphs"),     100000);
+
     u::definePref(QStringLiteral("visuals/minimumComponentRadius"),         2.0);
     u::definePref(QStringLiteral("visuals/transitionTime"),                 1.0);
 
     u::definePref(QStringLiteral("misc/maxUndoLevels"),                     25);
 
+    // MiB; correlation data that exceeds this is kept in temporary files
+    u::definePref(QStringLiteral("misc/correlationMemoryBudget"),           4096);
+
     u::definePref(QStringLiteral("misc/showGraphMetrics"),                  false);
     u::definePref(QStringLiteral("misc/showLayoutSettings"),                false);
 
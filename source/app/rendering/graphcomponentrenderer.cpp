@@ -34,8 +34,8 @@
 
 #include "ui/graphquickitem.h"
 #include "ui/selectionmanager.h"
-#include "ui/visualisations/elementvisual.h"
 
+#include "shared/ui/visualisations/elementvisual.h"
 #include "shared/graph/elementid_debug.h"
 #include "shared/utils/preferences.h"
 
@@ -201,9 +201,10 @@ float GraphComponentRenderer::maxNodeDistanceFromPoint(const GraphModel& graphMo
     const QVector3D& centre, const std::vector<NodeId>& nodeIds)
 {
     float maxDistance = std::numeric_limits<float>::lowest();
+    auto nodePositions = graphModel.nodePositions().snapshot();
     for(auto nodeId : nodeIds)
     {
-        QVector3D nodePosition = graphModel.nodePositions().get(nodeId);
+        QVector3D nodePosition = nodePositions.get(nodeId);
         const auto& nodeVisual = graphModel.nodeVisual(nodeId);
         float distance = (centre - nodePosition).length() + nodeVisual._size;
 
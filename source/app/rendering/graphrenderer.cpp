@@ -23,6 +23,7 @@
 #include "graphoverviewscene.h"
 #include "compute/sdfcomputejob.h"
 #include "shared/utils/preferences.h"
+#include "shared/utils/threadpool.h"
 
 #include "graph/graph.h"
 #include "graph/graphmodel.h"
@@ -32,7 +33,7 @@
 #include "ui/document.h"
 #include "ui/graphquickitem.h"
 #include "ui/selectionmanager.h"
-#include "ui/visualisations/elementvisual.h"
+#include "shared/ui/visualisations/elementvisual.h"
 
 #include "shadertools.h"
 #include "screenshotrenderer.h"
@@ -47,6 +48,10 @@
 #include <QTextLayout>
 #include <QBuffer>
 
+#include <algorithm>
+#include <iterator>
+#include <deque>
+#include <unordered_map>
 #include <utility>
 
 template<typename Target>
@@ -149,13 +154,218 @@ GraphRenderer::~GraphRenderer()
     _FBOcomplete = false;
 }
 
+namespace
+{
+const float UnhighlightedAlpha = 0.22f;
+
+// GPU data is built in slices of about this many elements, so that large
+// components are split across threads and small ones share a thread
+constexpr size_t MaxSliceSize = 16384;
+
+bool edgeOccluded(const QVector3D& sourcePosition, const QVector3D& targetPosition,
+    float sourceSize, float targetSize, float edgeSize)
+{
+    auto nodeRadiusSumSq = sourceSize + targetSize;
+    nodeRadiusSumSq *= nodeRadiusSumSq;
+    const auto edgeLengthSq = (targetPosition - sourcePosition).lengthSquared();
+
+    if(edgeLengthSq >= nodeRadiusSumSq)
+        return false;
+
+    // The edge's nodes are intersecting. Their overlap defines a lens of a
+    // certain radius. If this is greater than the edge radius, the edge is
+    // entirely enclosed within the nodes and we can safely skip rendering
+    // it altogether since it is entirely occluded.
+
+    const auto sourceRadiusSq = sourceSize * sourceSize;
+    const auto targetRadiusSq = targetSize * targetSize;
+
+    const auto n = edgeLengthSq - sourceRadiusSq + targetRadiusSq;
+    const auto d = 4.0f * edgeLengthSq;
+    const auto intersectionLensRadiusSq = targetRadiusSq - ((n * n) / d);
+
+    const auto edgeRadiusSq = edgeSize * edgeSize;
+
+    return edgeRadiusSq < intersectionLensRadiusSq;
+}
+
+// Ranges of the nodes or edges of one or more components, and the GPU data built
+// from them. The data is built independently of the shared GPUGraphData instances,
+// so that slices can be built concurrently, and is then copied into them at offsets
+// determined beforehand
+struct GPUGraphDataSlice
+{
+    // The node that represents each cell of aggregated nodes
+    using AggregateCells = std::unordered_map<uint64_t, NodeId>;
+
+    struct Part
+    {
+        GraphComponentRenderer* _componentRenderer = nullptr;
+        const LevelOfDetail* _levelOfDetail = nullptr;
+        AggregateCells* _aggregateCells = nullptr; // Shared by all the parts of a component
+        const std::vector<const IEdge*>* _edges = nullptr; // nullptr when the part is nodes
+        int _componentIndex = 0;
+        size_t _first = 0;
+        size_t _last = 0;
+    };
+
+    std::vector<Part> _parts;
+    size_t _size = 0;
+
+    struct Layer
+    {
+        float _componentAlpha = 0.0f;
+        bool _unhighlighted = false;
+
+        std::vector<GPUGraphData::NodeData> _nodeData;
+        std::vector<NodeId> _nodeIds;
+        std::vector<GPUGraphData::EdgeData> _edgeData;
+        std::vector<GPUGraphData::NodeIdPair> _edgeNodeIds;
+        std::vector<GPUGraphData::GlyphData> _glyphData;
+        std::vector<GPUGraphData::NodeIdPair> _glyphNodeIds;
+        std::vector<size_t> _labelEnds; // Where the glyphs of each label end
+        bool _elementsSelected = false;
+
+        // Where the data is to be copied to
+        GPUGraphData* _gpuGraphData = nullptr;
+        GPUGraphData* _overlayGPUGraphData = nullptr;
+        size_t _nodeOffset = 0;
+        size_t _edgeOffset = 0;
+        size_t _glyphOffset = 0;
+    };
+
+    // There are only ever a handful of these
+    std::vector<Layer> _layers;
+
+    Layer& layerFor(float componentAlpha, bool unhighlighted)
+    {
+        auto it = std::find_if(_layers.begin(), _layers.end(), [&](const Layer& layer)
+        {
+            return layer._componentAlpha == componentAlpha && layer._unhighlighted == unhighlighted;
+        });
+
+        if(it != _layers.end())
+            return *it;
+
+        auto& layer = _layers.emplace_back();
+        layer._componentAlpha = componentAlpha;
+        layer._unhighlighted = unhighlighted;
+
+        return layer;
+    }
+
+    std::vector<const IEdge*> _occludedEdges;
+
+    // The candidates each part has found to represent its aggregated nodes
+    std::vector<AggregateCells> _aggregateCellCandidates;
+
+    // Some elements were left out by the level of detail
+    bool _culled = false;
+
+    uint64_t computeCostHint() const { return _size; }
+};
+
+// Adds size elements to the slices, such that small components
+// share slices and large ones are split across several
+void appendToSlices(std::vector<GPUGraphDataSlice>& slices, GPUGraphDataSlice::Part part, size_t size)
+{
+    for(size_t first = 0; first < size;)
+    {
+        if(slices.empty() || slices.back()._size >= MaxSliceSize)
+            slices.emplace_back();
+
+        auto& slice = slices.back();
+        part._first = first;
+        part._last = std::min(size, first + (MaxSliceSize - slice._size));
+        slice._parts.push_back(part);
+        slice._size += part._last - part._first;
+
+        first = part._last;
+    }
+}
+
+// A range of the elements of one GPUGraphData, whose positions are to be updated
+struct GPUPositionsSlice
+{
+    enum class Type { Nodes, Edges, Glyphs };
+
+    GPUGraphData* _gpuGraphData = nullptr;
+    Type _type = Type::Nodes;
+    size_t _first = 0;
+    size_t _last = 0;
+
+    uint64_t computeCostHint() const { return _last - _first; }
+};
+
+void appendToSlices(std::vector<GPUPositionsSlice>& slices, GPUPositionsSlice slice, size_t size)
+{
+    for(size_t first = 0; first < size; first += MaxSliceSize)
+    {
+        slice._first = first;
+        slice._last = std::min(first + MaxSliceSize, size);
+        slices.push_back(slice);
+    }
+}
+
+template<typename T>
+void copyTo(const std::vector<T>& source, std::vector<T>& destination, size_t offset)
+{
+    Q_ASSERT(offset + source.size() <= destination.size());
+    std::copy(source.begin(), source.end(), destination.begin() + static_cast<std::ptrdiff_t>(offset));
+}
+
+void setPosition(float (&destination)[3], const QVector3D& position)
+{
+    destination[0] = position.x();
+    destination[1] = position.y();
+    destination[2] = position.z();
+}
+
+// When anything has been culled by the level of detail, the GPU data is rebuilt no more
+// often than this, in ms, however the view or the layout changes...
+constexpr qint64 MinimumLevelOfDetailRebuildInterval = 100;
+
+// ...and small changes, that leave the culling mostly still valid, wait this long
+constexpr qint64 LevelOfDetailSettleInterval = 500;
+
+// A view projection that has changed by more than this fraction is a large change
+constexpr float LevelOfDetailViewChangeThreshold = 0.01f;
+
+bool largeViewChange(const QMatrix4x4& from, const QMatrix4x4& to)
+{
+    float differenceSq = 0.0f;
+    float magnitudeSq = 0.0f;
+
+    for(int i = 0; i < 16; i++)
+    {
+        const auto difference = to.constData()[i] - from.constData()[i];
+        differenceSq += difference * difference;
+        magnitudeSq += from.constData()[i] * from.constData()[i];
+    }
+
+    return differenceSq > magnitudeSq * LevelOfDetailViewChangeThreshold * LevelOfDetailViewChangeThreshold;
+}
+} // namespace
+
+float GraphRenderer::textHeight(const QString& text, float textScale) const
+{
+    auto textLayoutIt = _textLayoutResults._layouts.find(text);
+    if(textLayoutIt == _textLayoutResults._layouts.end())
+        return 0.0f;
+
+    return textLayoutIt->second._xHeight * textScale;
+}
+
 void GraphRenderer::createGPUGlyphData(const QString& text, const QColor& textColor, const TextAlignment& textAlignment,
                                     float textScale, float elementSize, const QVector3D& elementPosition,
-                                    int componentIndex, GPUGraphData* gpuGraphData)
+                                    int componentIndex, std::vector<GPUGraphData::GlyphData>& glyphs) const
 {
-    Q_ASSERT(gpuGraphData != nullptr);
+    // This is called concurrently, so it mustn't insert anything into the results
+    auto textLayoutIt = _textLayoutResults._layouts.find(text);
+    if(textLayoutIt == _textLayoutResults._layouts.end())
+        return;
 
-    auto& textLayout = _textLayoutResults._layouts[text];
+    const auto& textLayout = textLayoutIt->second;
 
     auto verticalCentre = -textLayout._xHeight * textScale * 0.5f;
     auto top = elementSize;
@@ -167,9 +377,13 @@ void GraphRenderer::createGPUGlyphData(const QString& text, const QColor& textCo
 
     for(const auto& glyph : textLayout._glyphs)
     {
-        GPUGraphData::GlyphData glyphData;
+        auto textureGlyphIt = _textLayoutResults._glyphs.find(glyph._index);
+        if(textureGlyphIt == _textLayoutResults._glyphs.end())
+            continue;
 
-        auto textureGlyph = _textLayoutResults._glyphs[glyph._index];
+        const auto& textureGlyph = textureGlyphIt->second;
+
+        GPUGraphData::GlyphData glyphData;
 
         glyphData._component = componentIndex;
 
@@ -193,35 +407,71 @@ void GraphRenderer::createGPUGlyphData(const QString& text, const QColor& textCo
         glyphData._textureCoord[1] = textureGlyph._v;
         glyphData._textureLayer = textureGlyph._layer;
 
-        glyphData._basePosition[0] = elementPosition.x();
-        glyphData._basePosition[1] = elementPosition.y();
-        glyphData._basePosition[2] = elementPosition.z();
+        setPosition(glyphData._basePosition, elementPosition);
 
         glyphData._color[0] = textColor.redF();
         glyphData._color[1] = textColor.greenF();
         glyphData._color[2] = textColor.blueF();
 
-        gpuGraphData->_glyphData.push_back(glyphData);
+        glyphs.push_back(glyphData);
     }
 }
 
 void GraphRenderer::updateGPUDataIfRequired()
 {
+    if(!_gpuDataRequiresUpdate && _gpuPositionsRequireUpdate)
+    {
+        _gpuPositionsRequireUpdate = false;
+
+        if(updateGPUPositionsInPlace())
+        {
+            uploadGPUGraphData();
+            return;
+        }
+
+        // Something has been uncovered, so start again
+        _gpuDataRequiresUpdate = true;
+    }
+
     if(!_gpuDataRequiresUpdate)
         return;
 
     _gpuDataRequiresUpdate = false;
+    _gpuPositionsRequireUpdate = false;
 
-    std::unique_lock<NodePositions> nodePositionsLock(_graphModel->nodePositions());
     std::unique_lock<std::recursive_mutex> glyphMapLock(_glyphMap->mutex());
 
-    int componentIndex = 0;
+    const auto levelOfDetailSettings = LevelOfDetail::Settings::fromPreferences();
+
+    _occludedEdges.clear();
+    _levelOfDetailPositionsChanged = false;
+    _levelOfDetailViewProjections.clear();
+    _levelOfDetailTimer.start();
+
+    if(levelOfDetailSettings._enabled)
+    {
+        for(const auto& componentRendererRef : _componentRenderers)
+        {
+            GraphComponentRenderer* componentRenderer = componentRendererRef;
+            if(componentRenderer->visible())
+                _levelOfDetailViewProjections.push_back(componentRenderer->camera()->viewProjectionMatrix());
+        }
+    }
 
-    auto& nodePositions = _graphModel->nodePositions();
+    _levelOfDetailCulled = buildGPUGraphData(*this, levelOfDetailSettings, &_occludedEdges);
 
-    resetGPUGraphData();
+    uploadGPUGraphData();
+}
 
-    NodeArray<QVector3D> scaledAndSmoothedNodePositions(_graphModel->graph());
+bool GraphRenderer::buildGPUGraphData(GraphRendererCore& target,
+    const LevelOfDetail::Settings& levelOfDetailSettings, std::vector<OccludedEdge>* occludedEdges) const
+{
+    bool culled = false;
+
+    auto nodePositions = _graphModel->nodePositions().snapshot();
+    auto visualStrings = _graphModel->visualStrings();
+
+    target.resetGPUGraphData();
 
     float textScale = u::pref("visuals/textSize").toFloat();
     auto textAlignment = static_cast<TextAlignment>(u::pref("visuals/textAlignment").toInt());
@@ -234,147 +484,456 @@ void GraphRenderer::updateGPUDataIfRequired()
     if(!_graphModel->directed())
         edgeVisualType = EdgeVisualType::Cylinder;
 
+    // GraphComponentRenderer::edges returns a copy, so keep them for the duration
+    std::deque<std::vector<const IEdge*>> componentEdges;
+    std::deque<LevelOfDetail> levelsOfDetail;
+    std::deque<GPUGraphDataSlice::AggregateCells> componentAggregateCells;
+    std::vector<GPUGraphDataSlice> slices;
+    int componentIndex = 0;
+
     for(const auto& componentRendererRef : _componentRenderers)
     {
         GraphComponentRenderer* componentRenderer = componentRendererRef;
         if(!componentRenderer->visible())
             continue;
 
-        const float UnhighlightedAlpha = 0.22f;
+        // This is done here rather than in the slices, as the camera's matrices are lazily updated
+        if(levelOfDetailSettings._enabled)
+            levelsOfDetail.emplace_back(levelOfDetailSettings, *componentRenderer->camera());
+        else
+            levelsOfDetail.emplace_back();
+
+        GPUGraphDataSlice::Part part;
+        part._componentRenderer = componentRenderer;
+        part._levelOfDetail = &levelsOfDetail.back();
+        part._aggregateCells = &componentAggregateCells.emplace_back();
+        part._componentIndex = componentIndex;
+        appendToSlices(slices, part, componentRenderer->nodeIds().size());
+
+        componentEdges.emplace_back(componentRenderer->edges());
+        part._edges = &componentEdges.back();
+        appendToSlices(slices, part, part._edges->size());
 
-        for(auto nodeId : componentRenderer->nodeIds())
+        componentIndex++;
+    }
+
+    auto buildNodes = [&](GPUGraphDataSlice& slice, const GPUGraphDataSlice::Part& part)
+    {
+        const auto* componentRenderer = part._componentRenderer;
+        const auto& levelOfDetail = *part._levelOfDetail;
+        const auto& nodeIds = componentRenderer->nodeIds();
+
+        for(auto i = part._first; i < part._last; i++)
         {
+            auto nodeId = nodeIds[i];
+
             if(_hiddenNodes.get(nodeId))
                 continue;
 
             const QVector3D nodePosition = nodePositions.get(nodeId);
-            scaledAndSmoothedNodePositions[nodeId] = nodePosition;
-
             const auto& nodeVisual = _graphModel->nodeVisual(nodeId);
+            const bool unhighlighted = nodeVisual._state.test(VisualFlags::Unhighlighted);
+            float size = nodeVisual._size;
+
+            LevelOfDetail::ScreenSpace screenSpace;
+            if(levelOfDetail.enabled())
+            {
+                screenSpace = levelOfDetail.project(nodePosition, size);
+
+                if(!screenSpace._onScreen)
+                {
+                    slice._culled = true;
+                    continue;
+                }
+
+                if(levelOfDetail.aggregated(screenSpace))
+                {
+                    if(part._aggregateCells->at(levelOfDetail.cellFor(screenSpace)) != nodeId)
+                    {
+                        slice._culled = true;
+                        continue;
+                    }
+
+                    size = levelOfDetail.aggregateSize(screenSpace, size);
+                }
+            }
 
-            // Create and add NodeData
             GPUGraphData::NodeData nodeData;
-            nodeData._position[0] = nodePosition.x();
-            nodeData._position[1] = nodePosition.y();
-            nodeData._position[2] = nodePosition.z();
-            nodeData._component = componentIndex;
-            nodeData._size = nodeVisual._size;
-            nodeData._outerColor[0] = nodeVisual._outerColor.redF();
-            nodeData._outerColor[1] = nodeVisual._outerColor.greenF();
-            nodeData._outerColor[2] = nodeVisual._outerColor.blueF();
-            nodeData._innerColor[0] = nodeVisual._innerColor.redF();
-            nodeData._innerColor[1] = nodeVisual._innerColor.greenF();
-            nodeData._innerColor[2] = nodeVisual._innerColor.blueF();
+            setPosition(nodeData._position, nodePosition);
+            nodeData._component = part._componentIndex;
+            nodeData._size = size;
+            nodeData._outerColor = nodeVisual._outerColor;
+            nodeData._innerColor = nodeVisual._innerColor;
             nodeData._selected = nodeVisual._state.test(VisualFlags::Selected) ? 1.0f : 0.0f;
 
-            auto* gpuGraphData = gpuGraphDataForAlpha(componentRenderer->alpha(),
-                nodeVisual._state.test(VisualFlags::Unhighlighted) ? UnhighlightedAlpha : 1.0f);
+            auto& layer = slice.layerFor(componentRenderer->alpha(), unhighlighted);
+            layer._nodeData.push_back(nodeData);
+            layer._nodeIds.push_back(nodeId);
 
-            if(gpuGraphData != nullptr)
-            {
-                gpuGraphData->_nodeData.push_back(nodeData);
+            if(nodeData._selected != 0.0f)
+                layer._elementsSelected = true;
 
-                if(nodeData._selected != 0.0f)
-                    gpuGraphData->_elementsSelected = true;
+            if(showNodeText == TextState::Off || unhighlighted)
+                continue;
 
-                if(showNodeText == TextState::Off || nodeVisual._state.test(VisualFlags::Unhighlighted))
-                    continue;
+            if(showNodeText == TextState::Selected && !nodeVisual._state.test(VisualFlags::Selected))
+                continue;
 
-                if(showNodeText == TextState::Selected && !nodeVisual._state.test(VisualFlags::Selected))
-                    continue;
+            if(showNodeText == TextState::Focused && componentRenderer->focusNodeId() != nodeId)
+                continue;
 
-                if(showNodeText == TextState::Focused && componentRenderer->focusNodeId() != nodeId)
-                    continue;
+            const auto& text = visualStrings.at(nodeVisual._text);
 
-                createGPUGlyphData(nodeVisual._text, textColor, textAlignment, textScale,
-                    nodeVisual._size, nodePosition, componentIndex,
-                    gpuGraphDataForOverlay(componentRenderer->alpha()));
+            if(levelOfDetail.enabled() && !levelOfDetail.textVisible(screenSpace, textHeight(text, textScale)))
+            {
+                slice._culled = true;
+                continue;
             }
+
+            createGPUGlyphData(text, textColor, textAlignment, textScale,
+                nodeVisual._size, nodePosition, part._componentIndex, layer._glyphData);
+            layer._glyphNodeIds.resize(layer._glyphData.size(), {nodeId, nodeId});
+            layer._labelEnds.push_back(layer._glyphData.size());
         }
+    };
 
-        for(auto& edge : componentRenderer->edges())
+    auto buildEdges = [&](GPUGraphDataSlice& slice, const GPUGraphDataSlice::Part& part)
+    {
+        const auto& levelOfDetail = *part._levelOfDetail;
+        const auto& edges = *part._edges;
+
+        for(auto i = part._first; i < part._last; i++)
         {
+            const auto* edge = edges[i];
+
             if(_hiddenEdges.get(edge->id()) || _hiddenNodes.get(edge->sourceId()) || _hiddenNodes.get(edge->targetId()))
                 continue;
 
-            const QVector3D& sourcePosition = scaledAndSmoothedNodePositions[edge->sourceId()];
-            const QVector3D& targetPosition = scaledAndSmoothedNodePositions[edge->targetId()];
+            const QVector3D sourcePosition = nodePositions.get(edge->sourceId());
+            const QVector3D targetPosition = nodePositions.get(edge->targetId());
 
             const auto& edgeVisual = _graphModel->edgeVisual(edge->id());
-            const auto& sourceNodeVisual = _graphModel->nodeVisual(edge->sourceId());
-            const auto& targetNodeVisual = _graphModel->nodeVisual(edge->targetId());
+            const auto sourceSize = _graphModel->nodeVisual(edge->sourceId())._size;
+            const auto targetSize = _graphModel->nodeVisual(edge->targetId())._size;
+            const bool unhighlighted = edgeVisual._state.test(VisualFlags::Unhighlighted);
 
-            auto nodeRadiusSumSq = sourceNodeVisual._size + targetNodeVisual._size;
-            nodeRadiusSumSq *= nodeRadiusSumSq;
-            const auto edgeLengthSq = (targetPosition - sourcePosition).lengthSquared();
-
-            if(edgeLengthSq < nodeRadiusSumSq)
+            if(edgeOccluded(sourcePosition, targetPosition, sourceSize, targetSize, edgeVisual._size))
             {
-                // The edge's nodes are intersecting. Their overlap defines a lens of a
-                // certain radius. If this is greater than the edge radius, the edge is
-                // entirely enclosed within the nodes and we can safely skip rendering
-                // it altogether since it is entirely occluded.
-
-                const auto sourceRadiusSq = sourceNodeVisual._size * sourceNodeVisual._size;
-                const auto targetRadiusSq = targetNodeVisual._size * targetNodeVisual._size;
-
-                const auto n = edgeLengthSq - sourceRadiusSq + targetRadiusSq;
-                const auto d = 4.0f * edgeLengthSq;
-                const auto intersectionLensRadiusSq = targetRadiusSq - ((n * n) / d);
-
-                const auto edgeRadiusSq = edgeVisual._size * edgeVisual._size;
+                slice._occludedEdges.push_back(edge);
+                continue;
+            }
 
-                if(edgeRadiusSq < intersectionLensRadiusSq)
-                    continue;
+            if(levelOfDetail.enabled() && !levelOfDetail.edgeVisible(
+                levelOfDetail.project(sourcePosition, sourceSize),
+                levelOfDetail.project(targetPosition, targetSize), edgeVisual._size))
+            {
+                slice._culled = true;
+                continue;
             }
 
             GPUGraphData::EdgeData edgeData;
-            edgeData._sourcePosition[0] = sourcePosition.x();
-            edgeData._sourcePosition[1] = sourcePosition.y();
-            edgeData._sourcePosition[2] = sourcePosition.z();
-            edgeData._targetPosition[0] = targetPosition.x();
-            edgeData._targetPosition[1] = targetPosition.y();
-            edgeData._targetPosition[2] = targetPosition.z();
-            edgeData._sourceSize = _graphModel->nodeVisual(edge->sourceId())._size;
-            edgeData._targetSize = _graphModel->nodeVisual(edge->targetId())._size;
+            setPosition(edgeData._sourcePosition, sourcePosition);
+            setPosition(edgeData._targetPosition, targetPosition);
+            edgeData._sourceSize = sourceSize;
+            edgeData._targetSize = targetSize;
             edgeData._edgeType = static_cast<int>(edgeVisualType);
-            edgeData._component = componentIndex;
+            edgeData._component = part._componentIndex;
             edgeData._size = edgeVisual._size;
-            edgeData._outerColor[0] = edgeVisual._outerColor.redF();
-            edgeData._outerColor[1] = edgeVisual._outerColor.greenF();
-            edgeData._outerColor[2] = edgeVisual._outerColor.blueF();
-            edgeData._innerColor[0] = edgeVisual._innerColor.redF();
-            edgeData._innerColor[1] = edgeVisual._innerColor.greenF();
-            edgeData._innerColor[2] = edgeVisual._innerColor.blueF();
+            edgeData._outerColor = edgeVisual._outerColor;
+            edgeData._innerColor = edgeVisual._innerColor;
             edgeData._selected = 0.0f;
 
-            auto* gpuGraphData = gpuGraphDataForAlpha(componentRenderer->alpha(),
-                edgeVisual._state.test(VisualFlags::Unhighlighted) ? UnhighlightedAlpha : 1.0f);
+            auto& layer = slice.layerFor(part._componentRenderer->alpha(), unhighlighted);
+            layer._edgeData.push_back(edgeData);
+            layer._edgeNodeIds.emplace_back(edge->sourceId(), edge->targetId());
+
+            if(showEdgeText == TextState::Off || unhighlighted)
+                continue;
+
+            if(showEdgeText == TextState::Selected && !edgeVisual._state.test(VisualFlags::Selected))
+                continue;
+
+            QVector3D midPoint = (sourcePosition + targetPosition) * 0.5f;
 
-            if(gpuGraphData != nullptr)
+            const auto& text = visualStrings.at(edgeVisual._text);
+
+            if(levelOfDetail.enabled() && !levelOfDetail.textVisible(
+                levelOfDetail.project(midPoint, edgeVisual._size), textHeight(text, textScale)))
             {
-                gpuGraphData->_edgeData.push_back(edgeData);
+                slice._culled = true;
+                continue;
+            }
+
+            createGPUGlyphData(text, textColor, textAlignment, textScale,
+                edgeVisual._size, midPoint, part._componentIndex, layer._glyphData);
+            layer._glyphNodeIds.resize(layer._glyphData.size(), {edge->sourceId(), edge->targetId()});
+            layer._labelEnds.push_back(layer._glyphData.size());
+        }
+    };
+
+    // A cell of aggregated nodes is represented by the same node regardless of how its
+    // component is split into slices; selected nodes take precedence, so that the
+    // selection remains visible, and otherwise the node with the lowest id is used
+    auto representsAggregateCellBetter = [this](NodeId nodeId, NodeId otherNodeId)
+    {
+        const bool selected = _graphModel->nodeVisual(nodeId)._state.test(VisualFlags::Selected);
+        const bool otherSelected = _graphModel->nodeVisual(otherNodeId)._state.test(VisualFlags::Selected);
+
+        if(selected != otherSelected)
+            return selected;
+
+        return nodeId < otherNodeId;
+    };
+
+    auto findAggregateCellCandidates = [&](GPUGraphDataSlice& slice)
+    {
+        slice._aggregateCellCandidates.resize(slice._parts.size());
+
+        for(size_t p = 0; p < slice._parts.size(); p++)
+        {
+            const auto& part = slice._parts.at(p);
+            const auto& levelOfDetail = *part._levelOfDetail;
+
+            if(part._edges != nullptr || !levelOfDetail.enabled())
+                continue;
 
-                if(edgeData._selected != 0.0f)
-                    gpuGraphData->_elementsSelected = true;
+            const auto& nodeIds = part._componentRenderer->nodeIds();
+            auto& candidates = slice._aggregateCellCandidates.at(p);
 
-                if(showEdgeText == TextState::Off || edgeVisual._state.test(VisualFlags::Unhighlighted))
+            for(auto i = part._first; i < part._last; i++)
+            {
+                auto nodeId = nodeIds[i];
+
+                if(_hiddenNodes.get(nodeId))
                     continue;
 
-                if(showEdgeText == TextState::Selected && !edgeVisual._state.test(VisualFlags::Selected))
+                const auto& nodeVisual = _graphModel->nodeVisual(nodeId);
+                auto screenSpace = levelOfDetail.project(nodePositions.get(nodeId), nodeVisual._size);
+
+                if(!levelOfDetail.aggregated(screenSpace))
                     continue;
 
-                QVector3D midPoint = (sourcePosition + targetPosition) * 0.5f;
-                createGPUGlyphData(edgeVisual._text, textColor, textAlignment, textScale,
-                    edgeVisual._size, midPoint, componentIndex,
-                    gpuGraphDataForOverlay(componentRenderer->alpha()));
+                auto [it, inserted] = candidates.emplace(levelOfDetail.cellFor(screenSpace), nodeId);
+                if(!inserted && representsAggregateCellBetter(nodeId, it->second))
+                    it->second = nodeId;
             }
         }
+    };
 
-        componentIndex++;
+    if(!slices.empty())
+    {
+        if(levelOfDetailSettings._enabled)
+        {
+            concurrent_for(slices.begin(), slices.end(), findAggregateCellCandidates);
+
+            for(auto& slice : slices)
+            {
+                for(size_t p = 0; p < slice._parts.size(); p++)
+                {
+                    auto& aggregateCells = *slice._parts.at(p)._aggregateCells;
+
+                    for(const auto& [cell, nodeId] : slice._aggregateCellCandidates.at(p))
+                    {
+                        auto [it, inserted] = aggregateCells.emplace(cell, nodeId);
+                        if(!inserted && representsAggregateCellBetter(nodeId, it->second))
+                            it->second = nodeId;
+                    }
+                }
+
+                slice._aggregateCellCandidates.clear();
+            }
+        }
+
+        concurrent_for(slices.begin(), slices.end(), [&](GPUGraphDataSlice& slice)
+        {
+            for(const auto& part : slice._parts)
+            {
+                if(part._edges == nullptr)
+                    buildNodes(slice, part);
+                else
+                    buildEdges(slice, part);
+            }
+        });
     }
 
-    uploadGPUGraphData();
+    // Allocate each slice its space in the GPUGraphData instances, in order, so
+    // that the result is the same as if it were built sequentially
+    size_t numGlyphs = 0;
+
+    for(auto& slice : slices)
+    {
+        if(slice._culled)
+            culled = true;
+
+        for(auto& layer : slice._layers)
+        {
+            const auto alpha = layer._componentAlpha;
+            layer._gpuGraphData = target.gpuGraphDataForAlpha(alpha, layer._unhighlighted ? UnhighlightedAlpha : 1.0f);
+
+            if(layer._gpuGraphData == nullptr)
+                continue;
+
+            auto& gpuGraphData = *layer._gpuGraphData;
+
+            layer._nodeOffset = gpuGraphData._nodeData.size();
+            gpuGraphData._nodeData.resize(layer._nodeOffset + layer._nodeData.size());
+            gpuGraphData._nodeIds.resize(gpuGraphData._nodeData.size());
+
+            layer._edgeOffset = gpuGraphData._edgeData.size();
+            gpuGraphData._edgeData.resize(layer._edgeOffset + layer._edgeData.size());
+            gpuGraphData._edgeNodeIds.resize(gpuGraphData._edgeData.size());
+
+            if(layer._elementsSelected)
+                gpuGraphData._elementsSelected = true;
+
+            if(layer._glyphData.empty())
+                continue;
+
+            // Text is dropped once the budget is spent, so components that come first take
+            // priority; the layer that exhausts it keeps as many whole labels as still fit
+            if(levelOfDetailSettings._enabled)
+            {
+                const auto maximumGlyphs = static_cast<size_t>(std::max(levelOfDetailSettings._maximumGlyphs, 0));
+                const auto remainingGlyphs = maximumGlyphs - std::min(numGlyphs, maximumGlyphs);
+
+                if(layer._glyphData.size() > remainingGlyphs)
+                {
+                    auto labelEnd = std::upper_bound(layer._labelEnds.begin(), layer._labelEnds.end(), remainingGlyphs);
+                    const auto numFittingGlyphs = labelEnd != layer._labelEnds.begin() ? *std::prev(labelEnd) : 0;
+
+                    layer._glyphData.resize(numFittingGlyphs);
+                    layer._glyphNodeIds.resize(numFittingGlyphs);
+                    culled = true;
+
+                    if(layer._glyphData.empty())
+                        continue;
+                }
+            }
+
+            numGlyphs += layer._glyphData.size();
+
+            layer._overlayGPUGraphData = target.gpuGraphDataForOverlay(alpha);
+
+            if(layer._overlayGPUGraphData == nullptr)
+                continue;
+
+            auto& overlayGPUGraphData = *layer._overlayGPUGraphData;
+
+            layer._glyphOffset = overlayGPUGraphData._glyphData.size();
+            overlayGPUGraphData._glyphData.resize(layer._glyphOffset + layer._glyphData.size());
+            overlayGPUGraphData._glyphNodeIds.resize(overlayGPUGraphData._glyphData.size());
+        }
+
+        if(occludedEdges == nullptr)
+            continue;
+
+        for(const auto* edge : slice._occludedEdges)
+        {
+            occludedEdges->push_back({edge->sourceId(), edge->targetId(),
+                _graphModel->nodeVisual(edge->sourceId())._size,
+                _graphModel->nodeVisual(edge->targetId())._size,
+                _graphModel->edgeVisual(edge->id())._size});
+        }
+    }
+
+    if(!slices.empty())
+    {
+        concurrent_for(slices.begin(), slices.end(), [](const GPUGraphDataSlice& slice)
+        {
+            for(const auto& layer : slice._layers)
+            {
+                if(layer._gpuGraphData == nullptr)
+                    continue;
+
+                copyTo(layer._nodeData, layer._gpuGraphData->_nodeData, layer._nodeOffset);
+                copyTo(layer._nodeIds, layer._gpuGraphData->_nodeIds, layer._nodeOffset);
+                copyTo(layer._edgeData, layer._gpuGraphData->_edgeData, layer._edgeOffset);
+                copyTo(layer._edgeNodeIds, layer._gpuGraphData->_edgeNodeIds, layer._edgeOffset);
+
+                if(layer._overlayGPUGraphData == nullptr)
+                    continue;
+
+                copyTo(layer._glyphData, layer._overlayGPUGraphData->_glyphData, layer._glyphOffset);
+                copyTo(layer._glyphNodeIds, layer._overlayGPUGraphData->_glyphNodeIds, layer._glyphOffset);
+            }
+        });
+    }
+
+    return culled;
+}
+
+bool GraphRenderer::updateGPUPositionsInPlace()
+{
+    // What is culled depends on where things are, so once anything has been
+    // culled, the elements that remain are moved, and a rebuild is scheduled
+    if(_levelOfDetailCulled)
+        _levelOfDetailPositionsChanged = true;
+
+    auto nodePositions = _graphModel->nodePositions().snapshot();
+
+    // If any edge that was left out because its nodes covered it is now
+    // visible, the positions alone aren't enough
+    bool edgeUncovered = std::any_of(_occludedEdges.begin(), _occludedEdges.end(),
+    [&nodePositions](const OccludedEdge& edge)
+    {
+        return !edgeOccluded(nodePositions.get(edge._sourceId), nodePositions.get(edge._targetId),
+            edge._sourceSize, edge._targetSize, edge._size);
+    });
+
+    if(edgeUncovered)
+        return false;
+
+    std::vector<GPUPositionsSlice> slices;
+
+    for(auto& gpuGraphData : allGPUGraphData())
+    {
+        GPUPositionsSlice slice;
+        slice._gpuGraphData = &gpuGraphData;
+
+        slice._type = GPUPositionsSlice::Type::Nodes;
+        appendToSlices(slices, slice, gpuGraphData._nodeIds.size());
+        slice._type = GPUPositionsSlice::Type::Edges;
+        appendToSlices(slices, slice, gpuGraphData._edgeNodeIds.size());
+        slice._type = GPUPositionsSlice::Type::Glyphs;
+        appendToSlices(slices, slice, gpuGraphData._glyphNodeIds.size());
+    }
+
+    if(slices.empty())
+        return true;
+
+    concurrent_for(slices.begin(), slices.end(), [&nodePositions](const GPUPositionsSlice& slice)
+    {
+        auto& gpuGraphData = *slice._gpuGraphData;
+
+        for(auto i = slice._first; i < slice._last; i++)
+        {
+            switch(slice._type)
+            {
+            case GPUPositionsSlice::Type::Nodes:
+                setPosition(gpuGraphData._nodeData[i]._position, nodePositions.get(gpuGraphData._nodeIds[i]));
+                break;
+
+            case GPUPositionsSlice::Type::Edges:
+            {
+                const auto& [sourceId, targetId] = gpuGraphData._edgeNodeIds[i];
+                auto& edgeData = gpuGraphData._edgeData[i];
+                setPosition(edgeData._sourcePosition, nodePositions.get(sourceId));
+                setPosition(edgeData._targetPosition, nodePositions.get(targetId));
+                break;
+            }
+
+            case GPUPositionsSlice::Type::Glyphs:
+            {
+                const auto& [sourceId, targetId] = gpuGraphData._glyphNodeIds[i];
+                setPosition(gpuGraphData._glyphData[i]._basePosition,
+                    (nodePositions.get(sourceId) + nodePositions.get(targetId)) * 0.5f);
+                break;
+            }
+            }
+        }
+    });
+
+    return true;
 }
 
 void GraphRenderer::updateGPUData(GraphRenderer::When when)
@@ -385,6 +944,66 @@ void GraphRenderer::updateGPUData(GraphRenderer::When when)
         updateGPUDataIfRequired();
 }
 
+void GraphRenderer::updateGPUPositions()
+{
+    _gpuPositionsRequireUpdate = true;
+}
+
+bool GraphRenderer::levelOfDetailInvalidated()
+{
+    // Nothing was culled, so no view can show anything that's missing
+    if(!_levelOfDetailCulled)
+        return false;
+
+    bool changed = _levelOfDetailPositionsChanged;
+    bool largeChange = false;
+
+    size_t index = 0;
+    for(const auto& componentRendererRef : _componentRenderers)
+    {
+        GraphComponentRenderer* componentRenderer = componentRendererRef;
+        if(!componentRenderer->visible())
+            continue;
+
+        if(index >= _levelOfDetailViewProjections.size())
+        {
+            largeChange = true;
+            break;
+        }
+
+        const auto& viewProjection = componentRenderer->camera()->viewProjectionMatrix();
+        const auto& culledViewProjection = _levelOfDetailViewProjections.at(index);
+
+        if(viewProjection != culledViewProjection)
+        {
+            changed = true;
+
+            if(largeViewChange(culledViewProjection, viewProjection))
+                largeChange = true;
+        }
+
+        index++;
+    }
+
+    if(index != _levelOfDetailViewProjections.size())
+        largeChange = true;
+
+    if(!changed && !largeChange)
+        return false;
+
+    const auto elapsed = _levelOfDetailTimer.elapsed();
+
+    if(elapsed >= LevelOfDetailSettleInterval ||
+        (largeChange && elapsed >= MinimumLevelOfDetailRebuildInterval))
+    {
+        return true;
+    }
+
+    // Come back when it's time to rebuild, in case nothing else changes before then
+    update(); // QQuickFramebufferObject::Renderer::update
+    return false;
+}
+
 void GraphRenderer::onPreviewRequested(int width, int height, bool fillSize)
 {
     _screenshotRenderer->requestPreview(*this, width, height, fillSize);
@@ -809,6 +1428,14 @@ void GraphRenderer::onPreferenceChanged(const QString& key, const QVariant& valu
         _glyphMap->setFontName(value.toString());
         updateText();
     }
+    else if(key.startsWith(QLatin1String("visuals/levelOfDetail")))
+    {
+        executeOnRendererThread([this]
+        {
+            updateGPUData(When::Later);
+            update(); // QQuickFramebufferObject::Renderer::update
+        }, QStringLiteral("GraphRenderer::onPreferenceChanged"));
+    }
 }
 
 void GraphRenderer::onCommandsStarted()
@@ -851,11 +1478,13 @@ void GraphRenderer::updateText(std::function<void()> onCompleteFn) // NOLINT
 {
     std::unique_lock<std::recursive_mutex> glyphMapLock(_glyphMap->mutex());
 
+    auto visualStrings = _graphModel->visualStrings();
+
     for(auto nodeId : _graphModel->graph().nodeIds())
-        _glyphMap->addText(_graphModel->nodeVisual(nodeId)._text);
+        _glyphMap->addText(visualStrings.at(_graphModel->nodeVisual(nodeId)._text));
 
     for(auto edgeId : _graphModel->graph().edgeIds())
-        _glyphMap->addText(_graphModel->edgeVisual(edgeId)._text);
+        _glyphMap->addText(visualStrings.at(_graphModel->edgeVisual(edgeId)._text));
 
     if(_glyphMap->updateRequired())
     {
@@ -984,6 +1613,9 @@ void GraphRenderer::updateScene()
         _scene->update(dTime);
 
         if(layoutChanged())
+            updateGPUPositions();
+
+        if(levelOfDetailInvalidated())
             updateGPUData(When::Later);
 
         updateGPUDataIfRequired();
@@ -1052,11 +1684,13 @@ GraphRenderer::Mode GraphRenderer::bestFocusParameters(GraphQuickItem* graphQuic
 
     // If the request is for more than 1 node, then find their barycentre and
     // pick the closest node to where ever this happens to be
+    auto nodePositions = _graphModel->nodePositions().snapshot();
+
     std::vector<QVector3D> points(nodeIds.size());
     size_t i = 0;
     for(auto nodeId : nodeIds)
     {
-        auto nodePosition = _graphModel->nodePositions().get(nodeId);
+        auto nodePosition = nodePositions.get(nodeId);
         points.at(i++) = nodePosition;
     }
 
@@ -1066,7 +1700,7 @@ GraphRenderer::Mode GraphRenderer::bestFocusParameters(GraphQuickItem* graphQuic
     NodeId closestToCentreNodeId;
     for(auto nodeId : nodeIds)
     {
-        auto nodePosition = _graphModel->nodePositions().get(nodeId);
+        auto nodePosition = nodePositions.get(nodeId);
         float distance = (centre - nodePosition).length();
 
         if(distance < minDistance)
@@ -1077,7 +1711,7 @@ GraphRenderer::Mode GraphRenderer::bestFocusParameters(GraphQuickItem* graphQuic
     }
 
     radius = GraphComponentRenderer::maxNodeDistanceFromPoint(*_graphModel,
-        _graphModel->nodePositions().get(closestToCentreNodeId), nodeIds);
+        nodePositions.get(closestToCentreNodeId), nodeIds);
     focusNodeId = closestToCentreNodeId;
 
     return mode();
@@ -28,6 +28,7 @@
 #include "doublebufferedtexture.h"
 #include "projection.h"
 #include "shading.h"
+#include "levelofdetail.h"
 
 #include "shared/graph/grapharray.h"
 #include "graph/qmlelementid.h"
@@ -233,6 +234,27 @@ private:
     EdgeArray<bool> _hiddenEdges;
 
     bool _gpuDataRequiresUpdate = false;
+    bool _gpuPositionsRequireUpdate = false;
+
+    // Edges that were left out of the GPU data because they were entirely hidden
+    // by their nodes, which must be rebuilt should any of them become visible
+    struct OccludedEdge
+    {
+        NodeId _sourceId;
+        NodeId _targetId;
+        float _sourceSize = 0.0f;
+        float _targetSize = 0.0f;
+        float _size = 0.0f;
+    };
+
+    std::vector<OccludedEdge> _occludedEdges;
+
+    // Whether the level of detail left anything out of the GPU data, and the
+    // views it did so for, which when they change will require a rebuild
+    bool _levelOfDetailCulled = false;
+    bool _levelOfDetailPositionsChanged = false;
+    std::vector<QMatrix4x4> _levelOfDetailViewProjections;
+    QElapsedTimer _levelOfDetailTimer;
 
     QRect _selectionRect;
 
@@ -262,8 +284,16 @@ private:
     void clearHiddenElements();
 
     void updateGPUDataIfRequired();
+
+    // Builds the GPU data for the visible components into target, which is either this
+    // renderer or one that is copying it, and returns true if anything was culled
+    bool buildGPUGraphData(GraphRendererCore& target, const LevelOfDetail::Settings& levelOfDetailSettings,
+        std::vector<OccludedEdge>* occludedEdges = nullptr) const;
     enum class When { Later, Now };
     void updateGPUData(When when);
+    void updateGPUPositions();
+    bool updateGPUPositionsInPlace();
+    bool levelOfDetailInvalidated();
     void updateComponentGPUData();
 
     // For high DPI displays (mostly MacOS "Retina" display)
@@ -304,9 +334,11 @@ private:
     void moveFocusToNode(NodeId nodeId, float radius = -1.0f);
     void moveFocusToComponent(ComponentId componentId);
 
+    // The height of text once laid out, in the same units as the graph
+    float textHeight(const QString& text, float textScale) const;
     void createGPUGlyphData(const QString& text, const QColor& textColor, const TextAlignment& textAlignment,
                          float textScale, float elementSize, const QVector3D& elementPosition,
-                         int componentIndex, GPUGraphData* gpuGraphData);
+                         int componentIndex, std::vector<GPUGraphData::GlyphData>& glyphs) const;
 
 signals:
     void initialised() const;
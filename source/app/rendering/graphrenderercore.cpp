@@ -164,8 +164,10 @@ void GPUGraphData::prepareNodeVAO(QOpenGLShaderProgram& shader)
     glVertexAttribIPointer(shader.attributeLocation("component"),                          1, GL_INT, sizeof(NodeData),
                           reinterpret_cast<const void*>(offsetof(NodeData, _component))); // NOLINT
     shader.setAttributeBuffer("size",         GL_FLOAT, offsetof(NodeData, _size),         1,         sizeof(NodeData));
-    shader.setAttributeBuffer("outerColor",   GL_FLOAT, offsetof(NodeData, _outerColor),   3,         sizeof(NodeData));
-    shader.setAttributeBuffer("innerColor",   GL_FLOAT, offsetof(NodeData, _innerColor),   3,         sizeof(NodeData));
+    glVertexAttribPointer(shader.attributeLocation("outerColor"),                          3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(NodeData),
+                          reinterpret_cast<const void*>(offsetof(NodeData, _outerColor))); // NOLINT
+    glVertexAttribPointer(shader.attributeLocation("innerColor"),                          3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(NodeData),
+                          reinterpret_cast<const void*>(offsetof(NodeData, _innerColor))); // NOLINT
     shader.setAttributeBuffer("selected",     GL_FLOAT, offsetof(NodeData, _selected),     1,         sizeof(NodeData));
     glVertexAttribDivisor(shader.attributeLocation("nodePosition"), 1);
     glVertexAttribDivisor(shader.attributeLocation("component"),    1);
@@ -204,8 +206,10 @@ void GPUGraphData::prepareEdgeVAO(QOpenGLShaderProgram& shader)
     glVertexAttribIPointer(shader.attributeLocation("component"),                               1, GL_INT, sizeof(EdgeData),
                            reinterpret_cast<const void*>(offsetof(EdgeData, _component))); // NOLINT
     shader.setAttributeBuffer("size",           GL_FLOAT, offsetof(EdgeData, _size),            1,         sizeof(EdgeData));
-    shader.setAttributeBuffer("outerColor",     GL_FLOAT, offsetof(EdgeData, _outerColor),      3,         sizeof(EdgeData));
-    shader.setAttributeBuffer("innerColor",     GL_FLOAT, offsetof(EdgeData, _innerColor),      3,         sizeof(EdgeData));
+    glVertexAttribPointer(shader.attributeLocation("outerColor"),                               3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(EdgeData),
+                          reinterpret_cast<const void*>(offsetof(EdgeData, _outerColor))); // NOLINT
+    glVertexAttribPointer(shader.attributeLocation("innerColor"),                               3, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(EdgeData),
+                          reinterpret_cast<const void*>(offsetof(EdgeData, _innerColor))); // NOLINT
     shader.setAttributeBuffer("selected",       GL_FLOAT, offsetof(EdgeData, _selected),        1,         sizeof(EdgeData));
     glVertexAttribDivisor(shader.attributeLocation("sourcePosition"),   1);
     glVertexAttribDivisor(shader.attributeLocation("targetPosition"),   1);
@@ -255,6 +259,9 @@ void GPUGraphData::reset()
     _nodeData.clear();
     _edgeData.clear();
     _glyphData.clear();
+    _nodeIds.clear();
+    _edgeNodeIds.clear();
+    _glyphNodeIds.clear();
 }
 
 void GPUGraphData::clearFramebuffer(GLbitfield buffers)
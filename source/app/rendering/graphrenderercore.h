@@ -26,6 +26,8 @@
 #include "primitives/rectangle.h"
 #include "primitives/sphere.h"
 
+#include "shared/graph/elementid.h"
+#include "shared/ui/visualisations/elementvisual.h"
 #include "shared/utils/flags.h"
 
 #include <QOpenGLBuffer>
@@ -35,6 +37,7 @@
 #include <QMatrix4x4>
 
 #include <array>
+#include <utility>
 #include <vector>
 
 class ScreenshotRenderer;
@@ -84,8 +87,8 @@ struct GPUGraphData : OpenGLFunctions
         float _position[3] = {0.0f, 0.0f, 0.0f};
         int _component = -1;
         float _size = -1.0f;
-        float _outerColor[3] = {0.0f, 0.0f, 0.0f};
-        float _innerColor[3] = {0.0f, 0.0f, 0.0f};
+        PackedColor _outerColor;
+        PackedColor _innerColor;
         float _selected = 0.0f;
     };
 
@@ -98,8 +101,8 @@ struct GPUGraphData : OpenGLFunctions
         int _edgeType = -1;
         int _component = -1;
         float _size = -1.0f;
-        float _outerColor[3] = {0.0f, 0.0f, 0.0f};
-        float _innerColor[3] = {0.0f, 0.0f, 0.0f};
+        PackedColor _outerColor;
+        PackedColor _innerColor;
         float _selected = 0.0f;
     };
 
@@ -132,6 +135,15 @@ struct GPUGraphData : OpenGLFunctions
     std::vector<EdgeData> _edgeData;
     QOpenGLBuffer _edgeVBO;
 
+    // The nodes whose positions each node, edge and glyph are placed at, so that
+    // when only the layout changes, the positions can be updated in place; a
+    // glyph is placed at the midpoint of its pair, which is the same node twice
+    // for node text
+    using NodeIdPair = std::pair<NodeId, NodeId>;
+    std::vector<NodeId> _nodeIds;
+    std::vector<NodeIdPair> _edgeNodeIds;
+    std::vector<NodeIdPair> _glyphNodeIds;
+
     bool _elementsSelected = false;
 
     GLuint _fbo = 0;
@@ -142,6 +154,7 @@ struct GPUGraphData : OpenGLFunctions
 
 class GraphRendererCore : public OpenGLFunctions
 {
+    friend class GraphRenderer;
     friend class ScreenshotRenderer;
 
 public:
@@ -196,6 +209,7 @@ protected:
 
     GPUGraphData* gpuGraphDataForAlpha(float componentAlpha, float unhighlightAlpha);
     GPUGraphData* gpuGraphDataForOverlay(float alpha);
+    std::array<GPUGraphData, 7>& allGPUGraphData() { return _gpuGraphData; }
     void resetGPUGraphData();
     void uploadGPUGraphData();
 
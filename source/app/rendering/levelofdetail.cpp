@@ -0,0 +1,135 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "levelofdetail.h"
+
+#include "camera.h"
+
+#include "shared/utils/preferences.h"
+
+#include <QVector4D>
+
+#include <algorithm>
+#include <cmath>
+
+LevelOfDetail::Settings LevelOfDetail::Settings::fromPreferences()
+{
+    Settings settings;
+
+    settings._enabled = u::pref(QStringLiteral("visuals/levelOfDetail")).toBool();
+    settings._minimumEdgeSize = u::pref(QStringLiteral("visuals/levelOfDetailMinimumEdgeSize")).toFloat();
+    settings._nodeAggregationSize = std::max(u::pref(QStringLiteral("visuals/levelOfDetailNodeAggregationSize")).toFloat(), 0.0f);
+    settings._minimumTextSize = u::pref(QStringLiteral("visuals/levelOfDetailMinimumTextSize")).toFloat();
+    settings._maximumGlyphs = u::pref(QStringLiteral("visuals/levelOfDetailMaximumGlyphs")).toInt();
+
+    return settings;
+}
+
+LevelOfDetail::LevelOfDetail(const Settings& settings, const Camera& camera) :
+    _settings(settings),
+    _viewProjectionMatrix(camera.viewProjectionMatrix()),
+    _width(static_cast<float>(camera.viewport().width())),
+    _height(static_cast<float>(camera.viewport().height()))
+{
+    // The number of pixels a unit at a clip space w of 1 covers; this holds for
+    // both projection types, as w is always 1 for an orthographic projection
+    _pixelScale = camera.projectionMatrix()(0, 0) * _width * 0.5f;
+
+    if(_width <= 0.0f || _height <= 0.0f)
+        _settings._enabled = false;
+}
+
+LevelOfDetail::ScreenSpace LevelOfDetail::project(const QVector3D& position, float radius) const
+{
+    ScreenSpace screenSpace;
+
+    auto clip = _viewProjectionMatrix * QVector4D(position, 1.0f);
+
+    // Behind the camera
+    if(clip.w() <= 0.0f)
+    {
+        screenSpace._onScreen = false;
+        return screenSpace;
+    }
+
+    screenSpace._x = ((clip.x() / clip.w()) * 0.5f + 0.5f) * _width;
+    screenSpace._y = ((clip.y() / clip.w()) * 0.5f + 0.5f) * _height;
+    screenSpace._pixelsPerUnit = _pixelScale / clip.w();
+    screenSpace._radius = radius * screenSpace._pixelsPerUnit;
+
+    const auto r = screenSpace._radius;
+    screenSpace._onScreen =
+        screenSpace._x + r >= 0.0f && screenSpace._x - r <= _width &&
+        screenSpace._y + r >= 0.0f && screenSpace._y - r <= _height;
+
+    return screenSpace;
+}
+
+bool LevelOfDetail::aggregated(const ScreenSpace& node) const
+{
+    return node._onScreen && node._radius * 2.0f < _settings._nodeAggregationSize;
+}
+
+uint64_t LevelOfDetail::cellFor(const ScreenSpace& node) const
+{
+    auto x = static_cast<int32_t>(std::floor(node._x / _settings._nodeAggregationSize));
+    auto y = static_cast<int32_t>(std::floor(node._y / _settings._nodeAggregationSize));
+
+    return (static_cast<uint64_t>(static_cast<uint32_t>(x)) << 32) | static_cast<uint32_t>(y);
+}
+
+float LevelOfDetail::aggregateSize(const ScreenSpace& node, float size) const
+{
+    if(node._pixelsPerUnit <= 0.0f)
+        return size;
+
+    return std::max(size, (_settings._nodeAggregationSize * 0.5f) / node._pixelsPerUnit);
+}
+
+bool LevelOfDetail::edgeVisible(const ScreenSpace& source, const ScreenSpace& target, float edgeSize) const
+{
+    // An end is behind the camera, so where the edge crosses the screen is unknown
+    if(source._pixelsPerUnit <= 0.0f || target._pixelsPerUnit <= 0.0f)
+        return true;
+
+    if(!source._onScreen && !target._onScreen)
+    {
+        // Both ends are off screen, but the edge may still cross it, so only
+        // reject it when both ends are off the same side
+        if((source._x < 0.0f && target._x < 0.0f) || (source._x > _width && target._x > _width) ||
+            (source._y < 0.0f && target._y < 0.0f) || (source._y > _height && target._y > _height))
+        {
+            return false;
+        }
+    }
+
+    const auto pixelsPerUnit = std::max(source._pixelsPerUnit, target._pixelsPerUnit);
+    if(edgeSize * 2.0f * pixelsPerUnit < _settings._minimumEdgeSize)
+        return false;
+
+    // Both ends are represented by the same node
+    if(aggregated(source) && aggregated(target) && cellFor(source) == cellFor(target))
+        return false;
+
+    return true;
+}
+
+bool LevelOfDetail::textVisible(const ScreenSpace& element, float textHeight) const
+{
+    return element._onScreen && textHeight * element._pixelsPerUnit >= _settings._minimumTextSize;
+}
@@ -0,0 +1,84 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef LEVELOFDETAIL_H
+#define LEVELOFDETAIL_H
+
+#include <QMatrix4x4>
+#include <QVector3D>
+
+#include <cstdint>
+
+class Camera;
+
+// Decides, using a component's camera, which of its elements cover too few
+// pixels, or are too far off screen, to be worth sending to the GPU
+class LevelOfDetail
+{
+public:
+    struct Settings
+    {
+        bool _enabled = false;
+
+        // All sizes are in pixels
+        float _minimumEdgeSize = 0.25f;
+        float _nodeAggregationSize = 1.0f;
+        float _minimumTextSize = 4.0f;
+        int _maximumGlyphs = 100000;
+
+        static Settings fromPreferences();
+    };
+
+    // Where an element appears on screen, and how big it is there
+    struct ScreenSpace
+    {
+        float _x = 0.0f;
+        float _y = 0.0f;
+        float _pixelsPerUnit = 0.0f;
+        float _radius = 0.0f;
+        bool _onScreen = true;
+    };
+
+    LevelOfDetail() = default;
+    LevelOfDetail(const Settings& settings, const Camera& camera);
+
+    bool enabled() const { return _settings._enabled; }
+    const Settings& settings() const { return _settings; }
+
+    ScreenSpace project(const QVector3D& position, float radius) const;
+
+    // Nodes smaller than the aggregation size are represented by one node
+    // per cell of that size; that node is enlarged so that it fills its cell
+    bool aggregated(const ScreenSpace& node) const;
+    uint64_t cellFor(const ScreenSpace& node) const;
+    float aggregateSize(const ScreenSpace& node, float size) const;
+
+    bool edgeVisible(const ScreenSpace& source, const ScreenSpace& target, float edgeSize) const;
+    // Whether an element's label, textHeight units tall, is large enough to read
+    bool textVisible(const ScreenSpace& element, float textHeight) const;
+
+private:
+    Settings _settings;
+
+    QMatrix4x4 _viewProjectionMatrix;
+    float _pixelScale = 0.0f;
+    float _width = 0.0f;
+    float _height = 0.0f;
+};
+
+#endif // LEVELOFDETAIL_H
@@ -24,7 +24,7 @@
 #include "graphoverviewscene.h"
 #include "shared/utils/preferences.h"
 #include "ui/document.h"
-#include "ui/visualisations/elementvisual.h"
+#include "shared/ui/visualisations/elementvisual.h"
 
 #include <QBuffer>
 #include <QDir>
@@ -212,8 +212,18 @@ bool ScreenshotRenderer::copyState(const GraphRenderer& renderer)
 {
     _componentCameraAndLightings.clear();
 
-    for(size_t i = 0; i < renderer._gpuGraphData.size(); ++i)
-        _gpuGraphData.at(i).copyState(renderer._gpuGraphData.at(i), _nodesShader, _edgesShader, _textShader);
+    if(renderer._levelOfDetailCulled)
+    {
+        // What the renderer culled depends on its own view, which at the resolution of
+        // the screenshot is likely to be missing detail, so rebuild it in full instead
+        std::unique_lock<std::recursive_mutex> glyphMapLock(renderer._glyphMap->mutex());
+        renderer.buildGPUGraphData(*this, LevelOfDetail::Settings{});
+    }
+    else
+    {
+        for(size_t i = 0; i < renderer._gpuGraphData.size(); ++i)
+            _gpuGraphData.at(i).copyState(renderer._gpuGraphData.at(i), _nodesShader, _edgesShader, _textShader);
+    }
 
     for(const auto& componentRendererRef : renderer.componentRenderers())
     {
@@ -58,6 +58,13 @@ TransformedGraph::TransformedGraph(GraphModel& graphModel, const MutableGraph& s
     connect(&_target, &Graph::edgeRemoved, [this](const Graph*, EdgeId edgeId) { _edgesState[edgeId].remove(); });
     connect(&_target, &Graph::edgeAdded,   [this](const Graph*, EdgeId edgeId) { _edgesState[edgeId].add(); });
 
+    // Any structural change to the target makes the adjacency snapshot stale
+    connect(&_target, &Graph::graphWillChange, [this] { invalidateAdjacencySnapshot(); });
+    connect(&_target, &Graph::nodeRemoved, [this] { invalidateAdjacencySnapshot(); });
+    connect(&_target, &Graph::nodeAdded,   [this] { invalidateAdjacencySnapshot(); });
+    connect(&_target, &Graph::edgeRemoved, [this] { invalidateAdjacencySnapshot(); });
+    connect(&_target, &Graph::edgeAdded,   [this] { invalidateAdjacencySnapshot(); });
+
     addTransform(std::make_unique<IdentityTransform>());
 }
 
@@ -76,14 +83,32 @@ void TransformedGraph::setProgress(int progress)
         _command->setProgress(progress);
 }
 
+std::shared_ptr<const AdjacencySnapshot> TransformedGraph::adjacencySnapshot() const
+{
+    std::unique_lock<std::mutex> lock(_adjacencySnapshotMutex);
+
+    if(_adjacencySnapshot == nullptr)
+        _adjacencySnapshot = std::make_shared<const AdjacencySnapshot>(_target);
+
+    return _adjacencySnapshot;
+}
+
+void TransformedGraph::invalidateAdjacencySnapshot()
+{
+    std::unique_lock<std::mutex> lock(_adjacencySnapshotMutex);
+    _adjacencySnapshot.reset();
+}
+
 void TransformedGraph::reserve(const Graph& other)
 {
+    invalidateAdjacencySnapshot();
     _target.reserve(other);
     Graph::reserve(other);
 }
 
 TransformedGraph& TransformedGraph::operator=(const MutableGraph& other)
 {
+    invalidateAdjacencySnapshot();
     _target = other;
     Graph::reserve(other);
 
@@ -24,6 +24,7 @@
 
 #include "graph/graph.h"
 #include "graph/mutablegraph.h"
+#include "graph/adjacencysnapshot.h"
 
 #include "shared/graph/grapharray.h"
 #include "shared/utils/passkey.h"
@@ -36,6 +37,7 @@
 
 #include <functional>
 #include <atomic>
+#include <memory>
 #include <mutex>
 
 class GraphModel;
@@ -84,7 +86,11 @@ public:
 
     void setProgress(int progress);
 
-    MutableGraph& mutableGraph() { return _target; }
+    MutableGraph& mutableGraph() { invalidateAdjacencySnapshot(); return _target; }
+
+    // A read-only CSR view of the current graph, for traversal heavy transforms;
+    // it is built on first use and shared until the graph next changes
+    std::shared_ptr<const AdjacencySnapshot> adjacencySnapshot() const;
 
     void reserve(const Graph& other) override;
     TransformedGraph& operator=(const MutableGraph& other);
@@ -125,6 +131,9 @@ private:
     std::mutex _currentTransformMutex;
     GraphTransform* _currentTransform = nullptr;
 
+    mutable std::mutex _adjacencySnapshotMutex;
+    mutable std::shared_ptr<const AdjacencySnapshot> _adjacencySnapshot;
+
     class State
     {
     private:
@@ -146,6 +155,8 @@ private:
 
     void rebuild();
 
+    void invalidateAdjacencySnapshot();
+
     void setCurrentTransform(GraphTransform* currentTransform);
 
 private slots:
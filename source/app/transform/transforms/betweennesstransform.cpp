@@ -23,15 +23,21 @@
 
 #include "shared/graph/grapharray.h"
 #include "shared/utils/threadpool.h"
+#include "shared/utils/scopetimer.h"
+#include "shared/utils/scratcharray.h"
 
 #include <cstdint>
-#include <stack>
-#include <queue>
+#include <cmath>
 #include <map>
-#include <thread>
+#include <vector>
+#include <random>
+#include <algorithm>
+#include <iterator>
 
 void BetweennessTransform::apply(TransformedGraph& target) const
 {
+    SCOPE_TIMER
+
     target.setPhase(QStringLiteral("Betweenness"));
     target.setProgress(0);
 
@@ -39,22 +45,55 @@ void BetweennessTransform::apply(TransformedGraph& target) const
     const auto& edegIds = target.edgeIds();
     std::atomic_int progress(0);
 
+    auto adjacency = target.adjacencySnapshot();
+
+    const auto numNodes = static_cast<size_t>(adjacency->numNodes());
+
+    auto numSamples = config().hasParameter(QStringLiteral("Samples")) ?
+        std::get<int>(config().parameterByName(QStringLiteral("Samples"))->_value) : 0;
+
+    // When sampling, the shortest paths are only computed from a random subset
+    // of source nodes, and the totals are scaled up accordingly; this gives an
+    // unbiased estimate of the exact value (Brandes and Pich, 2007)
+    const bool sampled = numSamples > 0 && static_cast<size_t>(numSamples) < numNodes;
+
+    std::vector<NodeId> sampledNodeIds;
+    if(sampled)
+    {
+        // A fixed seed, so that reapplying the transform gives the same result
+        std::mt19937 generator(0);
+        sampledNodeIds.reserve(static_cast<size_t>(numSamples));
+        std::sample(nodeIds.begin(), nodeIds.end(), std::back_inserter(sampledNodeIds),
+            numSamples, generator);
+    }
+
+    const auto& sourceNodeIds = sampled ? sampledNodeIds : nodeIds;
+
     struct BetweennessArrays
     {
-        explicit BetweennessArrays(TransformedGraph& graph) :
+        BetweennessArrays(TransformedGraph& graph, size_t numNodes) :
             nodeBetweenness(graph, 0.0),
-            edgeBetweenness(graph, 0.0)
+            edgeBetweenness(graph, 0.0),
+            sigma(numNodes, 0),
+            distance(numNodes, -1),
+            delta(numNodes, 0.0)
         {}
 
         NodeArray<double> nodeBetweenness;
         EdgeArray<double> edgeBetweenness;
+
+        // Per source scratch state, reset between sources
+        ScratchArray<int64_t> sigma;
+        ScratchArray<int64_t> distance;
+        ScratchArray<double> delta;
+        std::vector<int> order;
     };
 
     std::vector<BetweennessArrays> betweennessArrays(
-        std::thread::hardware_concurrency(),
-        BetweennessArrays{target});
+        S(ThreadPoolSingleton)->numThreads(),
+        BetweennessArrays{target, numNodes});
 
-    concurrent_for(nodeIds.begin(), nodeIds.end(),
+    concurrent_for(sourceNodeIds.begin(), sourceNodeIds.end(),
     [&](const NodeId nodeId, size_t threadIndex)
     {
         auto& arrays = betweennessArrays.at(threadIndex);
@@ -62,63 +101,67 @@ void BetweennessTransform::apply(TransformedGraph& target) const
         auto& _edgeBetweenness = arrays.edgeBetweenness;
 
         // Brandes algorithm
-        NodeArray<std::vector<NodeId>> predecessors(target);
-        NodeArray<int64_t> sigma(target, 0);
-        NodeArray<int64_t> distance(target, -1);
-        NodeArray<double> delta(target, 0.0);
-
-        std::stack<NodeId> stack;
-        std::queue<NodeId> queue;
-
-        sigma[nodeId] = 1.0;
-        distance[nodeId] = 0;
-        queue.push(nodeId);
-
-        while(!queue.empty() && !cancelled())
+        auto& sigma = arrays.sigma;
+        auto& distance = arrays.distance;
+        auto& delta = arrays.delta;
+        sigma.reset();
+        distance.reset();
+        delta.reset();
+
+        // Nodes in the order they are visited; this is the BFS queue,
+        // and reversed it's the stack of the accumulation phase
+        auto& order = arrays.order;
+        order.clear();
+
+        auto sourceIndex = adjacency->indexOf(nodeId);
+        sigma[sourceIndex] = 1;
+        distance[sourceIndex] = 0;
+        order.push_back(sourceIndex);
+
+        for(size_t head = 0; head < order.size() && !cancelled(); head++)
         {
-            auto other = queue.front();
-            queue.pop();
-            stack.push(other);
+            auto other = order[head];
 
-            for(auto neighbour : target.neighboursOf(other))
+            for(auto neighbour : adjacency->neighbours(other))
             {
-                if(distance[neighbour] < 0)
+                if(distance.get(neighbour) < 0)
                 {
-                    queue.push(neighbour);
-                    distance[neighbour] = distance[other] + 1;
+                    order.push_back(neighbour);
+                    distance[neighbour] = distance.get(other) + 1;
                 }
 
-                if(distance[neighbour] == distance[other] + 1)
-                {
-                    sigma[neighbour] += sigma[other];
-                    predecessors[neighbour].push_back(other);
-                }
+                if(distance.get(neighbour) == distance.get(other) + 1)
+                    sigma[neighbour] += sigma.get(other);
             }
         }
 
-        while(!stack.empty() && !cancelled())
+        for(auto it = order.rbegin(); it != order.rend() && !cancelled(); ++it)
         {
-            auto other = stack.top();
-            stack.pop();
+            auto other = *it;
+            auto otherNodeId = adjacency->nodeIdAt(other);
 
-            for(auto predecessor : predecessors[other])
+            // The predecessors of other are its neighbours one step closer to the source
+            for(auto predecessor : adjacency->neighbours(other))
             {
-                auto d = (static_cast<double>(sigma[predecessor]) /
-                    static_cast<double>(sigma[other])) * (1.0 + delta[other]);
+                if(distance.get(predecessor) != distance.get(other) - 1)
+                    continue;
+
+                auto d = (static_cast<double>(sigma.get(predecessor)) /
+                    static_cast<double>(sigma.get(other))) * (1.0 + delta.get(other));
 
-                auto edgeIds = target.edgeIdsBetween(predecessor, other);
+                auto edgeIds = target.edgeIdsBetween(adjacency->nodeIdAt(predecessor), otherNodeId);
                 for(auto edgeId : edgeIds)
                     _edgeBetweenness[edgeId] += d;
 
                 delta[predecessor] += d;
             }
 
-            if(other != nodeId)
-                _nodeBetweenness[other] += delta[other];
+            if(other != sourceIndex)
+                _nodeBetweenness[otherNodeId] += delta.get(other);
         }
 
         progress++;
-        target.setProgress(progress.load() * 100 / static_cast<int>(target.numNodes()));
+        target.setProgress(progress.load() * 100 / static_cast<int>(sourceNodeIds.size()));
 
         if(cancelled())
             return;
@@ -140,13 +183,45 @@ void BetweennessTransform::apply(TransformedGraph& target) const
             edgeBetweenness[edgeId] += arrays.edgeBetweenness[edgeId];
     }
 
+    auto nodeDescription = QObject::tr("A node's betweenness is the number of shortest paths that pass through it.");
+    auto edgeDescription = QObject::tr("An edge's betweenness is the number of shortest paths that pass through it.");
+
+    if(sampled)
+    {
+        const auto n = static_cast<double>(numNodes);
+        const auto k = static_cast<double>(numSamples);
+        const auto scale = n / k;
+
+        for(auto nodeId : nodeIds)
+            nodeBetweenness[nodeId] *= scale;
+
+        for(auto edgeId : edegIds)
+            edgeBetweenness[edgeId] *= scale;
+
+        // Each source contributes at most n - 2 to a node's betweenness, so by
+        // Hoeffding's inequality and a union bound over the nodes, every estimate
+        // lies within this distance of its exact value, with the given confidence
+        const double confidence = 0.95;
+        auto errorBound = n * (n - 2.0) * std::sqrt(std::log(2.0 * n / (1.0 - confidence)) / (2.0 * k));
+
+        auto approximation = QObject::tr("Estimated from the shortest paths of %1 of %2 nodes; "
+            "with %3% confidence, every value is within %4 of the exact betweenness.")
+            .arg(numSamples).arg(numNodes).arg(confidence * 100.0)
+            .arg(QString::number(errorBound, 'g', 3));
+
+        nodeDescription += QStringLiteral(" ") + approximation;
+        edgeDescription += QStringLiteral(" ") + approximation;
+
+        addAlert(AlertType::Warning, approximation);
+    }
+
     _graphModel->createAttribute(QObject::tr("Node Betweenness"))
-        .setDescription(QObject::tr("A node's betweenness is the number of shortest paths that pass through it."))
+        .setDescription(nodeDescription)
         .setFloatValueFn([nodeBetweenness](NodeId nodeId) { return nodeBetweenness[nodeId]; })
         .setFlag(AttributeFlag::VisualiseByComponent);
 
     _graphModel->createAttribute(QObject::tr("Edge Betweenness"))
-        .setDescription(QObject::tr("An edge's betweenness is the number of shortest paths that pass through it."))
+        .setDescription(edgeDescription)
         .setFloatValueFn([edgeBetweenness](EdgeId edgeId) { return edgeBetweenness[edgeId]; })
         .setFlag(AttributeFlag::VisualiseByComponent);
 }
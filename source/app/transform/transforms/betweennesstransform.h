@@ -50,6 +50,20 @@ public:
     }
     QString category() const override { return QObject::tr("Metrics"); }
     ElementType elementType() const override { return ElementType::None; }
+
+    GraphTransformParameters parameters() const override
+    {
+        return
+        {
+            {
+                "Samples", ValueType::Int,
+                QObject::tr("The number of randomly chosen nodes from which shortest paths are found. "
+                    "Fewer samples give a faster, but less accurate, estimate of betweenness. "
+                    "If 0, or at least the number of nodes, betweenness is calculated exactly."),
+                0, 0
+            }
+        };
+    }
     DefaultVisualisations defaultVisualisations() const override
     {
         return
@@ -21,8 +21,38 @@
 #include "graph/graphmodel.h"
 #include "shared/utils/threadpool.h"
 
-#include <map>
-#include <queue>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <vector>
+
+namespace
+{
+// Breadth first searches from up to this many sources are run simultaneously, in a single
+// sweep of the graph, with each source represented by one bit of a mask (Then et al., 2014)
+using SourceMask = uint64_t;
+constexpr int SourcesPerSweep = std::numeric_limits<SourceMask>::digits;
+
+// Per thread state for a sweep, indexed by node
+struct SweepState
+{
+    explicit SweepState(size_t numNodes) :
+        visited(numNodes, 0), frontier(numNodes, 0), next(numNodes, 0)
+    {}
+
+    // The sources whose searches have reached each node
+    std::vector<SourceMask> visited;
+
+    // The sources whose searches reached each node at the current and next level
+    std::vector<SourceMask> frontier;
+    std::vector<SourceMask> next;
+
+    std::vector<int> frontierNodes;
+    std::vector<int> nextNodes;
+};
+} // namespace
 
 void EccentricityTransform::apply(TransformedGraph& target) const
 {
@@ -32,83 +62,116 @@ void EccentricityTransform::apply(TransformedGraph& target) const
 
 void EccentricityTransform::calculateDistances(TransformedGraph& target) const
 {
-    // Setup the contiguous ids
-    std::map<NodeId, int> nodeIdToMatrixIndex;
-    std::map<int, NodeId> matrixIndexToNodeId;
-    for(auto nodeId : target.nodeIds())
-    {
-        auto size = static_cast<int>(nodeIdToMatrixIndex.size());
-        nodeIdToMatrixIndex[nodeId] = size;
-        matrixIndexToNodeId[size - 1] = nodeId;
-    }
+    auto adjacency = target.adjacencySnapshot();
+    const auto numNodes = adjacency->numNodes();
 
-    NodeArray<int> maxDistances(target);
+    // Indexed by adjacency index
+    std::vector<int> eccentricities(static_cast<size_t>(numNodes), 0);
+
+    std::vector<SweepState> sweepStates(
+        S(ThreadPoolSingleton)->numThreads(),
+        SweepState{static_cast<size_t>(numNodes)});
+
+    std::vector<int> sweeps((numNodes + SourcesPerSweep - 1) / SourcesPerSweep);
+    std::iota(sweeps.begin(), sweeps.end(), 0);
 
     target.setProgress(0);
 
-    const auto& nodeIds = target.nodeIds();
     std::atomic_int progress(0);
-    concurrent_for(nodeIds.begin(), nodeIds.end(),
-    [this, &maxDistances, &progress, &target](const NodeId source)
+    if(!sweeps.empty())
     {
-        if(cancelled())
-            return;
+        concurrent_for(sweeps.begin(), sweeps.end(),
+        [&](const int sweep, size_t threadIndex)
+        {
+            if(cancelled())
+                return;
 
-        NodeArray<int> distance(target);
-        NodeArray<bool> visited(target);
+            auto& state = sweepStates.at(threadIndex);
+            auto& visited = state.visited;
+            auto& frontier = state.frontier;
+            auto& next = state.next;
+            auto& frontierNodes = state.frontierNodes;
+            auto& nextNodes = state.nextNodes;
 
-        auto comparator = [&distance](NodeId a, NodeId b){ return distance[a] > distance[b]; };
-        std::priority_queue<NodeId, std::vector<NodeId>, decltype(comparator)> queue(comparator);
+            std::fill(visited.begin(), visited.end(), 0);
+            frontierNodes.clear();
 
-        for(auto nodeId : target.nodeIds())
-            distance[nodeId] = std::numeric_limits<int>::max();
+            const int firstSource = sweep * SourcesPerSweep;
+            const int numSources = std::min(SourcesPerSweep, numNodes - firstSource);
 
-        queue.push(source);
-        distance[source] = 0;
+            for(int i = 0; i < numSources; i++)
+            {
+                const auto source = firstSource + i;
+                const auto bit = SourceMask(1) << i;
 
-        while(!queue.empty())
-        {
-            if(cancelled())
-                return;
+                visited[source] = bit;
+                frontier[source] = bit;
+                frontierNodes.push_back(source);
+            }
 
-            auto nodeId = queue.top();
-            queue.pop();
+            for(int level = 1; !frontierNodes.empty(); level++)
+            {
+                if(cancelled())
+                    return;
 
-            if(visited.get(nodeId))
-                continue;
+                nextNodes.clear();
 
-            visited.set(nodeId, true);
+                for(auto index : frontierNodes)
+                {
+                    const auto sources = frontier[index];
 
-            auto nodeWeight = distance[nodeId];
-            for(EdgeId edgeId : target.edgeIdsForNodeId(nodeId))
-            {
-                NodeId adjacentNodeId = target.edgeById(edgeId).oppositeId(nodeId);
-                const int adjacentNodeWeight = 1;
-                if(!visited.get(adjacentNodeId) && (nodeWeight + adjacentNodeWeight < distance[adjacentNodeId]))
+                    for(auto adjacentIndex : adjacency->neighbours(index))
+                    {
+                        const auto newSources = sources & ~visited[adjacentIndex];
+                        if(newSources == 0)
+                            continue;
+
+                        if(next[adjacentIndex] == 0)
+                            nextNodes.push_back(adjacentIndex);
+
+                        next[adjacentIndex] |= newSources;
+                    }
+                }
+
+                // The sources whose searches reached any node at this level
+                SourceMask reached = 0;
+
+                for(auto index : frontierNodes)
+                    frontier[index] = 0;
+
+                for(auto index : nextNodes)
                 {
-                    distance[adjacentNodeId] = nodeWeight + adjacentNodeWeight;
-                    queue.push(adjacentNodeId);
+                    visited[index] |= next[index];
+                    reached |= next[index];
+
+                    frontier[index] = next[index];
+                    next[index] = 0;
                 }
-            }
-        }
 
-        int maxDistance = 0;
-        for(auto nodeId : target.nodeIds())
-        {
-            if(distance[nodeId] != std::numeric_limits<int>::max())
-                maxDistance = std::max(distance[nodeId], maxDistance);
-        }
+                std::swap(frontierNodes, nextNodes);
 
-        maxDistances[source] = maxDistance;
-        progress++;
-        target.setProgress(progress.load() * 100 / static_cast<int>(target.numNodes()));
-    });
+                // Each search's last level is the distance to the furthest node from its source
+                for(int i = 0; i < numSources && reached != 0; i++, reached >>= 1)
+                {
+                    if((reached & 1) != 0)
+                        eccentricities[static_cast<size_t>(firstSource + i)] = level;
+                }
+            }
+
+            progress++;
+            target.setProgress(progress.load() * 100 / static_cast<int>(sweeps.size()));
+        });
+    }
 
     target.setProgress(-1);
 
     if(cancelled())
         return;
 
+    NodeArray<int> maxDistances(target);
+    for(int index = 0; index < numNodes; index++)
+        maxDistances[adjacency->nodeIdAt(index)] = eccentricities[static_cast<size_t>(index)];
+
     _graphModel->createAttribute(QObject::tr("Node Eccentricity"))
         .setDescription(QObject::tr("A node's eccentricity is the length of the shortest path to the furthest node."))
         .setIntValueFn([maxDistances](NodeId nodeId) { return maxDistances[nodeId]; })
@@ -19,18 +19,245 @@
 #include "louvaintransform.h"
 
 #include "transform/transformedgraph.h"
+#include "graph/adjacencysnapshot.h"
 
 #include "shared/graph/grapharray.h"
-#include "shared/utils/container.h"
+#include "shared/utils/scratcharray.h"
+#include "shared/utils/threadpool.h"
 
 #include "graph/graphmodel.h"
 
-#include <map>
 #include <vector>
 #include <algorithm>
+#include <numeric>
 #include <cmath>
 
-// https://arxiv.org/abs/0803.0476
+// https://arxiv.org/abs/0803.0476 (Louvain)
+// https://arxiv.org/abs/1810.08473 (Leiden)
+// https://arxiv.org/abs/1410.1237 (Parallel local moving by vertex colouring)
+
+namespace
+{
+// One level of the hierarchy, as a weighted compressed sparse row graph
+struct Level
+{
+    // The adjacency of node i is [offsets[i], offsets[i + 1]); loops are not included
+    std::vector<int> offsets;
+    std::vector<int> neighbours;
+    std::vector<double> weights;
+
+    // The sum of the weights of each node's edges, in which loops count twice
+    std::vector<double> degrees;
+
+    int numNodes() const { return static_cast<int>(degrees.size()); }
+};
+
+// Per thread state used when summing the weights from a node to its neighbouring communities
+struct CommunityWeights
+{
+    explicit CommunityWeights(size_t size = 0) : weights(size, 0.0) {}
+
+    ScratchArray<double> weights;
+    std::vector<int> touched;
+
+    void reset()
+    {
+        weights.reset();
+        touched.clear();
+    }
+
+    void add(int community, double weight)
+    {
+        if(!weights.touched(community))
+            touched.push_back(community);
+
+        weights[community] += weight;
+    }
+};
+
+using ThreadCommunityWeights = std::vector<CommunityWeights>;
+
+// Below this many elements, dispatching work to the thread pool costs more than it saves
+constexpr size_t MinimumConcurrentRange = 1024;
+
+template<typename Fn>
+void forEachIndex(const std::vector<int>& indices, Fn&& fn)
+{
+    if(indices.size() < MinimumConcurrentRange)
+    {
+        for(auto index : indices)
+            fn(index, 0);
+
+        return;
+    }
+
+    concurrent_for(indices.begin(), indices.end(),
+        [&fn](const int index, size_t threadIndex) { fn(index, threadIndex); });
+}
+
+std::vector<int> sequence(int size)
+{
+    std::vector<int> indices(static_cast<size_t>(size));
+    std::iota(indices.begin(), indices.end(), 0);
+    return indices;
+}
+
+// Greedily colour the nodes so that no two neighbours share a colour, then
+// bucket them by colour, preserving node order within each bucket; the nodes
+// of a colour class can then be considered for moving concurrently
+std::vector<std::vector<int>> colourClasses(const Level& level)
+{
+    std::vector<int> colours(static_cast<size_t>(level.numNodes()), -1);
+    std::vector<int> usedBy;
+    std::vector<std::vector<int>> classes;
+
+    for(int node = 0; node < level.numNodes(); node++)
+    {
+        for(auto i = level.offsets[node]; i < level.offsets[node + 1]; i++)
+        {
+            auto colour = colours[level.neighbours[i]];
+            if(colour >= 0)
+                usedBy[colour] = node;
+        }
+
+        int colour = 0;
+        while(colour < static_cast<int>(usedBy.size()) && usedBy[colour] == node)
+            colour++;
+
+        if(colour == static_cast<int>(usedBy.size()))
+        {
+            usedBy.push_back(-1);
+            classes.emplace_back();
+        }
+
+        colours[node] = colour;
+        classes[colour].push_back(node);
+    }
+
+    return classes;
+}
+
+// Relabel communities to be contiguous from 0, in order of first appearance,
+// returning the number of communities
+int relabel(std::vector<int>& communities)
+{
+    std::vector<int> idMap(communities.size(), -1);
+    int numCommunities = 0;
+
+    for(auto& community : communities)
+    {
+        if(idMap[community] < 0)
+            idMap[community] = numCommunities++;
+
+        community = idMap[community];
+    }
+
+    return numCommunities;
+}
+
+// The nodes of each community, in node order; the members
+// of community c are [offsets[c], offsets[c + 1]) of nodes
+struct Members
+{
+    std::vector<int> offsets;
+    std::vector<int> nodes;
+};
+
+Members membersOf(const std::vector<int>& communities, int numCommunities)
+{
+    std::vector<int> offsets(static_cast<size_t>(numCommunities) + 1, 0);
+    for(auto community : communities)
+        offsets[community + 1]++;
+
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    std::vector<int> nodes(communities.size());
+    std::vector<int> cursors(offsets.begin(), offsets.end() - 1);
+    for(size_t node = 0; node < communities.size(); node++)
+        nodes[cursors[communities[node]]++] = static_cast<int>(node);
+
+    return {offsets, nodes};
+}
+
+// Collapse each community of level into a single node of a new level;
+// communities must be contiguous from 0
+Level aggregate(const Level& level, const std::vector<int>& communities,
+    int numCommunities, ThreadCommunityWeights& threadCommunityWeights)
+{
+    auto members = membersOf(communities, numCommunities);
+
+    Level coarseLevel;
+    coarseLevel.degrees.resize(static_cast<size_t>(numCommunities), 0.0);
+
+    std::vector<std::vector<std::pair<int, double>>> adjacencies(static_cast<size_t>(numCommunities));
+
+    forEachIndex(sequence(numCommunities), [&](int community, size_t threadIndex)
+    {
+        auto& communityWeights = threadCommunityWeights.at(threadIndex);
+        communityWeights.reset();
+
+        double degree = 0.0;
+
+        for(auto m = members.offsets[community]; m < members.offsets[community + 1]; m++)
+        {
+            auto node = members.nodes[m];
+            degree += level.degrees[node];
+
+            for(auto i = level.offsets[node]; i < level.offsets[node + 1]; i++)
+            {
+                auto neighbourCommunity = communities[level.neighbours[i]];
+
+                // Edges internal to the community become a loop, which is implicit
+                // in the degree of the new node, so it needn't be stored
+                if(neighbourCommunity != community)
+                    communityWeights.add(neighbourCommunity, level.weights[i]);
+            }
+        }
+
+        coarseLevel.degrees[community] = degree;
+
+        auto& adjacency = adjacencies[community];
+        adjacency.reserve(communityWeights.touched.size());
+        for(auto neighbourCommunity : communityWeights.touched)
+            adjacency.emplace_back(neighbourCommunity, communityWeights.weights.get(neighbourCommunity));
+    });
+
+    coarseLevel.offsets.resize(static_cast<size_t>(numCommunities) + 1, 0);
+    for(int community = 0; community < numCommunities; community++)
+    {
+        coarseLevel.offsets[community + 1] = coarseLevel.offsets[community] +
+            static_cast<int>(adjacencies[community].size());
+    }
+
+    coarseLevel.neighbours.reserve(static_cast<size_t>(coarseLevel.offsets.back()));
+    coarseLevel.weights.reserve(static_cast<size_t>(coarseLevel.offsets.back()));
+    for(auto& adjacency : adjacencies)
+    {
+        for(auto [neighbour, weight] : adjacency)
+        {
+            coarseLevel.neighbours.push_back(neighbour);
+            coarseLevel.weights.push_back(weight);
+        }
+
+        adjacency = {};
+    }
+
+    return coarseLevel;
+}
+
+struct Modularity
+{
+    double resolution = 1.0;
+    double totalWeight = 1.0;
+
+    // The change in modularity from adding a node of degree nodeDegree, which has edges
+    // of total weight weight into a community of total degree communityDegree
+    double deltaQ(double weight, double communityDegree, double nodeDegree) const
+    {
+        return (resolution * weight) - ((communityDegree * nodeDegree) / totalWeight);
+    }
+};
+} // namespace
 
 void LouvainTransform::apply(TransformedGraph& target) const
 {
@@ -46,8 +273,6 @@ void LouvainTransform::apply(TransformedGraph& target) const
 
     resolution = std::pow(10.0f, logMin + (resolution * logRange));
 
-    using CommunityId = NodeId; // Slight Hack, be careful with this
-
     const auto& edgeIds = target.edgeIds();
     EdgeArray<double> weights(target, 1.0);
 
@@ -66,281 +291,375 @@ void LouvainTransform::apply(TransformedGraph& target) const
             weights[edgeId] = attribute.numericValueOf(edgeId);
     }
 
-    double totalWeight = std::accumulate(edgeIds.begin(), edgeIds.end(), 0.0,
+    const QString name = _refine ? QStringLiteral("Leiden") : QStringLiteral("Louvain");
+    target.setPhase(QStringLiteral("%1 Initialising").arg(name));
+
+    Modularity modularity;
+    modularity.resolution = resolution;
+    modularity.totalWeight = std::accumulate(edgeIds.begin(), edgeIds.end(), 0.0,
     [&weights](double d, EdgeId edgeId)
     {
         return d + weights[edgeId];
     });
 
-    std::vector<NodeArray<CommunityId>> iterations;
-    size_t progressIteration = 1;
-    target.setPhase(QStringLiteral("Louvain Initialising"));
-
-    NodeArray<CommunityId> communities(target);
-    NodeArray<double> weightedDegrees(target);
-    std::map<CommunityId, int> communityDegrees;
+    // Build the first level from the graph itself; tail nodes are left
+    // isolated, and excluded from the result when naming clusters
+    auto adjacency = target.adjacencySnapshot();
 
-    auto add = [&](CommunityId community, NodeId nodeId)
-    {
-        communities[nodeId] = community;
-        communityDegrees[community] += weightedDegrees[nodeId];
-    };
+    std::vector<bool> tails(static_cast<size_t>(adjacency->numNodes()));
+    for(int node = 0; node < adjacency->numNodes(); node++)
+        tails[node] = target.typeOf(adjacency->nodeIdAt(node)) == MultiElementType::Tail;
 
-    auto remove = [&](CommunityId community, NodeId nodeId)
-    {
-        communities[nodeId].setToNull();
-        communityDegrees[community] -= weightedDegrees[nodeId];
-    };
+    Level currentLevel;
+    currentLevel.offsets.reserve(static_cast<size_t>(adjacency->numNodes()) + 1);
+    currentLevel.offsets.push_back(0);
+    currentLevel.degrees.resize(static_cast<size_t>(adjacency->numNodes()), 0.0);
 
-    auto relabel = [&](MutableGraph& graph)
+    for(int node = 0; node < adjacency->numNodes(); node++)
     {
-        std::map<CommunityId, CommunityId> idMap;
-        CommunityId nextCommunityId = 0;
-
-        for(auto nodeId : graph.nodeIds())
+        if(!tails[node])
         {
-            if(graph.typeOf(nodeId) == MultiElementType::Tail)
-                continue;
+            auto edgeIdIt = adjacency->edgeIds(node).begin();
 
-            auto oldCommunityId = communities[nodeId];
+            for(auto neighbour : adjacency->neighbours(node))
+            {
+                auto weight = weights[*edgeIdIt++];
+                currentLevel.degrees[node] += weight;
 
-            if(!u::contains(idMap, oldCommunityId))
-                communities[nodeId] = idMap[oldCommunityId] = nextCommunityId++;
-            else
-                communities[nodeId] = idMap.at(oldCommunityId);
+                // Skip loop edges
+                if(neighbour != node && !tails[neighbour])
+                {
+                    currentLevel.neighbours.push_back(neighbour);
+                    currentLevel.weights.push_back(weight);
+                }
+            }
         }
+
+        currentLevel.offsets.push_back(static_cast<int>(currentLevel.neighbours.size()));
+    }
+
+    ThreadCommunityWeights threadCommunityWeights(S(ThreadPoolSingleton)->numThreads(),
+        CommunityWeights(static_cast<size_t>(currentLevel.numNodes())));
+
+    auto resizeThreadCommunityWeights = [&](int numNodes)
+    {
+        for(auto& communityWeights : threadCommunityWeights)
+            communityWeights.weights.resize(static_cast<size_t>(numNodes));
     };
 
-    auto coarsen = [&](MutableGraph& graph)
+    // Move nodes to whichever neighbouring community most increases modularity, until
+    // no move does; returns the number of communities, which are relabelled contiguously
+    auto moveNodes = [&](const Level& level, std::vector<int>& communities, size_t iteration)
     {
-        MutableGraph coarseGraph;
-        EdgeArray<double> newWeights(target, 0.0);
+        std::vector<double> communityDegrees(communities.size(), 0.0);
+        for(int node = 0; node < level.numNodes(); node++)
+            communityDegrees[communities[node]] += level.degrees[node];
+
+        auto classes = colourClasses(level);
+
+        // For each node, the community it has chosen, and the weights of its edges
+        // into that community and into its current community
+        std::vector<int> newCommunities(communities.size());
+        std::vector<double> newCommunityWeights(communities.size());
+        std::vector<double> oldCommunityWeights(communities.size());
 
-        coarseGraph.performTransaction([&](IMutableGraph&)
+        size_t subIteration = 1;
+        bool improved = false;
+        do
         {
-            // Create a node for each community
-            for(auto nodeId : graph.nodeIds())
+            improved = false;
+            target.setPhase(QStringLiteral("%1 Iteration %2.%3").arg(name,
+                QString::number(iteration), QString::number(subIteration++)));
+            target.setProgress(0);
+
+            size_t classIndex = 0;
+            for(const auto& nodes : classes)
             {
-                if(graph.typeOf(nodeId) == MultiElementType::Tail)
-                    continue;
+                // No two nodes in a colour class are neighbours, so the weights from each
+                // to the communities around it can't change as the others move; the
+                // decisions are therefore made concurrently, against the same state...
+                forEachIndex(nodes, [&](int node, size_t threadIndex)
+                {
+                    auto& communityWeights = threadCommunityWeights.at(threadIndex);
+                    communityWeights.reset();
 
-                auto newNodeId = communities[nodeId];
+                    auto community = communities[node];
+                    communityWeights.add(community, 0.0);
 
-                if(coarseGraph.containsNodeId(newNodeId))
-                    continue;
+                    for(auto i = level.offsets[node]; i < level.offsets[node + 1]; i++)
+                        communityWeights.add(communities[level.neighbours[i]], level.weights[i]);
 
-                coarseGraph.reserveNodeId(newNodeId);
-                auto assignedNodeId = coarseGraph.addNode(newNodeId);
-                Q_ASSERT(assignedNodeId == newNodeId);
-            }
+                    auto nodeDegree = level.degrees[node];
+                    auto newCommunity = community;
+                    double maxDeltaQ = 0.0;
 
-            uint64_t edgeIndex = 0;
+                    for(auto neighbourCommunity : communityWeights.touched)
+                    {
+                        auto communityDegree = communityDegrees[neighbourCommunity];
+                        if(neighbourCommunity == community)
+                            communityDegree -= nodeDegree;
+
+                        auto deltaQ = modularity.deltaQ(communityWeights.weights.get(neighbourCommunity),
+                            communityDegree, nodeDegree);
+
+                        if(deltaQ > maxDeltaQ || (deltaQ == maxDeltaQ && deltaQ > 0.0 &&
+                            neighbourCommunity < newCommunity))
+                        {
+                            maxDeltaQ = deltaQ;
+                            newCommunity = neighbourCommunity;
+                        }
+                    }
 
-            // Create an edge between community nodes for each
-            // pair of connected communities in the base graph
-            for(auto edgeId : graph.edgeIds())
-            {
-                target.setProgress(static_cast<int>((edgeIndex++ * 100) / graph.numEdges()));
+                    newCommunities[node] = newCommunity;
+                    newCommunityWeights[node] = communityWeights.weights.get(newCommunity);
+                    oldCommunityWeights[node] = communityWeights.weights.get(community);
+                });
 
-                if(cancelled())
-                    break;
+                // ...then applied in node order; community degrees may have changed since
+                // the decision was made, so each move is only applied if it's still an
+                // improvement, which guarantees that modularity increases monotonically
+                for(auto node : nodes)
+                {
+                    auto community = communities[node];
+                    auto newCommunity = newCommunities[node];
 
-                const auto& edge = graph.edgeById(edgeId);
-                auto sourceId = communities.at(edge.sourceId());
-                auto targetId = communities.at(edge.targetId());
-                double newWeight = weights[edgeId];
+                    if(newCommunity == community)
+                        continue;
 
-                auto newEdgeId = coarseGraph.firstEdgeIdBetween(sourceId, targetId);
-                if(newEdgeId.isNull())
-                    newEdgeId = coarseGraph.addEdge(sourceId, targetId);
+                    auto nodeDegree = level.degrees[node];
+                    auto newDeltaQ = modularity.deltaQ(newCommunityWeights[node],
+                        communityDegrees[newCommunity], nodeDegree);
+                    auto oldDeltaQ = modularity.deltaQ(oldCommunityWeights[node],
+                        communityDegrees[community] - nodeDegree, nodeDegree);
 
-                newWeights[newEdgeId] += newWeight;
+                    if(newDeltaQ <= 0.0 || newDeltaQ <= oldDeltaQ)
+                        continue;
+
+                    communityDegrees[community] -= nodeDegree;
+                    communityDegrees[newCommunity] += nodeDegree;
+                    communities[node] = newCommunity;
+                    improved = true;
+                }
+
+                target.setProgress(static_cast<int>((++classIndex * 100) / classes.size()));
+
+                if(cancelled())
+                    break;
             }
-        });
 
-        graph = coarseGraph;
-        weights = newWeights;
+            target.setProgress(-1);
+        }
+        while(improved && !cancelled());
+
+        return relabel(communities);
     };
 
-    auto moveNodes = [&](MutableGraph& graph)
+    // Split each community into subcommunities, by greedily merging its nodes, starting from
+    // singletons; only nodes and subcommunities that are well connected to the rest of the
+    // community are merged, so each resultant subcommunity is itself well connected
+    auto refine = [&](const Level& level, const std::vector<int>& communities, int numCommunities)
     {
-        if(cancelled())
-            return false;
+        auto members = membersOf(communities, numCommunities);
 
-        CommunityId nextCommunityId = 0;
-        for(auto nodeId : graph.nodeIds())
-        {
-            if(graph.typeOf(nodeId) == MultiElementType::Tail)
-                continue;
+        std::vector<double> communityDegrees(static_cast<size_t>(numCommunities), 0.0);
+        for(int node = 0; node < level.numNodes(); node++)
+            communityDegrees[communities[node]] += level.degrees[node];
 
-            for(auto edgeId : graph.nodeById(nodeId).edgeIds())
-                weightedDegrees[nodeId] += weights[edgeId];
+        // Subcommunities are identified by the node they started as
+        std::vector<int> subcommunities = sequence(level.numNodes());
+        std::vector<int> subcommunitySizes(communities.size(), 1);
+        std::vector<double> subcommunityDegrees(level.degrees);
 
-            add(nextCommunityId++, nodeId);
+        // The weight of the edges from each subcommunity to the rest of its community
+        std::vector<double> externalWeights(communities.size(), 0.0);
+        for(int node = 0; node < level.numNodes(); node++)
+        {
+            for(auto i = level.offsets[node]; i < level.offsets[node + 1]; i++)
+            {
+                if(communities[level.neighbours[i]] == communities[node])
+                    externalWeights[node] += level.weights[i];
+            }
         }
 
-        size_t subProgressIteration = 1;
-        bool modified = false;
-        bool improved = false;
-        do
+        auto wellConnected = [&](double weight, double degree, double communityDegree)
         {
-            improved = false;
-            target.setProgress(0);
-            uint64_t nodeIndex = 0;
+            return modularity.deltaQ(weight, communityDegree - degree, degree) >= 0.0;
+        };
 
-            target.setPhase(QStringLiteral("Louvain Iteration %1.%2")
-                .arg(QString::number(progressIteration), QString::number(subProgressIteration++)));
+        // Communities are refined independently of each other
+        forEachIndex(sequence(numCommunities), [&](int community, size_t threadIndex)
+        {
+            auto& communityWeights = threadCommunityWeights.at(threadIndex);
+            auto communityDegree = communityDegrees[community];
 
-            for(auto nodeId : graph.nodeIds())
+            for(auto m = members.offsets[community]; m < members.offsets[community + 1]; m++)
             {
-                target.setProgress(static_cast<int>((nodeIndex++ * 100) / graph.numNodes()));
+                auto node = members.nodes[m];
+                auto nodeDegree = level.degrees[node];
 
-                if(graph.typeOf(nodeId) == MultiElementType::Tail)
+                // Only consider nodes that haven't yet been merged with anything
+                if(subcommunitySizes[subcommunities[node]] > 1)
                     continue;
 
-                std::map<CommunityId, double> neighbourCommunityWeights;
-                for(auto edgeId : graph.nodeById(nodeId).edgeIds())
-                {
-                    auto neighbourNodeId = graph.edgeById(edgeId).oppositeId(nodeId);
-
-                    // Skip loop edges
-                    if(neighbourNodeId == nodeId)
-                        continue;
-
-                    if(graph.typeOf(neighbourNodeId) == MultiElementType::Tail)
-                        continue;
-
-                    auto neighbourCommunityId = communities.at(neighbourNodeId);
+                auto nodeExternalWeight = externalWeights[node];
+                if(!wellConnected(nodeExternalWeight, nodeDegree, communityDegree))
+                    continue;
 
-                    neighbourCommunityWeights[neighbourCommunityId] += weights[edgeId];
+                communityWeights.reset();
+                for(auto i = level.offsets[node]; i < level.offsets[node + 1]; i++)
+                {
+                    auto neighbour = level.neighbours[i];
+                    if(communities[neighbour] == community)
+                        communityWeights.add(subcommunities[neighbour], level.weights[i]);
                 }
 
-                auto communityId = communities[nodeId];
-                remove(communityId, nodeId);
-
+                auto subcommunity = subcommunities[node];
+                auto newSubcommunity = subcommunity;
                 double maxDeltaQ = 0.0;
-                auto newCommunityId = communityId;
 
-                for(auto [neighbourCommunityId, weight] : neighbourCommunityWeights)
+                for(auto neighbourSubcommunity : communityWeights.touched)
                 {
-                    auto communityWeight = communityDegrees.at(neighbourCommunityId);
-                    auto nodeWeight = weightedDegrees[nodeId];
+                    if(neighbourSubcommunity == subcommunity)
+                        continue;
+
+                    if(!wellConnected(externalWeights[neighbourSubcommunity],
+                        subcommunityDegrees[neighbourSubcommunity], communityDegree))
+                    {
+                        continue;
+                    }
 
-                    auto deltaQ = (resolution * weight) -
-                        ((communityWeight * nodeWeight) / totalWeight);
+                    auto deltaQ = modularity.deltaQ(communityWeights.weights.get(neighbourSubcommunity),
+                        subcommunityDegrees[neighbourSubcommunity], nodeDegree);
 
-                    if(deltaQ > maxDeltaQ)
+                    if(deltaQ > maxDeltaQ || (deltaQ == maxDeltaQ && deltaQ > 0.0 &&
+                        neighbourSubcommunity < newSubcommunity))
                     {
                         maxDeltaQ = deltaQ;
-                        newCommunityId = neighbourCommunityId;
+                        newSubcommunity = neighbourSubcommunity;
                     }
                 }
 
-                add(newCommunityId, nodeId);
-
-                if(newCommunityId != communityId)
-                    improved = modified = true;
+                if(newSubcommunity == subcommunity)
+                    continue;
 
-                if(cancelled())
-                    break;
+                auto weight = communityWeights.weights.get(newSubcommunity);
+                externalWeights[newSubcommunity] += nodeExternalWeight - (2.0 * weight);
+                subcommunityDegrees[newSubcommunity] += nodeDegree;
+                subcommunitySizes[newSubcommunity]++;
+                subcommunitySizes[subcommunity]--;
+                subcommunities[node] = newSubcommunity;
             }
+        });
 
-            target.setProgress(-1);
-        }
-        while(improved && !cancelled());
-
-        return modified;
+        return subcommunities;
     };
 
-    MutableGraph graph(target.mutableGraph());
+    // For each currentLevel, the node of the next currentLevel that each of its nodes was aggregated into
+    std::vector<std::vector<int>> iterations;
+    std::vector<int> communities = sequence(currentLevel.numNodes());
+    size_t iteration = 1;
 
-    bool finished = false;
-    do
+    while(!cancelled())
     {
-        target.setProgress(-1);
+        auto numCommunities = moveNodes(currentLevel, communities, iteration);
 
-        communities.resetElements();
-        weightedDegrees.resetElements();
-        communityDegrees.clear();
+        // Every node is in a community of its own, so aggregating would change nothing
+        if(numCommunities == currentLevel.numNodes() || cancelled())
+            break;
 
-        finished = !moveNodes(graph);
+        target.setPhase(QStringLiteral("%1 Iteration %2 Coarsening")
+            .arg(name, QString::number(iteration)));
+        target.setProgress(-1);
 
-        if(!finished && !cancelled())
+        if(_refine)
         {
-            relabel(graph);
-            iterations.emplace_back(communities);
+            // Aggregate the refined partition, but carry the unrefined
+            // partition forward as the starting point of the next currentLevel
+            auto subcommunities = refine(currentLevel, communities, numCommunities);
+            auto numSubcommunities = relabel(subcommunities);
 
-            target.setPhase(QStringLiteral("Louvain Iteration %1 Coarsening")
-                .arg(QString::number(progressIteration)));
-            coarsen(graph);
+            // Nothing could be merged, so fall back to aggregating the unrefined partition
+            if(numSubcommunities == currentLevel.numNodes())
+            {
+                subcommunities = communities;
+                numSubcommunities = numCommunities;
+            }
+
+            std::vector<int> nextCommunities(static_cast<size_t>(numSubcommunities));
+            for(int node = 0; node < currentLevel.numNodes(); node++)
+                nextCommunities[subcommunities[node]] = communities[node];
+
+            currentLevel = aggregate(currentLevel, subcommunities, numSubcommunities, threadCommunityWeights);
+            iterations.emplace_back(std::move(subcommunities));
+            communities = std::move(nextCommunities);
+        }
+        else
+        {
+            currentLevel = aggregate(currentLevel, communities, numCommunities, threadCommunityWeights);
+            iterations.emplace_back(std::move(communities));
+            communities = sequence(numCommunities);
         }
 
-        progressIteration++;
+        resizeThreadCommunityWeights(currentLevel.numNodes());
+        iteration++;
     }
-    while(!finished && !cancelled());
 
     if(cancelled())
         return;
 
-    target.setPhase(QStringLiteral("Louvain Finalising"));
+    target.setPhase(QStringLiteral("%1 Finalising").arg(name));
 
-    // Set each CommunityId to be the same as the NodeId, initially
-    for(auto nodeId : target.nodeIds())
+    // Walk over the iterations to find the final community of each node
+    std::vector<int> nodeCommunities(static_cast<size_t>(adjacency->numNodes()));
+    for(int node = 0; node < adjacency->numNodes(); node++)
     {
-        if(graph.typeOf(nodeId) == MultiElementType::Tail)
-            continue;
+        auto index = node;
+        for(const auto& iterationCommunities : iterations)
+            index = iterationCommunities[index];
 
-        communities[nodeId] = nodeId;
+        nodeCommunities[node] = communities[index];
     }
 
-    // Walk back over our iterations to build the final communities
-    for(auto nodeId : target.nodeIds())
+    // Sort communities by size, excluding tail nodes
+    std::vector<size_t> communitySizes(communities.size(), 0);
+    for(int node = 0; node < adjacency->numNodes(); node++)
     {
-        for(const auto& iteration : iterations)
-        {
-            auto communityId = communities[nodeId];
-
-            if(!communityId.isNull())
-                communities[nodeId] = iteration.at(communities[nodeId]);
-
-            if(cancelled())
-                return;
-        }
+        if(!tails[node])
+            communitySizes[nodeCommunities[node]]++;
     }
 
-    // Sort communities by size
-    std::map<CommunityId, size_t> communityHistogram;
-    for(auto nodeId : target.nodeIds())
-        communityHistogram[communities[nodeId]]++;
-    std::vector<std::pair<CommunityId, size_t>> sortedCommunityHistogram;
-    std::copy(communityHistogram.begin(), communityHistogram.end(),
-        std::back_inserter(sortedCommunityHistogram));
-    std::sort(sortedCommunityHistogram.begin(), sortedCommunityHistogram.end(),
-        [](const auto& a, const auto& b) { return a.second > b.second; });
+    std::vector<int> sortedCommunities = sequence(static_cast<int>(communitySizes.size()));
+    std::stable_sort(sortedCommunities.begin(), sortedCommunities.end(),
+        [&communitySizes](auto a, auto b) { return communitySizes[a] > communitySizes[b]; });
 
     // Assign cluster numbers to each community
-    std::map<CommunityId, size_t> clusterNumbers;
+    std::vector<size_t> clusterNumbers(communitySizes.size(), 0);
     size_t clusterNumber = 1;
-    for(auto [communityId, size] : sortedCommunityHistogram)
+    for(auto community : sortedCommunities)
     {
-        if(!communityId.isNull())
-            clusterNumbers[communityId] = clusterNumber++;
+        if(communitySizes[community] > 0)
+            clusterNumbers[community] = clusterNumber++;
     }
 
     NodeArray<QString> clusterNames(target);
 
-    for(auto nodeId : target.nodeIds())
+    for(int node = 0; node < adjacency->numNodes(); node++)
     {
-        auto communityId = communities[nodeId];
-        if(communityId.isNull())
+        if(tails[node])
             continue;
 
-        clusterNumber = clusterNumbers[communityId];
-        clusterNames[nodeId] = QObject::tr("Cluster %1").arg(clusterNumber);
+        clusterNumber = clusterNumbers[nodeCommunities[node]];
+        clusterNames[adjacency->nodeIdAt(node)] = QObject::tr("Cluster %1").arg(clusterNumber);
     }
 
-    _graphModel->createAttribute(QObject::tr(_weighted ? "Weighted Louvain Cluster" : "Louvain Cluster"))
-        .setDescription(QObject::tr("The Louvain-calculated cluster in which the node resides."))
+    QString attributeName;
+    if(_refine)
+        attributeName = _weighted ? QObject::tr("Weighted Leiden Cluster") : QObject::tr("Leiden Cluster");
+    else
+        attributeName = _weighted ? QObject::tr("Weighted Louvain Cluster") : QObject::tr("Louvain Cluster");
+
+    _graphModel->createAttribute(attributeName)
+        .setDescription(QObject::tr("The %1-calculated cluster in which the node resides.").arg(name))
         .setStringValueFn([clusterNames](NodeId nodeId) { return clusterNames[nodeId]; })
         .setValueMissingFn([clusterNames](NodeId nodeId) { return clusterNames[nodeId].isEmpty(); })
         .setFlag(AttributeFlag::FindShared)
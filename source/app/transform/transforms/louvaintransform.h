@@ -27,13 +27,16 @@
 class LouvainTransform : public GraphTransform
 {
 public:
-    explicit LouvainTransform(GraphModel* graphModel, bool weighted) :
-        _graphModel(graphModel), _weighted(weighted) {}
+    explicit LouvainTransform(GraphModel* graphModel, bool weighted, bool refine = false) :
+        _graphModel(graphModel), _weighted(weighted), _refine(refine) {}
     void apply(TransformedGraph& target) const override;
 
 private:
     GraphModel* _graphModel = nullptr;
     bool _weighted = false;
+
+    // Apply the Leiden refinement phase before each aggregation
+    bool _refine = false;
 };
 
 class LouvainTransformFactory : public GraphTransformFactory
@@ -104,4 +107,55 @@ public:
     }
 };
 
+class LeidenTransformFactory : public LouvainTransformFactory
+{
+public:
+    using LouvainTransformFactory::LouvainTransformFactory;
+
+    QString description() const override
+    {
+        return QObject::tr("%1 is a refinement of Louvain Modularity which "
+            "guarantees that the clusters it finds are well connected.")
+            .arg(u::redirectLink("leiden", QObject::tr("Leiden")));
+    }
+
+    DefaultVisualisations defaultVisualisations() const override
+    {
+        return {{"Leiden Cluster", ValueType::String, {}, QObject::tr("Colour")}};
+    }
+
+    std::unique_ptr<GraphTransform> create(const GraphTransformConfig&) const override
+    {
+        return std::make_unique<LouvainTransform>(graphModel(), false, true);
+    }
+};
+
+class WeightedLeidenTransformFactory : public LeidenTransformFactory
+{
+public:
+    using LeidenTransformFactory::LeidenTransformFactory;
+
+    GraphTransformAttributeParameters attributeParameters() const override
+    {
+        return
+        {
+            {
+                "Weighting Attribute",
+                ElementType::Edge, ValueType::Numerical,
+                QObject::tr("The attribute whose value is used to weight edges.")
+            }
+        };
+    }
+
+    DefaultVisualisations defaultVisualisations() const override
+    {
+        return {{"Weighted Leiden Cluster", ValueType::String, {}, QObject::tr("Colour")}};
+    }
+
+    std::unique_ptr<GraphTransform> create(const GraphTransformConfig&) const override
+    {
+        return std::make_unique<LouvainTransform>(graphModel(), true, true);
+    }
+};
+
 #endif // LOUVAINTRANSFORM_H
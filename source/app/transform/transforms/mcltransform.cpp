@@ -18,268 +18,235 @@
 
 #include "mcltransform.h"
 #include "transform/transformedgraph.h"
+#include "graph/adjacencysnapshot.h"
 #include "graph/graphmodel.h"
-#include "shared/utils/threadpool.h"
 
-#include <blaze/Blaze.h>
+#include "shared/utils/scratcharray.h"
+#include "shared/utils/threadpool.h"
 
 #include <QElapsedTimer>
 #include <QDebug>
 
-#include <map>
 #include <set>
-#include <thread>
 #include <algorithm>
+#include <numeric>
+#include <atomic>
+#include <cmath>
 
-using MatrixType = blaze::CompressedMatrix<float,blaze::columnMajor>;
-using VectorType = blaze::DynamicVector<float,blaze::columnVector>;
-
-static void normaliseColumnsColumnMajor(MatrixType &mclMatrix)
+namespace
 {
-    for(size_t column = 0; column<mclMatrix.columns(); column++)
-    {
-        MatrixType::Iterator lelem=mclMatrix.begin(column);
-        MatrixType::Iterator lend=mclMatrix.end(column);
+// A square sparse matrix in compressed sparse column form; the entries of
+// column j are [offsets[j], offsets[j + 1]) in rows and values, in ascending
+// row order. Each column sums to 1, or is empty.
+struct SparseMatrix
+{
+    std::vector<size_t> offsets;
+    std::vector<uint32_t> rows;
+    std::vector<float> values;
 
-        if(lelem == lend)
-            continue;
+    size_t columns() const { return offsets.size() - 1; }
+    size_t nonZeros() const { return values.size(); }
+    size_t nonZeros(size_t column) const { return offsets[column + 1] - offsets[column]; }
+};
 
-        float value = 0.0f;
-        for(lelem=mclMatrix.begin(column); lelem!=lend; ++lelem)
-            value += lelem->value();
+// Per thread state for expanding columns, kept for the duration of the transform
+// so that its storage is reused from one iteration to the next
+struct ColumnWorkspace
+{
+    explicit ColumnWorkspace(size_t size = 0) : accumulator(size, 0.0f) {}
 
-        Q_ASSERT(value > 0.0f);
-        value = 1.0f / value;
+    // Sparse accumulator for the column currently being expanded
+    ScratchArray<float> accumulator;
+    std::vector<uint32_t> touched;
 
-        for(lelem=mclMatrix.begin(column); lelem!=lend; ++lelem)
-            lelem->value() = lelem->value() * value;
-    }
-}
+    // The columns this thread has produced in the current iteration, back to back
+    std::vector<uint32_t> rows;
+    std::vector<float> values;
 
-static void sumColumns(MatrixType &mclMatrix, VectorType &output)
-{
-    for(size_t column = 0; column<mclMatrix.columns(); column++)
+    void clear()
     {
-        MatrixType::ConstIterator lend=mclMatrix.cend(column);
-        for(MatrixType::ConstIterator lelem=mclMatrix.cbegin(column); lelem!=lend; ++lelem)
-        {
-            output[column] = output[column] + lelem->value();
-        }
+        rows.clear();
+        values.clear();
     }
-}
-
-struct SparseMatrixEntry
-{
-    size_t _row; size_t _column; float _value;
-    SparseMatrixEntry(size_t row, size_t column, float value)
-        : _row(row), _column(column), _value(value){}
 };
 
-struct MCLRowData
+// Where an expanded column was left, prior to being gathered into the next matrix
+struct ColumnExtent
 {
-    std::vector<float> values;
-    std::vector<bool> valid;
-    std::vector<size_t> indices;
-    explicit MCLRowData(size_t columnCount) : values(columnCount, 0.0f),
-        valid(columnCount, false), indices(columnCount, 0UL) {}
+    size_t _thread = 0;
+    size_t _start = 0;
+    size_t _size = 0;
 };
 
-template<typename CancelledFn>
-static void expandAndPruneRow(MatrixType& mclMatrix, size_t columnId,
-    std::vector<SparseMatrixEntry>* matrixStorage, MCLRowData& rowData,
-    float minValueCutoff, const CancelledFn& cancelledFn)
-{
-    const bool DEBUG = false;
+// Perhaps make these changable parameters later
+constexpr size_t RecoveryCount = 1400;
+constexpr size_t SelectionCount = 1100;
 
-    // Perhaps make these changable parameters later
-    const int RECOVERY_COUNT = 1400;
-    const int SELECTION_COUNT = 1100;
+// Mass is always normalised!
+constexpr float TargetMass = 0.9f;
 
-    size_t nonzeros = 0;
+constexpr float Epsilon = 1e-8f;
 
-    size_t minIndex = std::numeric_limits<size_t>::infinity();
-    size_t maxIndex = 0UL;
-    const auto* const lend = mclMatrix.cend(columnId);
+// Computes one column of the square of the matrix, prunes it, then inflates and
+// normalises it, leaving the result at the end of the workspace's rows and values.
+// Returns false if the resultant column is not yet equidistributed.
+bool expandPruneAndInflate(const SparseMatrix& matrix, size_t column,
+    ColumnWorkspace& workspace, ColumnExtent& extent,
+    float inflation, float pruneLimit, float convergenceLimit)
+{
+    auto& accumulator = workspace.accumulator;
+    auto& touched = workspace.touched;
+
+    accumulator.reset();
+    touched.clear();
 
-    // Perform multiply and populate prune dependant data structures
-    for(const auto* lelem = mclMatrix.cbegin(columnId); lelem != lend; ++lelem)
+    // Multiply
+    for(auto i = matrix.offsets[column]; i < matrix.offsets[column + 1]; i++)
     {
-        if(cancelledFn())
-            break;
+        const auto k = matrix.rows[i];
+        const auto weight = matrix.values[i];
 
-        // For each column (left)
-        const auto* const rend = mclMatrix.cend(lelem->index());
-        for(const auto* relem = mclMatrix.cbegin(lelem->index()); relem != rend; ++relem)
+        for(auto j = matrix.offsets[k]; j < matrix.offsets[k + 1]; j++)
         {
-            // For each column starting at left column index (right)
-            float mult = lelem->value() * relem->value();
+            const auto row = matrix.rows[j];
 
-            if(!rowData.valid[relem->index()])
-            {
-                rowData.values[relem->index()] = mult;
-                rowData.valid[relem->index()] = true;
-                // Position in the rowData.values vector
-                rowData.indices[nonzeros] = relem->index();
-                ++nonzeros;
-
-                if(relem->index() < minIndex) minIndex = relem->index();
-                if(relem->index() > maxIndex) maxIndex = relem->index();
-            }
-            else
-                rowData.values[relem->index()] += mult;
+            if(!accumulator.touched(row))
+                touched.push_back(row);
+
+            accumulator[row] += weight * matrix.values[j];
         }
     }
 
-    if(cancelledFn())
-        return;
+    const auto nonZeros = touched.size();
 
-    if(nonzeros > 0UL)
+    extent._start = workspace.rows.size();
+    extent._size = 0;
+
+    if(nonZeros == 0)
+        return true;
+
+    // Prune
+    auto byValueDescending = [&accumulator](uint32_t a, uint32_t b)
     {
-        Q_ASSERT(minIndex <= maxIndex);
+        return accumulator.get(a) > accumulator.get(b);
+    };
 
-        size_t remainCount = nonzeros;
-        float rowPruneSum = 0.0f;
-        // Mass is always normalised!
-        float targetMass = 0.9f;
+    auto keepLargest = [&](size_t count)
+    {
+        count = std::min(count, touched.size());
 
-        for(size_t i = 0UL; i < nonzeros; ++i)
-        {
-            size_t index = rowData.indices[i];
-            if(std::abs(rowData.values[index]) <= minValueCutoff)
-            {
-                // Remove from the remainCount;
-                remainCount--;
-            }
-            else
-            {
-                // Calculate pruned sum
-                rowPruneSum += rowData.values[index];
-            }
-        }
+        std::nth_element(touched.begin(), touched.begin() + static_cast<std::ptrdiff_t>(count),
+            touched.end(), byValueDescending);
+        touched.resize(count);
+    };
+
+    auto massOf = [&]
+    {
+        float mass = 0.0f;
+        for(auto row : touched)
+            mass += accumulator.get(row);
 
-        if(DEBUG)
-            qDebug() << "RowPruneSum (mass?)" << rowPruneSum << "targetmass" << targetMass;
+        return mass;
+    };
 
-        if(remainCount != nonzeros && rowPruneSum < targetMass && remainCount < RECOVERY_COUNT)
+    size_t remainCount = 0;
+    float prunedMass = 0.0f;
+
+    for(auto row : touched)
+    {
+        if(accumulator.get(row) > pruneLimit)
         {
-            // Recover
-            if(DEBUG)
-                qDebug() << "RECOVERY" << "MASS:" << rowPruneSum;
-            std::nth_element(rowData.indices.begin(), rowData.indices.begin() + RECOVERY_COUNT, rowData.indices.begin() + nonzeros,
-                             [&rowData](size_t i1, size_t i2) {return rowData.values[i1] > rowData.values[i2];});
-            minValueCutoff = rowData.values[rowData.indices[RECOVERY_COUNT]];
-            remainCount = RECOVERY_COUNT;
-            rowPruneSum = 0;
-            for(size_t i = 0UL; i < RECOVERY_COUNT; ++i)
-                rowPruneSum += rowData.values[rowData.indices[i]];
+            remainCount++;
+            prunedMass += accumulator.get(row);
         }
-        else if(remainCount > SELECTION_COUNT)
-        {
-            // Selection prune
-            // Refine the cutoff so MAXIMUM SELECTION_COUNT elements remain
-            // Should speedtest this vs copy+std::greater<float>
-            std::nth_element(rowData.indices.begin(), rowData.indices.begin() + SELECTION_COUNT, rowData.indices.begin() + nonzeros,
-                             [&rowData](size_t i1, size_t i2) {return rowData.values[i1] > rowData.values[i2];});
+    }
 
-            minValueCutoff = rowData.values[rowData.indices[SELECTION_COUNT]];
+    if(remainCount != nonZeros && prunedMass < TargetMass && remainCount < RecoveryCount)
+    {
+        // Recover
+        keepLargest(RecoveryCount);
+    }
+    else if(remainCount > SelectionCount)
+    {
+        // Selection prune, so that at most SelectionCount elements remain
+        keepLargest(SelectionCount);
 
-            if(DEBUG)
-            {
-                qDebug() << "Selection Cutoff" << minValueCutoff;
-                qDebug() << "Pre selection Remain" << remainCount << "mass" << rowPruneSum;
-            }
+        // Do another recovery if needed
+        if(massOf() < TargetMass)
+            keepLargest(RecoveryCount);
+    }
+    else if(remainCount < nonZeros)
+    {
+        touched.erase(std::remove_if(touched.begin(), touched.end(),
+            [&](uint32_t row) { return accumulator.get(row) <= pruneLimit; }), touched.end());
+    }
 
-            // Recalculate new mass
-            remainCount = SELECTION_COUNT;
-            rowPruneSum = 0;
-            for(size_t i = 0UL; i < SELECTION_COUNT; ++i)
-                rowPruneSum += rowData.values[rowData.indices[i]];
+    // Entries that are negligible relative to the retained mass are dropped
+    const auto cutoff = Epsilon * massOf();
+    touched.erase(std::remove_if(touched.begin(), touched.end(),
+        [&](uint32_t row) { return accumulator.get(row) <= cutoff; }), touched.end());
 
-            if(DEBUG)
-                qDebug() << "Post selection Remain" << remainCount << "mass" << rowPruneSum;
+    std::sort(touched.begin(), touched.end());
 
-            Q_ASSERT(remainCount < RECOVERY_COUNT);
+    // Inflate, then normalise; any rescaling of the pruned column would
+    // cancel out here, so there is no need to do it separately
+    auto& rows = workspace.rows;
+    auto& values = workspace.values;
 
-            // Do Another recovery if needed
-            if(remainCount != nonzeros && rowPruneSum < targetMass)
-            {
-                if(DEBUG)
-                    qDebug() << "RECOVERY 2" << "MASS:" << rowPruneSum;
-
-                std::nth_element(rowData.indices.begin(), rowData.indices.begin() + RECOVERY_COUNT, rowData.indices.begin() + nonzeros,
-                                 [&rowData](size_t i1, size_t i2) {return rowData.values[i1] > rowData.values[i2];});
-                minValueCutoff = rowData.values[rowData.indices[RECOVERY_COUNT]];
-                remainCount = RECOVERY_COUNT;
-                rowPruneSum = 0;
-                for(size_t i = 0UL; i < RECOVERY_COUNT; ++i)
-                    rowPruneSum += rowData.values[rowData.indices[i]];
-            }
-        }
+    rows.insert(rows.end(), touched.begin(), touched.end());
+    values.resize(rows.size());
 
-        // Finally, remove unneeded rowData.indices
-        if(remainCount < nonzeros)
-        {
-            if(DEBUG)
-            {
-                qDebug() << "Prune:" << nonzeros - remainCount;
-                qDebug() << "Raw count" << nonzeros;
-                qDebug() << "Remain Count" << remainCount;
-            }
-            for(size_t i = 0UL; i < nonzeros; ++i)
-            {
-                if(std::abs(rowData.values[rowData.indices[i]]) <= minValueCutoff)
-                {
-                    rowData.values[rowData.indices[i]] = 0.0f;
-                    rowData.valid[rowData.indices[i]] = false;
-                }
-                else
-                {
-                    // Rescale
-                    rowData.values[rowData.indices[i]] /= rowPruneSum;
-                }
-            }
-        }
+    auto* first = values.data() + extent._start;
+    auto* last = values.data() + values.size();
 
-        if(DEBUG)
-        {
-            qDebug() << columnId << "pruned" << nonzeros - remainCount;
-            qDebug() << rowData.values;
-        }
+    float sum = 0.0f;
+    for(size_t i = 0; i < touched.size(); i++)
+    {
+        first[i] = std::pow(accumulator.get(touched[i]), inflation);
+        sum += first[i];
+    }
 
-        // Populate new matrix
-        // If sorting is too big just brute force the whole range
-        // If the range is small just do it contiguously
-        const float EPSILON = 1e-8f;
-        if((nonzeros + nonzeros) < (maxIndex - minIndex))
-        {
-            std::sort(rowData.indices.begin(), rowData.indices.begin() + nonzeros);
+    Q_ASSERT(sum > 0.0f);
+    const float scale = 1.0f / sum;
 
-            for(size_t j = 0UL; j<nonzeros; ++j)
-            {
-                const size_t index = rowData.indices[j];
-                if(rowData.values[index] > EPSILON)
-                {
-                    matrixStorage->emplace_back(index, columnId, rowData.values[index]);
-                    rowData.values[index] = 0.0f;
-                }
-                rowData.valid[index] = false;
-            }
-        }
-        else
-        {
-            for(size_t j = minIndex; j <= maxIndex; ++j)
-            {
-                if(rowData.values[j] > EPSILON)
-                {
-                    matrixStorage->emplace_back(j, columnId, rowData.values[j]);
-                    rowData.values[j] = 0.0f;
-                }
-                rowData.valid[j] = false;
-            }
-        }
+    float max = 0.0f;
+    float sumOfSquares = 0.0f;
+    for(auto* value = first; value != last; ++value)
+    {
+        *value *= scale;
+        max = std::max(max, *value);
+        sumOfSquares += *value * *value;
     }
+
+    extent._size = touched.size();
+
+    // The column is equidistributed (idempotent under expansion and
+    // inflation) when all its non-zero values are equal
+    return (max - sumOfSquares) * static_cast<float>(extent._size) <= convergenceLimit;
+}
+
+template<typename Fn>
+void forEachColumn(const std::vector<size_t>& columns, Fn&& fn)
+{
+    concurrent_for(columns.begin(), columns.end(),
+        [&fn](const size_t column, size_t threadIndex) { fn(column, threadIndex); });
 }
 
+void debugMatrix(const QString& title, const SparseMatrix& matrix)
+{
+    qDebug().noquote() << title;
+
+    for(size_t column = 0; column < matrix.columns(); column++)
+    {
+        QDebug debug = qDebug().nospace();
+        debug << column << ":";
+
+        for(auto i = matrix.offsets[column]; i < matrix.offsets[column + 1]; i++)
+            debug << " (" << matrix.rows[i] << ", " << matrix.values[i] << ")";
+    }
+}
+} // namespace
+
 void MCLTransform::apply(TransformedGraph& target) const
 {
     auto granularity = std::get<double>(
@@ -296,161 +263,103 @@ void MCLTransform::apply(TransformedGraph& target) const
         calculateMCL(granularity, target);
 }
 
-template<class MatrixType>
-class ColumnsIterator
-{
-public:
-    class iterator
-    {
-    public:
-        using value_type = size_t;
-        using reference = value_type&;
-        using pointer = value_type*;
-        using iterator_category = std::input_iterator_tag;
-        using difference_type = size_t;
-
-    private:
-        size_t _num = 0;
-
-    public:
-        explicit iterator(size_t num = 0) : _num(num) {}
-        iterator& operator++() { _num = _num + 1; return *this; }
-        iterator operator++(int) { iterator retval = *this; ++(*this); return retval; }
-        bool operator==(iterator other) const { return _num == other._num; }
-        bool operator!=(iterator other) const { return !(*this == other); }
-        value_type operator*() const { return _num; }
-    };
-    MatrixType& matrix;
-    explicit ColumnsIterator(MatrixType& _matrix) : matrix(_matrix) {}
-    iterator begin() { return iterator(0); }
-    iterator end() { return iterator(matrix.columns()); }
-};
-
 void MCLTransform::calculateMCL(float inflation, TransformedGraph& target) const
 {
     target.setPhase(QStringLiteral("MCL Initialising"));
 
-    int nodeCount = target.numNodes();
+    const AdjacencySnapshot adjacency(target);
+    const auto nodeCount = static_cast<size_t>(adjacency.numNodes());
 
-    // Map NodeIds to Matrix index
-    std::map<NodeId, size_t> nodeToIndexMap;
-    std::map<size_t, NodeId> indexToNodeMap;
-    for(NodeId nodeId : target.nodeIds())
-    {
-        auto index = nodeToIndexMap.size();
-        nodeToIndexMap[nodeId] = index;
-        indexToNodeMap[index] = nodeId;
-    }
+    // Each column starts as the node's neighbours and itself, uniformly weighted; this
+    // is what normalising, pre-inflating and normalising again amounts to. A column
+    // whose uniform value falls below the prune limit is emptied.
+    SparseMatrix clusterMatrix;
+    clusterMatrix.offsets.reserve(nodeCount + 1);
+    clusterMatrix.offsets.push_back(0);
+    clusterMatrix.rows.reserve(static_cast<size_t>(adjacency.numEntries()) + nodeCount);
+    clusterMatrix.values.reserve(clusterMatrix.rows.capacity());
 
-    MatrixType clusterMatrix(nodeCount, nodeCount);
-    blaze::setNumThreads(std::thread::hardware_concurrency());
+    std::vector<uint32_t> columnRows;
+    for(size_t column = 0; column < nodeCount; column++)
+    {
+        const auto neighbours = adjacency.neighbours(static_cast<int>(column));
 
-    clusterMatrix.reserve((target.numEdges() * 2) + nodeCount);
+        columnRows.assign(neighbours.begin(), neighbours.end());
+        columnRows.push_back(static_cast<uint32_t>(column));
+        std::sort(columnRows.begin(), columnRows.end());
+        columnRows.erase(std::unique(columnRows.begin(), columnRows.end()), columnRows.end());
 
-    // Populate the Matrix
-    for(NodeId nodeId : target.nodeIds())
-    {
-        auto nodeIndex = nodeToIndexMap[nodeId];
-        auto connectedEdgeIds = target.edgeIdsForNodeId(nodeId);
+        const auto value = 1.0f / static_cast<float>(columnRows.size());
 
-        // Add all connected node indexes to sorted set
-        std::set<size_t> sortNodeIndexes;
-        for(auto connectEdgeId : connectedEdgeIds)
+        if(value >= MCL_PRUNE_LIMIT)
         {
-            auto connectedNodeId = target.edgeById(connectEdgeId).oppositeId(nodeId);
-            sortNodeIndexes.insert(nodeToIndexMap[connectedNodeId]);
+            clusterMatrix.rows.insert(clusterMatrix.rows.end(), columnRows.begin(), columnRows.end());
+            clusterMatrix.values.resize(clusterMatrix.rows.size(), value);
         }
-        // Add self loop
-        sortNodeIndexes.insert(nodeIndex);
-
-        // Append to Compressed Matrix
-        for(auto sortedConnectIndex : sortNodeIndexes)
-            clusterMatrix.append(sortedConnectIndex, nodeIndex, 1.0f);
 
-        // Finalise the row
-        clusterMatrix.finalize(nodeIndex);
+        clusterMatrix.offsets.push_back(clusterMatrix.rows.size());
     }
-    clusterMatrix.trim();
 
-    std::stringstream matrixStream;
-    if(_debugMatrices)
-    {
-        matrixStream << clusterMatrix;
-        qDebug().noquote() << QString::fromStdString(matrixStream.str());
-    }
-
-    // Normalise the columns
-    normaliseColumnsColumnMajor(clusterMatrix);
-
-    // Pre-inflation
-    clusterMatrix = pow(clusterMatrix, 3.0f);
+    if(_debugIteration)
+        qDebug() << "Pre-prune nnz" << clusterMatrix.nonZeros();
 
-    // Normalise again...
-    normaliseColumnsColumnMajor(clusterMatrix);
+    if(_debugMatrices)
+        debugMatrix(QStringLiteral("Pre-inflated Matrix"), clusterMatrix);
 
-    if(_debugIteration)
-        qDebug() << "Pre nnz" << clusterMatrix.nonZeros();
+    std::vector<size_t> columns(nodeCount);
+    std::iota(columns.begin(), columns.end(), 0);
 
-    clusterMatrix.erase([this](float value){ return value < MCL_PRUNE_LIMIT; } );
+    std::vector<ColumnWorkspace> workspaces(S(ThreadPoolSingleton)->numThreads(),
+        ColumnWorkspace(nodeCount));
+    std::vector<ColumnExtent> extents(nodeCount);
 
-    if(_debugIteration)
-        qDebug() << "Pre-prune nnz" << clusterMatrix.nonZeros();
+    // The expanded matrix is gathered into here, then swapped with clusterMatrix
+    SparseMatrix expandedMatrix;
+    expandedMatrix.offsets.resize(nodeCount + 1, 0);
 
-    if(_debugMatrices)
-    {
-        matrixStream << "Pre-inflated Matrix \n";
-        matrixStream << clusterMatrix;
-        qDebug().noquote() << QString::fromStdString(matrixStream.str());
-        matrixStream.clear();
-        matrixStream.str(std::string());
-    }
+    size_t peakNonZeros = clusterMatrix.nonZeros();
 
-    // cppcheck-suppress variableScope
-    bool isEquiDistrubuted = true;
     // Start the MCL loop
     int iter = 0;
-    do
+    bool isEquiDistributed = columns.empty();
+    while(!isEquiDistributed)
     {
         if(cancelled())
             return;
 
         target.setPhase(QStringLiteral("MCL Iteration %1").arg(QString::number(iter + 1)));
-        if(_debugMatrices)
-        {
-            matrixStream << "Pre-Expanded Matrix\n";
-            matrixStream << clusterMatrix;
-            qDebug().noquote() << QString::fromStdString(matrixStream.str());
-            matrixStream.clear();
-            matrixStream.str(std::string());
-        }
 
-        isEquiDistrubuted = true;
+        if(_debugMatrices)
+            debugMatrix(QStringLiteral("Pre-Expanded Matrix"), clusterMatrix);
 
         if(_debugIteration)
             qDebug() << "Iteration" << iter;
 
-        std::vector<std::vector<SparseMatrixEntry>> matrixStorage(clusterMatrix.rows());
-
-        QElapsedTimer threadedTimer;
+        QElapsedTimer iterationTimer;
         if(_debugIteration)
-            threadedTimer.start();
+            iterationTimer.start();
 
-        // Threaded expansion
-        ColumnsIterator<MatrixType> colIterator(clusterMatrix);
-
-        // To reduce vector allocations for every row we do some magic with rowData
-        MCLRowData rowData(clusterMatrix.columns());
+        for(auto& workspace : workspaces)
+            workspace.clear();
 
+        std::atomic<bool> converged(true);
         std::atomic<uint64_t> iteration(0);
         const auto totalIterations = clusterMatrix.columns();
         target.setProgress(0);
 
-        // Pass by value rowData, this gives each THREAD a copy of rowData, rather re-allocating vectors per row (slow)
-        concurrent_for(colIterator.begin(), colIterator.end(),
-        [&, rowData, cancelledFn = [this] { return cancelled(); }](const size_t iterator) mutable
+        forEachColumn(columns, [&](size_t column, size_t threadIndex)
         {
-            expandAndPruneRow(clusterMatrix, iterator, &matrixStorage[iterator],
-                rowData, MCL_PRUNE_LIMIT, cancelledFn);
+            if(cancelled())
+                return;
+
+            auto& extent = extents[column];
+            extent._thread = threadIndex;
+
+            if(!expandPruneAndInflate(clusterMatrix, column, workspaces[threadIndex], extent,
+                inflation, MCL_PRUNE_LIMIT, MCL_CONVERGENCE_LIMIT))
+            {
+                converged = false;
+            }
 
             target.setProgress(static_cast<int>((iteration++ * 100) / totalIterations));
         });
@@ -460,91 +369,47 @@ void MCLTransform::calculateMCL(float inflation, TransformedGraph& target) const
         if(cancelled())
             return;
 
-        size_t newNNZCount = 0;
-        for(const auto& column : matrixStorage)
-            newNNZCount += column.size();
+        // Gather the columns from each thread into a single matrix
+        for(size_t column = 0; column < nodeCount; column++)
+            expandedMatrix.offsets[column + 1] = expandedMatrix.offsets[column] + extents[column]._size;
 
-        MatrixType dstMatrix(clusterMatrix.rows(), clusterMatrix.rows());
-        dstMatrix.reserve(newNNZCount);
-        int row = 0;
-        for(const auto& matrixRow : matrixStorage)
-        {
-            for(auto matrixEntry: matrixRow)
-                dstMatrix.append(matrixEntry._row, matrixEntry._column, matrixEntry._value);
+        const auto nonZeros = expandedMatrix.offsets.back();
+        expandedMatrix.rows.resize(nonZeros);
+        expandedMatrix.values.resize(nonZeros);
 
-            dstMatrix.finalize(row);
-            row++;
-        }
-        clusterMatrix = dstMatrix;
-
-        if(_debugIteration)
+        forEachColumn(columns, [&](size_t column, size_t)
         {
-            int populationTime = threadedTimer.restart();
-            qDebug() << "Threaded Expansion Population time LL ms" << populationTime;
-
-            qDebug() << "Expand nnz" << clusterMatrix.nonZeros();
-        }
+            const auto& extent = extents[column];
+            const auto& workspace = workspaces[extent._thread];
+            const auto from = static_cast<std::ptrdiff_t>(extent._start);
+            const auto to = static_cast<std::ptrdiff_t>(expandedMatrix.offsets[column]);
+            const auto size = static_cast<std::ptrdiff_t>(extent._size);
+
+            std::copy(workspace.rows.begin() + from, workspace.rows.begin() + from + size,
+                expandedMatrix.rows.begin() + to);
+            std::copy(workspace.values.begin() + from, workspace.values.begin() + from + size,
+                expandedMatrix.values.begin() + to);
+        });
 
-        if(_debugMatrices)
-        {
-            matrixStream << "Expanded Matrix \n";
-            matrixStream << clusterMatrix;
-            qDebug().noquote() << QString::fromStdString(matrixStream.str());
-            matrixStream.clear();
-            matrixStream.str(std::string());
-        }
+        std::swap(clusterMatrix, expandedMatrix);
+        isEquiDistributed = converged;
 
-        // Inflate the matrix
-        clusterMatrix = blaze::forEach(clusterMatrix, [&inflation](float d)
-            { return std::pow(d, inflation); });
+        peakNonZeros = std::max(peakNonZeros, clusterMatrix.nonZeros());
 
-        if(_debugMatrices)
+        if(_debugIteration)
         {
-            matrixStream << "Inflated Expanded Matrix \n";
-            matrixStream << clusterMatrix;
-            qDebug().noquote() << QString::fromStdString(matrixStream.str());
-            matrixStream.clear();
-            matrixStream.str(std::string());
-            qDebug() << "Inflated Expanded nnz" << clusterMatrix.nonZeros();
+            qDebug() << "Iteration time ms" << iterationTimer.elapsed();
+            qDebug() << "Expand nnz" << clusterMatrix.nonZeros();
         }
 
-        // Normalise
-        normaliseColumnsColumnMajor(clusterMatrix);
-
         if(_debugMatrices)
-        {
-            matrixStream << "Normalised Inflated Expanded Matrix \n";
-            matrixStream << clusterMatrix;
-            qDebug().noquote() << QString::fromStdString(matrixStream.str());
-            matrixStream.clear();
-            matrixStream.str(std::string());
-            qDebug() << "Normalise nnz" << clusterMatrix.nonZeros();
-        }
-
-        // Check if matrix is idempotent
-        MatrixType sqClusterMatrix = blaze::forEach(clusterMatrix, [](float d) { return d * d; });
-        VectorType colSum(nodeCount, 0);
-
-        sumColumns(sqClusterMatrix, colSum);
-        for(size_t k=0; k<clusterMatrix.columns(); ++k)
-        {
-            float max = 0;
-            for(MatrixType::ConstIterator it=clusterMatrix.cbegin(k); it!=clusterMatrix.cend(k); ++it )
-                max = std::max(it->value(),max);
-            if((max - colSum[k]) * clusterMatrix.nonZeros(k) > MCL_CONVERGENCE_LIMIT)
-            {
-                if(_debugIteration)
-                    qDebug() << "No Converge" << (max - colSum[k]) * clusterMatrix.nonZeros(k);
-                isEquiDistrubuted = false;
-                break;
-            }
-        }
+            debugMatrix(QStringLiteral("Normalised Inflated Expanded Matrix"), clusterMatrix);
 
         iter++;
-    } while(!isEquiDistrubuted);
+    }
 
     if(_debugIteration)
-        qDebug() << iter << "iterations";
+        qDebug() << iter << "iterations" << "peak nnz" << peakNonZeros;
 
     target.setPhase(QStringLiteral("MCL Interpreting"));
 
@@ -552,30 +417,31 @@ void MCLTransform::calculateMCL(float inflation, TransformedGraph& target) const
     std::vector<std::set<size_t>> clusters;
     std::vector<size_t> clusterGroups(nodeCount, 0);
     std::vector<bool> clusterGroupAssigned(nodeCount, false);
-    for(size_t k = 0; k < clusterMatrix.columns(); ++k)
+    for(size_t k = 0; k < nodeCount; ++k)
     {
-        for(const auto* it = clusterMatrix.cbegin(k); it != clusterMatrix.cend(k); ++it )
+        for(auto i = clusterMatrix.offsets[k]; i < clusterMatrix.offsets[k + 1]; ++i)
         {
-            if(it->value() < MCL_PRUNE_LIMIT)
+            if(clusterMatrix.values[i] < MCL_PRUNE_LIMIT)
                 continue;
 
-            auto rowCluster = clusterGroups[it->index()];
+            const size_t index = clusterMatrix.rows[i];
+            auto rowCluster = clusterGroups[index];
             auto columnCluster = clusterGroups[k];
-            auto rowClusterAssigned = clusterGroupAssigned[it->index()];
+            auto rowClusterAssigned = clusterGroupAssigned[index];
             auto columnClusterAssigned = clusterGroupAssigned[k];
 
             // If no cluster exists, make one
             if(!rowClusterAssigned && !columnClusterAssigned)
             {
                 std::set<size_t> newClusterNodeIndex;
-                newClusterNodeIndex.insert(it->index());
+                newClusterNodeIndex.insert(index);
                 newClusterNodeIndex.insert(k);
                 clusters.emplace_back(std::move(newClusterNodeIndex));
 
-                auto index = clusters.size() - 1;
-                clusterGroups[it->index()] = index;
-                clusterGroups[k] = index;
-                clusterGroupAssigned[it->index()] = true;
+                auto clusterIndex = clusters.size() - 1;
+                clusterGroups[index] = clusterIndex;
+                clusterGroups[k] = clusterIndex;
+                clusterGroupAssigned[index] = true;
                 clusterGroupAssigned[k] = true;
             }
             else if(rowClusterAssigned)
@@ -600,9 +466,9 @@ void MCLTransform::calculateMCL(float inflation, TransformedGraph& target) const
             else if(columnClusterAssigned)
             {
                 // Add to Column Cluster
-                clusterGroups[it->index()] = columnCluster;
-                clusterGroupAssigned[it->index()] = true;
-                clusters[columnCluster].insert(it->index());
+                clusterGroups[index] = columnCluster;
+                clusterGroupAssigned[index] = true;
+                clusters[columnCluster].insert(index);
             }
         }
     }
@@ -624,7 +490,7 @@ void MCLTransform::calculateMCL(float inflation, TransformedGraph& target) const
 
         for(auto index : cluster)
         {
-            auto nodeId = indexToNodeMap.at(index);
+            auto nodeId = adjacency.nodeIdAt(static_cast<int>(index));
             auto clusterName = QString(QObject::tr("Cluster %1")).arg(QString::number(clusterNumber));
 
             clusterNames[nodeId] = clusterName;
@@ -645,4 +511,3 @@ std::unique_ptr<GraphTransform> MCLTransformFactory::create(const GraphTransform
 {
     return std::make_unique<MCLTransform>(graphModel());
 }
-
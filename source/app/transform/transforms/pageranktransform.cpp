@@ -23,138 +23,417 @@
 #include "graph/graphcomponent.h"
 #include "graph/graphmodel.h"
 #include "graph/componentmanager.h"
+#include "graph/adjacencysnapshot.h"
 
-#include <blaze/Blaze.h>
+#include "shared/utils/threadpool.h"
 
 #include <QElapsedTimer>
 #include <QDebug>
 
-#include <map>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <cmath>
 
-using VectorType = blaze::DynamicVector<float>;
+// Performs an estimated pagerank calculation optimised to
+// not use a matrix. This dramatically lowers the memory footprint.
+// http://www.dcs.bbk.ac.uk/~dell/teaching/cc/book/mmds/mmds_ch5_2.pdf
+// http://michaelnielsen.org/blog/using-your-laptop-to-compute-pagerank-for-millions-of-webpages/
 
-void PageRankTransform::apply(TransformedGraph& target) const
+// The graph in compressed sparse row form, with its nodes renumbered so that
+// each component occupies a contiguous range; it depends only on the graph's
+// structure, so the iteration itself is free to vary in damping or precision
+struct PageRankGraph
 {
-    calculatePageRank(target);
+    // The neighbours of node i are [offsets[i], offsets[i + 1])
+    std::vector<int> offsets;
+    std::vector<int> neighbours;
+    std::vector<int> degrees;
+
+    // The original adjacency index of each node
+    std::vector<int> snapshotIndices;
+
+    struct Component
+    {
+        size_t _index = 0;
+        int _first = 0;
+        int _last = 0;
+
+        int size() const { return _last - _first; }
+        uint64_t computeCostHint() const { return static_cast<uint64_t>(size()); }
+    };
+
+    std::vector<Component> components;
+
+    int numNodes() const { return static_cast<int>(degrees.size()); }
+};
+
+std::shared_ptr<const PageRankGraph> PageRankGraphCache::find(
+    const std::shared_ptr<const AdjacencySnapshot>& adjacency)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+
+    if(_adjacency == nullptr)
+        return nullptr;
+
+    if(_adjacency != adjacency && !_adjacency->sameStructureAs(*adjacency))
+        return nullptr;
+
+    return _graph;
 }
 
-void PageRankTransform::calculatePageRank(TransformedGraph& target) const
+void PageRankGraphCache::store(const std::shared_ptr<const AdjacencySnapshot>& adjacency,
+    const std::shared_ptr<const PageRankGraph>& graph)
 {
-    // Performs an estimated pagerank calculation optimised to
-    // not use a matrix. This dramatically lowers the memory footprint.
-    // http://www.dcs.bbk.ac.uk/~dell/teaching/cc/book/mmds/mmds_ch5_2.pdf
-    // http://michaelnielsen.org/blog/using-your-laptop-to-compute-pagerank-for-millions-of-webpages/
-    NodeArray<float> pageRankScores(target);
+    std::unique_lock<std::mutex> lock(_mutex);
 
-    target.setPhase(QStringLiteral("PageRank"));
+    _adjacency = adjacency;
+    _graph = graph;
+}
 
+namespace
+{
+std::shared_ptr<const PageRankGraph> buildPageRankGraph(Graph& target, const AdjacencySnapshot& adjacency)
+{
     // We must do our own componentisation as the graph's set of components
     // won't necessarily be up-to-date
     ComponentManager componentManager(target);
 
-    int totalIterationCount = 0;
+    const auto numNodes = adjacency.numNodes();
+
+    auto graph = std::make_shared<PageRankGraph>();
+    graph->snapshotIndices.reserve(static_cast<size_t>(numNodes));
+
+    // Maps a snapshot index to an index within graph
+    std::vector<int> indices(static_cast<size_t>(numNodes), -1);
+
     for(auto componentId : componentManager.componentIds())
-    {        
+    {
         const IGraphComponent* component = componentManager.componentById(componentId);
-        auto componentNodeCount = static_cast<int>(component->nodeIds().size());
 
-        // Map NodeIds to Matrix index
-        std::map<NodeId, int> nodeToIndexMap;
-        std::map<int, NodeId> indexToNodeMap;
+        PageRankGraph::Component range;
+        range._index = graph->components.size();
+        range._first = static_cast<int>(graph->snapshotIndices.size());
+
         for(auto nodeId : component->nodeIds())
         {
-            auto index = static_cast<int>(nodeToIndexMap.size());
-            nodeToIndexMap[nodeId] = index;
-            indexToNodeMap[index] = nodeId;
+            auto snapshotIndex = adjacency.indexOf(nodeId);
+            indices[static_cast<size_t>(snapshotIndex)] = static_cast<int>(graph->snapshotIndices.size());
+            graph->snapshotIndices.push_back(snapshotIndex);
+        }
+
+        range._last = static_cast<int>(graph->snapshotIndices.size());
+        graph->components.push_back(range);
+    }
+
+    graph->offsets.reserve(graph->snapshotIndices.size() + 1);
+    graph->offsets.push_back(0);
+    graph->neighbours.reserve(static_cast<size_t>(adjacency.numEntries()));
+    graph->degrees.reserve(graph->snapshotIndices.size());
+
+    for(auto snapshotIndex : graph->snapshotIndices)
+    {
+        for(auto neighbour : adjacency.neighbours(snapshotIndex))
+            graph->neighbours.push_back(indices[static_cast<size_t>(neighbour)]);
+
+        graph->offsets.push_back(static_cast<int>(graph->neighbours.size()));
+        graph->degrees.push_back(adjacency.degree(snapshotIndex));
+    }
+
+    return graph;
+}
+
+// Below this many elements, dispatching work to the thread pool costs more than it saves
+constexpr size_t MinimumConcurrentRange = 1024;
+
+template<typename It, typename Fn>
+void forEach(It first, It last, Fn&& fn)
+{
+    if(static_cast<size_t>(std::distance(first, last)) < MinimumConcurrentRange)
+    {
+        std::for_each(first, last, fn);
+        return;
+    }
+
+    concurrent_for(first, last, fn);
+}
+
+struct PageRankResult
+{
+    std::vector<float> _scores;
+    int _iterationCount = 0;
+    bool _hitIterationLimit = false;
+};
+
+// The convergence state of a single component
+template<typename T>
+struct ComponentConvergence
+{
+    bool _converged = false;
+
+    // Oscillation detection; the most recent changes, in a ring
+    std::vector<T> _changes;
+    size_t _nextChange = 0;
+    T _previousChangeAverage = T(0);
+
+    // Returns true if the component has converged after an iteration which changed it by change
+    bool update(T change, int iterationCount, const PageRankTransform::Settings& settings)
+    {
+        if(change <= static_cast<T>(settings._epsilon))
+            return (_converged = true);
+
+        // Average over the last few steps
+        const auto averageCount = static_cast<size_t>(settings._averageCount);
+        if(averageCount > 1)
+        {
+            if(_changes.size() < averageCount - 1)
+                _changes.push_back(change);
+            else
+            {
+                _changes[_nextChange] = change;
+                _nextChange = (_nextChange + 1) % _changes.size();
+            }
         }
 
-        QElapsedTimer timer;
-        if (_debug)
-            timer.start();
-
-        VectorType pageRankVector(componentNodeCount, 1.0f / componentNodeCount);
-        VectorType newPageRankVector(componentNodeCount);
-        VectorType delta(componentNodeCount);
-        float change = std::numeric_limits<float>::max();
-        int iterationCount = 0;
-        std::deque<float> changeBuffer;
-        float previousBufferChangeAverage = 0.0f;
-        float pagerankAcceleration = std::numeric_limits<float>::max();
-        while(change > PAGERANK_EPSILON &&
-              iterationCount < PAGERANK_ITERATION_LIMIT &&
-              pagerankAcceleration > PAGERANK_ACCELERATION_MINIMUM)
+        T changeAverage = T(0);
+        for(auto recentChange : _changes)
+            changeAverage += recentChange;
+        changeAverage /= static_cast<T>(settings._averageCount);
+
+        const auto acceleration = std::abs(_previousChangeAverage - changeAverage);
+
+        // Only update the previous average every averageCount steps
+        if(iterationCount % settings._averageCount == 0)
+            _previousChangeAverage = changeAverage;
+
+        if(acceleration <= static_cast<T>(settings._accelerationMinimum))
+            return (_converged = true);
+
+        return false;
+    }
+};
+
+template<typename T>
+PageRankResult iterate(const PageRankGraph& graph, const PageRankTransform::Settings& settings,
+    const Cancellable& cancellable)
+{
+    const auto numNodes = static_cast<size_t>(graph.numNodes());
+    const auto damping = static_cast<T>(settings._damping);
+
+    // Each node's share of the teleportation term is uniform within its component
+    std::vector<T> teleport(numNodes);
+    std::vector<T> pageRank(numNodes);
+    for(const auto& component : graph.components)
+    {
+        const auto uniform = T(1) / static_cast<T>(component.size());
+
+        for(auto i = component._first; i < component._last; i++)
         {
-            if(cancelled())
-                return;
+            teleport[static_cast<size_t>(i)] = (T(1) - damping) * uniform;
+            pageRank[static_cast<size_t>(i)] = uniform;
+        }
+    }
+
+    // Dangling nodes have an inverse degree of 0, so they distribute nothing,
+    // and their mass is recovered when their component is renormalised
+    std::vector<T> inverseDegrees(numNodes);
+    std::transform(graph.degrees.begin(), graph.degrees.end(), inverseDegrees.begin(),
+        [](int degree) { return degree > 0 ? T(1) / static_cast<T>(degree) : T(0); });
+
+    std::vector<T> contributions(numNodes);
+    std::vector<T> newPageRank(pageRank);
 
-            target.setPhase(QStringLiteral("PageRank Iteration %1").arg(
-                                QString::number(totalIterationCount + 1)));
+    // Components converge independently; once one has, it is frozen and
+    // no longer iterated, so the remainder of the work is spent only on
+    // those that are still changing
+    std::vector<ComponentConvergence<T>> convergence(graph.components.size());
+    std::vector<T> componentChanges(graph.components.size());
 
-            // Calculate pagerank
-            for(auto nodeId : component->nodeIds())
+    std::vector<PageRankGraph::Component> activeComponents(graph.components);
+    std::vector<int> activeNodes(numNodes);
+    std::iota(activeNodes.begin(), activeNodes.end(), 0);
+
+    int iterationCount = 0;
+
+    while(!activeComponents.empty() && iterationCount < settings._iterationLimit)
+    {
+        if(cancellable.cancelled())
+            return {};
+
+        if(settings._gaussSeidel)
+        {
+            // Each component is swept sequentially, updating its values in place so
+            // that later nodes see the new values of earlier ones; components are
+            // independent, so they are swept concurrently
+            forEach(activeComponents.begin(), activeComponents.end(),
+            [&](const PageRankGraph::Component& component)
             {
-                auto matrixId = nodeToIndexMap[nodeId];
-                float prSum = 0.0f;
-                for(auto edgeId : target.edgeIdsForNodeId(nodeId))
+                std::copy(pageRank.begin() + component._first, pageRank.begin() + component._last,
+                    newPageRank.begin() + component._first);
+
+                for(auto node = component._first; node < component._last; node++)
                 {
-                    auto oppositeNodeId = target.edgeById(edgeId).oppositeId(nodeId);
-                    prSum += pageRankVector[nodeToIndexMap[oppositeNodeId]] /
-                        static_cast<float>(target.nodeById(oppositeNodeId).degree());
+                    T sum = T(0);
+                    for(auto i = graph.offsets[node]; i < graph.offsets[node + 1]; i++)
+                    {
+                        const auto neighbour = static_cast<size_t>(graph.neighbours[i]);
+                        sum += newPageRank[neighbour] * inverseDegrees[neighbour];
+                    }
+
+                    newPageRank[static_cast<size_t>(node)] = (sum * damping) + teleport[static_cast<size_t>(node)];
                 }
-                 newPageRankVector[matrixId] = (prSum * PAGERANK_DAMPING) +
-                         ((1.0f - PAGERANK_DAMPING) / componentNodeCount);
+            });
+        }
+        else
+        {
+            // Neighbours are always in the same component, so only the active nodes contribute
+            for(auto node : activeNodes)
+            {
+                const auto i = static_cast<size_t>(node);
+                contributions[i] = pageRank[i] * inverseDegrees[i];
             }
 
-            // Normalise result
-            float sum = 0.0f;
-            for(auto value : newPageRankVector)
-                sum += value;
-             newPageRankVector = newPageRankVector / sum;
-
-            // Detect PR Change
-            change = 0.0f;
-            delta = blaze::abs(newPageRankVector - pageRankVector);
-            for(size_t i = 0UL; i < newPageRankVector.size(); ++i )
-                change += delta[i];
-
-            // Oscillation detection (delta avg)
-            changeBuffer.push_front(change);
-            if(changeBuffer.size() >= static_cast<size_t>(AVG_COUNT))
-                changeBuffer.pop_back();
-
-            // Average the last 10 steps
-            float bufferChangeAverage = 0.0f;
-            for(auto changes : changeBuffer)
-                bufferChangeAverage += changes;
-            bufferChangeAverage /= static_cast<float>(AVG_COUNT);
-
-            pagerankAcceleration = std::abs(previousBufferChangeAverage - bufferChangeAverage);
-
-            // Only update the previousAvg after AVG_COUNT steps
-            if(iterationCount % AVG_COUNT == 0)
-                previousBufferChangeAverage = bufferChangeAverage;
-
-            pageRankVector = newPageRankVector;
-            iterationCount++;
-            totalIterationCount++;
+            forEach(activeNodes.begin(), activeNodes.end(), [&](int node)
+            {
+                T sum = T(0);
+                for(auto i = graph.offsets[node]; i < graph.offsets[node + 1]; i++)
+                    sum += contributions[static_cast<size_t>(graph.neighbours[i])];
+
+                newPageRank[static_cast<size_t>(node)] = (sum * damping) + teleport[static_cast<size_t>(node)];
+            });
         }
-        if(_debug && iterationCount == PAGERANK_ITERATION_LIMIT)
-            qDebug() << "HIT ITERATION LIMIT ON PAGERANK. LIKELY UNSTABLE PAGERANK VECTOR";
 
-        float maxValue = blaze::max(blaze::abs(pageRankVector) );
-        pageRankVector = pageRankVector / maxValue;
+        // Normalise each component, and find how much it has changed
+        forEach(activeComponents.begin(), activeComponents.end(),
+        [&](const PageRankGraph::Component& component)
+        {
+            auto* values = newPageRank.data() + component._first;
+            const auto* oldValues = pageRank.data() + component._first;
+            const auto size = static_cast<size_t>(component.size());
 
-        for(auto nodeId : component->nodeIds())
-            pageRankScores[nodeId] = pageRankVector[nodeToIndexMap[nodeId]];
+            T sum = T(0);
+            for(size_t i = 0; i < size; i++)
+                sum += values[i];
+
+            const auto scale = T(1) / sum;
+            T componentChange = T(0);
+            for(size_t i = 0; i < size; i++)
+            {
+                values[i] *= scale;
+                componentChange += std::abs(values[i] - oldValues[i]);
+            }
+
+            componentChanges[component._index] = componentChange;
+        });
+
+        std::swap(pageRank, newPageRank);
+
+        bool anyConverged = false;
+        for(const auto& component : activeComponents)
+        {
+            if(!convergence[component._index].update(componentChanges[component._index], iterationCount, settings))
+                continue;
+
+            // Both buffers must hold the final values, as a frozen component is
+            // neither swept nor normalised again
+            std::copy(pageRank.begin() + component._first, pageRank.begin() + component._last,
+                newPageRank.begin() + component._first);
+            anyConverged = true;
+        }
+
+        iterationCount++;
+
+        if(!anyConverged)
+            continue;
+
+        activeComponents.erase(std::remove_if(activeComponents.begin(), activeComponents.end(),
+            [&convergence](const auto& component) { return convergence[component._index]._converged; }),
+            activeComponents.end());
+
+        if(!settings._gaussSeidel)
+        {
+            activeNodes.clear();
+            for(const auto& component : activeComponents)
+            {
+                for(auto node = component._first; node < component._last; node++)
+                    activeNodes.push_back(node);
+            }
+        }
+    }
+
+    PageRankResult result;
+    result._iterationCount = iterationCount;
+    result._hitIterationLimit = !activeComponents.empty();
+    result._scores.resize(numNodes);
+
+    // Scale each component so that its highest value is 1
+    for(const auto& component : graph.components)
+    {
+        auto first = pageRank.begin() + component._first;
+        auto last = pageRank.begin() + component._last;
+        const auto maxValue = *std::max_element(first, last);
+
+        std::transform(first, last, result._scores.begin() + component._first,
+            [maxValue](T value) { return static_cast<float>(value / maxValue); });
+    }
+
+    return result;
+}
+} // namespace
+
+void PageRankTransform::apply(TransformedGraph& target) const
+{
+    calculatePageRank(target);
+}
+
+void PageRankTransform::calculatePageRank(TransformedGraph& target) const
+{
+    NodeArray<float> pageRankScores(target);
+
+    target.setPhase(QStringLiteral("PageRank"));
+
+    Settings settings;
+
+    if(config().hasParameter(QStringLiteral("Damping")))
+        settings._damping = std::get<double>(config().parameterByName(QStringLiteral("Damping"))->_value);
+
+    settings._gaussSeidel = config().parameterHasValue(QStringLiteral("Acceleration"), QStringLiteral("Gauss-Seidel"));
+    const bool doublePrecision = config().parameterHasValue(QStringLiteral("Precision"), QStringLiteral("Double"));
+
+    QElapsedTimer timer;
+    if(_debug)
+        timer.start();
+
+    auto adjacency = target.adjacencySnapshot();
 
-        if (_debug)
+    auto graph = _graphCache->find(adjacency);
+    if(graph == nullptr)
+    {
+        graph = buildPageRankGraph(target, *adjacency);
+        _graphCache->store(adjacency, graph);
+    }
+
+    // An empty graph has nothing to rank, but still gets the attribute
+    if(!graph->components.empty())
+    {
+        target.setPhase(QStringLiteral("PageRank Iterating"));
+
+        auto result = doublePrecision ?
+            iterate<double>(*graph, settings, *this) :
+            iterate<float>(*graph, settings, *this);
+
+        if(cancelled())
+            return;
+
+        for(size_t i = 0; i < result._scores.size(); i++)
+            pageRankScores[adjacency->nodeIdAt(graph->snapshotIndices[i])] = result._scores[i];
+
+        if(_debug)
         {
-            std::stringstream matrixStream;
-            matrixStream << pageRankVector;
-            qDebug() << "PageRank";
-            qDebug().noquote() << QString::fromStdString(matrixStream.str());
+            if(result._hitIterationLimit)
+                qDebug() << "HIT ITERATION LIMIT ON PAGERANK. LIKELY UNSTABLE PAGERANK VECTOR";
 
-            qDebug() << "Pagerank took" << iterationCount << "iterations";
+            qDebug() << "Pagerank took" << result._iterationCount << "iterations";
             qDebug() << "The efficient pagerank operation took" << timer.elapsed();
         }
     }
@@ -169,6 +448,5 @@ void PageRankTransform::calculatePageRank(TransformedGraph& target) const
 
 std::unique_ptr<GraphTransform> PageRankTransformFactory::create(const GraphTransformConfig&) const
 {
-    return std::make_unique<PageRankTransform>(graphModel());
+    return std::make_unique<PageRankTransform>(graphModel(), _graphCache);
 }
-
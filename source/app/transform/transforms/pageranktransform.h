@@ -24,30 +24,63 @@
 #include "shared/utils/flags.h"
 #include "shared/utils/redirects.h"
 
+#include <memory>
+#include <mutex>
+
+class AdjacencySnapshot;
+struct PageRankGraph;
+
+// Changing the damping, acceleration or precision of a PageRank transform
+// reapplies it to a graph with the same structure as before, so the graph it
+// iterates over is kept and reused for as long as that structure is unchanged
+class PageRankGraphCache
+{
+private:
+    std::mutex _mutex;
+    std::shared_ptr<const AdjacencySnapshot> _adjacency;
+    std::shared_ptr<const PageRankGraph> _graph;
+
+public:
+    std::shared_ptr<const PageRankGraph> find(const std::shared_ptr<const AdjacencySnapshot>& adjacency);
+    void store(const std::shared_ptr<const AdjacencySnapshot>& adjacency,
+        const std::shared_ptr<const PageRankGraph>& graph);
+};
+
 class PageRankTransform : public GraphTransform
 {
 public:
-    explicit PageRankTransform(GraphModel* graphModel) : _graphModel(graphModel) {}
+    PageRankTransform(GraphModel* graphModel, std::shared_ptr<PageRankGraphCache> graphCache) :
+        _graphModel(graphModel), _graphCache(std::move(graphCache))
+    {}
     void apply(TransformedGraph& target) const override;
 
     void enableDebug() { _debug = true; }
     void disableDebug() { _debug = false; }
 
-private:
-    const float PAGERANK_DAMPING = 0.8f;
-    const float PAGERANK_EPSILON = 1e-6f;
-    const float PAGERANK_ACCELERATION_MINIMUM = 1e-10f;
-    const int PAGERANK_ITERATION_LIMIT = 1000;
-    const int AVG_COUNT = 10;
+    struct Settings
+    {
+        double _damping = 0.8;
+        double _epsilon = 1e-6;
+        double _accelerationMinimum = 1e-10;
+        int _iterationLimit = 1000;
+        int _averageCount = 10;
+
+        bool _gaussSeidel = false;
+    };
 
+private:
     bool _debug = false;
 
     void calculatePageRank(TransformedGraph& target) const;
     GraphModel* _graphModel = nullptr;
+    std::shared_ptr<PageRankGraphCache> _graphCache;
 };
 
 class PageRankTransformFactory : public GraphTransformFactory
 {
+private:
+    std::shared_ptr<PageRankGraphCache> _graphCache = std::make_shared<PageRankGraphCache>();
+
 public:
     explicit PageRankTransformFactory(GraphModel* graphModel) :
         GraphTransformFactory(graphModel)
@@ -61,6 +94,31 @@ public:
     }
     QString category() const override { return QObject::tr("Metrics"); }
     ElementType elementType() const override { return ElementType::None; }
+
+    GraphTransformParameters parameters() const override
+    {
+        return
+        {
+            {
+                "Damping", ValueType::Float,
+                QObject::tr("The probability of following an edge, rather than jumping to a random node."),
+                0.8, 0.05, 0.99
+            },
+            {
+                "Acceleration", ValueType::StringList,
+                QObject::tr("Gauss-Seidel uses each newly calculated value immediately, "
+                    "which reduces the number of iterations required, but each component "
+                    "is then calculated by a single thread."),
+                QStringList{"None", "Gauss-Seidel"}
+            },
+            {
+                "Precision", ValueType::StringList,
+                QObject::tr("Double precision is slower and uses more memory, but may "
+                    "converge more accurately on very large graphs."),
+                QStringList{"Single", "Double"}
+            }
+        };
+    }
     DefaultVisualisations defaultVisualisations() const override
     {
         return {{"Node PageRank", ValueType::Float, {AttributeFlag::VisualiseByComponent}, QObject::tr("Colour")}};
@@ -71,6 +71,7 @@
 #include <QElapsedTimer>
 #include <QVariantList>
 #include <QVector>
+#include <QtConcurrent/QtConcurrent>
 
 QColor Document::contrastingColorForBackground()
 {
@@ -628,7 +629,7 @@ bool Document::openFile(const QUrl& fileUrl, const QString& fileType, QString pl
                 completedLoader->transforms());
 
             _visualisations = completedLoader->visualisations();
-            _bookmarks = completedLoader->bookmarks();
+            _deferredDataFn = completedLoader->deferredDataFn();
 
             _graphModel->buildTransforms(_graphTransforms);
 
@@ -653,18 +654,6 @@ bool Document::openFile(const QUrl& fileUrl, const QString& fileType, QString pl
 
             _pluginUiData = completedLoader->pluginUiData();
             _pluginUiDataVersion = completedLoader->pluginUiDataVersion();
-
-            const auto& enrichmentTableModels = completedLoader->enrichmentTableModels();
-            executeOnMainThread([this, enrichmentTableModels]()
-            {
-                for(const auto& table : enrichmentTableModels)
-                {
-                    auto* tableModel = new EnrichmentTableModel(this);
-                    _enrichmentTableModels.append(tableModel);
-                    tableModel->setTableData(table);
-                    emit enrichmentTableModelsChanged();
-                }
-            });
         });
     }
     else
@@ -695,6 +684,13 @@ void Document::saveFile(const QUrl& fileUrl, const QString& saverName, const QBy
     auto* factory = _application->saverFactoryByName(saverName);
     if(factory != nullptr)
     {
+        // Don't save before everything has actually been loaded
+        if(_deferredDataPending)
+        {
+            _deferredDataWatcher.waitForFinished();
+            applyDeferredData();
+        }
+
         _commandManager.executeOnce(
         [=](Command& command) mutable
         {
@@ -752,8 +748,16 @@ void Document::onLoadComplete(const QUrl&, bool success)
     setTransforms(_graphTransforms);
     setVisualisations(_visualisations);
 
-    if(!_bookmarks.empty())
-        emit bookmarksChanged();
+    if(_deferredDataFn != nullptr)
+    {
+        // None of this is needed in order to display the graph, so load it in the background
+        connect(&_deferredDataWatcher, &QFutureWatcher<Loader::DeferredData>::finished,
+            this, &Document::applyDeferredData);
+
+        _deferredDataPending = true;
+        _deferredDataWatcher.setFuture(QtConcurrent::run(_deferredDataFn));
+        _deferredDataFn = nullptr;
+    }
 
     _layoutThread = std::make_unique<LayoutThread>(*_graphModel, std::make_unique<ForceDirectedLayoutFactory>(_graphModel.get()));
 
@@ -939,6 +943,32 @@ void Document::onLoadComplete(const QUrl&, bool success)
                 _graphModel->graph().numComponents()));
 }
 
+void Document::applyDeferredData()
+{
+    if(!_deferredDataPending)
+        return;
+
+    _deferredDataPending = false;
+    auto deferredData = _deferredDataWatcher.result();
+
+    if(!deferredData._bookmarks.empty())
+    {
+        // Bookmarks made in the meantime take precedence
+        _bookmarks.insert(deferredData._bookmarks.begin(), deferredData._bookmarks.end());
+        emit bookmarksChanged();
+    }
+
+    for(const auto& table : deferredData._enrichmentTables)
+    {
+        auto* tableModel = new EnrichmentTableModel(this);
+        _enrichmentTableModels.append(tableModel);
+        tableModel->setTableData(table);
+    }
+
+    if(!deferredData._enrichmentTables.empty())
+        emit enrichmentTableModelsChanged();
+}
+
 void Document::onBusyChanged() const
 {
     if(!busy())
@@ -2744,11 +2774,13 @@ void Document::saveNodePositionsToFile(const QUrl& fileUrl)
     {
         json positions;
 
+        auto nodePositions = _graphModel->nodePositions().snapshot();
+
         uint64_t i = 0;
         for(auto nodeId : _graphModel->graph().nodeIds())
         {
             auto name = _graphModel->nodeNames().at(nodeId);
-            auto v = _graphModel->nodePositions().get(nodeId);
+            auto v = nodePositions.get(nodeId);
 
             positions.push_back(
             {
@@ -25,6 +25,7 @@
 #include "commands/commandmanager.h"
 #include "graph/qmlelementid.h"
 #include "layout/layout.h"
+#include "loading/nativeloader.h"
 #include "loading/parserthread.h"
 #include "rendering/compute/gpucomputethread.h"
 #include "rendering/projection.h"
@@ -42,6 +43,7 @@
 #include <QQmlVariantListModel.h>
 #include <QQmlObjectListModel.h>
 
+#include <QFutureWatcher>
 #include <QQuickItem>
 #include <QString>
 #include <QStringList>
@@ -278,6 +280,13 @@ private:
 
     std::map<QString, NodeIdSet> _bookmarks;
 
+    // Bookmarks and enrichment tables are loaded after the graph is displayed
+    Loader::DeferredDataFn _deferredDataFn;
+    QFutureWatcher<Loader::DeferredData> _deferredDataWatcher;
+    bool _deferredDataPending = false;
+
+    void applyDeferredData();
+
     QStringList graphTransformConfigurationsFromUI() const;
     QStringList visualisationsFromUI() const;
 
@@ -37,7 +37,7 @@
 
 #include "layout/collision.h"
 
-#include "ui/visualisations/elementvisual.h"
+#include "shared/ui/visualisations/elementvisual.h"
 
 #include <QMouseEvent>
 #include <QKeyEvent>
@@ -55,12 +55,14 @@ NodeIdSet nodeIdsInsideFrustum(const GraphModel& graphModel,
     const auto* component = graphModel.graph().componentById(componentId);
     Q_ASSERT(component != nullptr);
 
+    auto nodePositions = graphModel.nodePositions().snapshot();
+
     for(NodeId nodeId : component->nodeIds())
     {
         if(graphModel.nodeVisual(nodeId).state().test(VisualFlags::Unhighlighted))
             continue;
 
-        const QVector3D nodePosition = graphModel.nodePositions().get(nodeId);
+        const QVector3D nodePosition = nodePositions.get(nodeId);
         if(frustum.containsPoint(nodePosition))
             selection.insert(nodeId);
     }
@@ -78,13 +80,15 @@ static NodeId nodeIdInsideFrustumNearestPoint(const GraphModel& graphModel,
     NodeId closestNodeId;
     float minimumDistance = std::numeric_limits<float>::max();
 
+    auto nodePositions = graphModel.nodePositions().snapshot();
+
     for(auto nodeId : nodeIds)
     {
         if(graphModel.nodeVisual(nodeId).state().test(VisualFlags::Unhighlighted))
             continue;
 
         float distanceToCentre = Ray(frustum.centreLine()).distanceTo(point);
-        float distanceToPoint = graphModel.nodePositions().get(nodeId).distanceToPoint(point);
+        float distanceToPoint = nodePositions.get(nodeId).distanceToPoint(point);
         float distance = distanceToCentre + distanceToPoint;
 
         if(distance < minimumDistance)
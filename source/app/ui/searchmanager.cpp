@@ -147,20 +147,33 @@ void SearchManager::findNodes(QString term, Flags<FindOptions> options,
         }
     }
 
-    bool changed = u::setsDiffer(_foundNodeIds, foundNodeIds);
-
-    _foundNodeIds = std::move(foundNodeIds);
-
-    if(changed)
-        emit foundNodeIdsChanged(this);
+    setFoundNodeIds(std::move(foundNodeIds));
 }
 
 void SearchManager::clearFoundNodeIds()
 {
-    bool changed = !_foundNodeIds.empty();
-    _foundNodeIds.clear();
+    setFoundNodeIds({});
+}
+
+void SearchManager::setFoundNodeIds(NodeIdSet foundNodeIds)
+{
+    _changedNodeIds.clear();
+
+    for(auto nodeId : _foundNodeIds)
+    {
+        if(!u::contains(foundNodeIds, nodeId))
+            _changedNodeIds.insert(nodeId);
+    }
+
+    for(auto nodeId : foundNodeIds)
+    {
+        if(!u::contains(_foundNodeIds, nodeId))
+            _changedNodeIds.insert(nodeId);
+    }
+
+    _foundNodeIds = std::move(foundNodeIds);
 
-    if(changed)
+    if(!_changedNodeIds.empty())
         emit foundNodeIdsChanged(this);
 }
 
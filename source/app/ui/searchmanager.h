@@ -48,6 +48,9 @@ public:
     void refresh();
 
     const NodeIdSet& foundNodeIds() const { return _foundNodeIds; }
+
+    // The nodes that were either found or lost by the most recent change to foundNodeIds
+    const NodeIdSet& changedNodeIds() const { return _changedNodeIds; }
     bool nodeWasFound(NodeId nodeId) const;
 
     bool active() const { return !_term.isEmpty(); }
@@ -62,6 +65,9 @@ private:
 
     const GraphModel* _graphModel = nullptr;
     NodeIdSet _foundNodeIds;
+    NodeIdSet _changedNodeIds;
+
+    void setFoundNodeIds(NodeIdSet foundNodeIds);
 
 signals:
     void foundNodeIdsChanged(const SearchManager*);
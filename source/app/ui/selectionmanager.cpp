@@ -73,7 +73,7 @@ NodeIdSet SelectionManager::unselectedNodes() const
 
 //FIXME http://en.cppreference.com/w/cpp/container/unordered_set/merge will be useful here
 template<typename C> bool _selectNodes(const GraphModel& graphModel, NodeIdSet& selectedNodeIds,
-    NodeIdSet& mask, const C& nodeIds, bool selectMergedNodes = true)
+    NodeIdSet& changedNodeIds, NodeIdSet& mask, const C& nodeIds, bool selectMergedNodes = true)
 {
     NodeIdSet newSelectedNodeIds;
 
@@ -102,16 +102,25 @@ template<typename C> bool _selectNodes(const GraphModel& graphModel, NodeIdSet&
         }
     }
 
-    auto oldSize = selectedNodeIds.size();
-    selectedNodeIds.insert(newSelectedNodeIds.begin(), newSelectedNodeIds.end());
-    return selectedNodeIds.size() > oldSize;
+    bool selectionWillChange = false;
+
+    for(auto nodeId : newSelectedNodeIds)
+    {
+        if(selectedNodeIds.insert(nodeId).second)
+        {
+            changedNodeIds.insert(nodeId);
+            selectionWillChange = true;
+        }
+    }
+
+    return selectionWillChange;
 }
 
 bool SelectionManager::selectNodes(const NodeIdSet& nodeIds)
 {
     return callFnAndMaybeEmit([this, &nodeIds]
     {
-        return _selectNodes(*_graphModel, _selectedNodeIds, _nodeIdsMask, nodeIds, true);
+        return _selectNodes(*_graphModel, _selectedNodeIds, _changedNodeIds, _nodeIdsMask, nodeIds, true);
     });
 }
 
@@ -119,7 +128,7 @@ bool SelectionManager::selectNodes(const std::vector<NodeId>& nodeIds)
 {
     return callFnAndMaybeEmit([this, &nodeIds]
     {
-        return _selectNodes(*_graphModel, _selectedNodeIds, _nodeIdsMask, nodeIds, true);
+        return _selectNodes(*_graphModel, _selectedNodeIds, _changedNodeIds, _nodeIdsMask, nodeIds, true);
     });
 }
 
@@ -127,16 +136,25 @@ bool SelectionManager::selectNode(NodeId nodeId)
 {
     return callFnAndMaybeEmit([this, nodeId]
     {
-        return _selectNodes(*_graphModel, _selectedNodeIds, _nodeIdsMask, std::array<NodeId, 1>{{nodeId}}, true);
+        return _selectNodes(*_graphModel, _selectedNodeIds, _changedNodeIds, _nodeIdsMask, std::array<NodeId, 1>{{nodeId}}, true);
     });
 }
 
 
 template<typename C> bool _deselectNodes(const GraphModel& graphModel, NodeIdSet& selectedNodeIds,
-    const C& nodeIds, bool deselectMergedNodes = true)
+    NodeIdSet& changedNodeIds, const C& nodeIds, bool deselectMergedNodes = true)
 {
     bool selectionWillChange = false;
 
+    auto deselect = [&](NodeId nodeId)
+    {
+        if(selectedNodeIds.erase(nodeId) > 0)
+        {
+            changedNodeIds.insert(nodeId);
+            selectionWillChange = true;
+        }
+    };
+
     if(deselectMergedNodes)
     {
         for(auto nodeId : nodeIds)
@@ -147,13 +165,13 @@ template<typename C> bool _deselectNodes(const GraphModel& graphModel, NodeIdSet
             auto mergedNodeIds = graphModel.graph().mergedNodeIdsForNodeId(nodeId);
 
             for(auto mergedNodeId : mergedNodeIds)
-                selectionWillChange |= (selectedNodeIds.erase(mergedNodeId) > 0);
+                deselect(mergedNodeId);
         }
     }
     else
     {
         for(auto nodeId : nodeIds)
-            selectionWillChange |= (selectedNodeIds.erase(nodeId) > 0);
+            deselect(nodeId);
     }
 
     return selectionWillChange;
@@ -163,7 +181,7 @@ bool SelectionManager::deselectNode(NodeId nodeId)
 {
     return callFnAndMaybeEmit([this, nodeId]
     {
-        return _deselectNodes(*_graphModel, _selectedNodeIds, std::array<NodeId, 1>{{nodeId}}, true);
+        return _deselectNodes(*_graphModel, _selectedNodeIds, _changedNodeIds, std::array<NodeId, 1>{{nodeId}}, true);
     });
 }
 
@@ -171,7 +189,7 @@ bool SelectionManager::deselectNodes(const NodeIdSet& nodeIds)
 {
     return callFnAndMaybeEmit([this, &nodeIds]
     {
-        return _deselectNodes(*_graphModel, _selectedNodeIds, nodeIds, true);
+        return _deselectNodes(*_graphModel, _selectedNodeIds, _changedNodeIds, nodeIds, true);
     });
 }
 
@@ -179,11 +197,12 @@ bool SelectionManager::deselectNodes(const std::vector<NodeId>& nodeIds)
 {
     return callFnAndMaybeEmit([this, &nodeIds]
     {
-        return _deselectNodes(*_graphModel, _selectedNodeIds, nodeIds, true);
+        return _deselectNodes(*_graphModel, _selectedNodeIds, _changedNodeIds, nodeIds, true);
     });
 }
 
-template<typename C> void _toggleNodes(NodeIdSet& selectedNodeIds, NodeIdSet& mask, const C& nodeIds)
+template<typename C> void _toggleNodes(NodeIdSet& selectedNodeIds, NodeIdSet& changedNodeIds,
+    NodeIdSet& mask, const C& nodeIds)
 {
     NodeIdSet difference;
     for(auto nodeId : nodeIds)
@@ -195,6 +214,8 @@ template<typename C> void _toggleNodes(NodeIdSet& selectedNodeIds, NodeIdSet& ma
         }
     }
 
+    changedNodeIds.insert(selectedNodeIds.begin(), selectedNodeIds.end());
+    changedNodeIds.insert(difference.begin(), difference.end());
     selectedNodeIds = std::move(difference);
 }
 
@@ -234,10 +255,10 @@ bool SelectionManager::selectAllNodes()
                     deselectedNodeIds.insert(nodeId);
             }
 
-            nodesDeselected = _deselectNodes(*_graphModel, _selectedNodeIds, deselectedNodeIds, true);
+            nodesDeselected = _deselectNodes(*_graphModel, _selectedNodeIds, _changedNodeIds, deselectedNodeIds, true);
         }
 
-        return _selectNodes(*_graphModel, _selectedNodeIds, _nodeIdsMask,
+        return _selectNodes(*_graphModel, _selectedNodeIds, _changedNodeIds, _nodeIdsMask,
             _graphModel->graph().nodeIds(), true) || nodesDeselected;
     });
 }
@@ -247,6 +268,7 @@ bool SelectionManager::clearNodeSelection()
     return callFnAndMaybeEmit([this]
     {
         bool selectionWillChange = !_selectedNodeIds.empty();
+        _changedNodeIds.insert(_selectedNodeIds.begin(), _selectedNodeIds.end());
         _selectedNodeIds.clear();
         return selectionWillChange;
     });
@@ -254,10 +276,10 @@ bool SelectionManager::clearNodeSelection()
 
 void SelectionManager::invertNodeSelection()
 {
-    _toggleNodes(_selectedNodeIds, _nodeIdsMask, _graphModel->graph().nodeIds());
+    _toggleNodes(_selectedNodeIds, _changedNodeIds, _nodeIdsMask, _graphModel->graph().nodeIds());
 
     if(!signalsSuppressed())
-        emit selectionChanged(this);
+        emitSelectionChanged();
 }
 
 void SelectionManager::setNodesMask(const NodeIdSet& nodeIds, bool applyMask)
@@ -317,3 +339,9 @@ bool SelectionManager::signalsSuppressed()
     _suppressSignals = false;
     return suppressSignals;
 }
+
+void SelectionManager::emitSelectionChanged()
+{
+    emit selectionChanged(this);
+    _changedNodeIds.clear();
+}
@@ -58,6 +58,9 @@ public:
     void clearNodesMask() { _nodeIdsMask.clear(); emit nodesMaskChanged(); }
     bool nodesMaskActive() const { return !_nodeIdsMask.empty(); }
 
+    // The nodes whose selection state has changed since selectionChanged was last emitted
+    const NodeIdSet& changedNodeIds() const { return _changedNodeIds; }
+
     int numNodesSelected() const { return static_cast<int>(_selectedNodeIds.size()); }
     QString numNodesSelectedAsString() const;
 
@@ -67,6 +70,7 @@ private:
     const GraphModel* _graphModel = nullptr;
 
     NodeIdSet _selectedNodeIds;
+    NodeIdSet _changedNodeIds;
 
     // Temporary storage for NodeIds that have been deleted
     std::vector<NodeId> _deletedNodes;
@@ -76,6 +80,7 @@ private:
     bool _suppressSignals = false;
 
     bool signalsSuppressed();
+    void emitSelectionChanged();
 
     template<typename Fn>
     bool callFnAndMaybeEmit(Fn&& fn)
@@ -83,7 +88,7 @@ private:
         bool selectionWillChange = fn();
 
         if(!signalsSuppressed() && selectionWillChange)
-            emit selectionChanged(this);
+            emitSelectionChanged();
 
         return selectionWillChange;
     }
@@ -22,17 +22,18 @@
 #include "rendering/graphrenderer.h"
 
 #include "shared/utils/preferences.h"
+#include "shared/utils/stringtable.h"
 
 #include <QObject>
 
 void TextVisualisationChannel::apply(double value, ElementVisual& elementVisual) const
 {
-    elementVisual._text = QString::number(value, 'g', 3);
+    elementVisual._text = _stringTable->intern(QString::number(value, 'g', 3));
 }
 
 void TextVisualisationChannel::apply(const QString& value, ElementVisual& elementVisual) const
 {
-    elementVisual._text = value;
+    elementVisual._text = _stringTable->intern(value);
 }
 
 void TextVisualisationChannel::findErrors(ElementType elementType, VisualisationInfo& info) const
@@ -21,10 +21,17 @@
 
 #include "visualisationchannel.h"
 
+class StringTable;
+
 class TextVisualisationChannel : public VisualisationChannel
 {
+private:
+    StringTable* _stringTable;
+
 public:
-    using VisualisationChannel::VisualisationChannel;
+    explicit TextVisualisationChannel(StringTable& stringTable) :
+        _stringTable(&stringTable)
+    {}
 
     void apply(double value, ElementVisual& elementVisual) const override;
     void apply(const QString& value, ElementVisual& elementVisual) const override;
@@ -18,12 +18,13 @@
 
 #include "correlation.h"
 
-std::unique_ptr<Correlation> Correlation::create(CorrelationType correlationType)
+std::unique_ptr<Correlation> Correlation::create(CorrelationType correlationType,
+    CorrelationPrecision precision)
 {
     switch(correlationType)
     {
-    case CorrelationType::Pearson:      return std::make_unique<PearsonCorrelation>();
-    case CorrelationType::SpearmanRank: return std::make_unique<SpearmanRankCorrelation>();
+    case CorrelationType::Pearson:      return std::make_unique<PearsonCorrelation>(precision);
+    case CorrelationType::SpearmanRank: return std::make_unique<SpearmanRankCorrelation>(precision);
     default: break;
     }
 
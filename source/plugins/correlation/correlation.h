@@ -21,15 +21,21 @@
 
 #include "correlationdatarow.h"
 #include "correlationedge.h"
+#include "correlationedgestore.h"
+#include "correlationkernel.h"
+#include "scratchbuffer.h"
 
 #include "shared/utils/qmlenum.h"
 #include "shared/utils/progressable.h"
 #include "shared/utils/cancellable.h"
 #include "shared/utils/threadpool.h"
 #include "shared/utils/redirects.h"
+#include "shared/utils/scope_exit.h"
 
 #include <vector>
 #include <cmath>
+#include <limits>
+#include <numeric>
 
 #include <QObject>
 #include <QString>
@@ -48,19 +54,44 @@ DEFINE_QML_ENUM(
     Negative,
     Both);
 
+DEFINE_QML_ENUM(
+    Q_GADGET, CorrelationPrecision,
+    Double,
+    Single);
+
 class Correlation
 {
 public:
     virtual ~Correlation() = default;
 
-    virtual std::vector<CorrelationEdge> process(const std::vector<CorrelationDataRow>& rows,
-        double minimumThreshold, CorrelationPolarity polarity = CorrelationPolarity::Positive,
+    // Correlates every row against every other, storing the resultant edges in edges; any
+    // intermediate data that exceeds the memory budget of edges is kept in temporary files
+    virtual void processToStore(const std::vector<CorrelationDataRow>& rows,
+        double minimumThreshold, CorrelationPolarity polarity, CorrelationEdgeStore& edges,
         Cancellable* cancellable = nullptr, Progressable* progressable = nullptr) const = 0;
 
+    // Returns false if the edges could not be produced in full, in which case edges is empty
+    bool process(const std::vector<CorrelationDataRow>& rows,
+        double minimumThreshold, CorrelationPolarity polarity, std::vector<CorrelationEdge>& edges,
+        Cancellable* cancellable = nullptr, Progressable* progressable = nullptr) const
+    {
+        CorrelationEdgeStore edgeStore;
+        processToStore(rows, minimumThreshold, polarity, edgeStore, cancellable, progressable);
+
+        if(!edgeStore.toVector(edges))
+        {
+            edges.clear();
+            return false;
+        }
+
+        return true;
+    }
+
     virtual QString attributeName() const = 0;
     virtual QString attributeDescription() const = 0;
 
-    static std::unique_ptr<Correlation> create(CorrelationType correlationType);
+    static std::unique_ptr<Correlation> create(CorrelationType correlationType,
+        CorrelationPrecision precision = CorrelationPrecision::Double);
 };
 
 enum class RowType
@@ -69,110 +100,244 @@ enum class RowType
     Ranking
 };
 
+// Rows are transformed by Algorithm such that the dot product of any pair of them
+// is their correlation coefficient, and are then correlated against each other in
+// tiles, so that the rows being processed remain in cache
 template<typename Algorithm, RowType rowType = RowType::Raw>
 class CovarianceCorrelation : public Correlation
 {
-public:
-    std::vector<CorrelationEdge> process(const std::vector<CorrelationDataRow>& rows,
-        double minimumThreshold, CorrelationPolarity polarity = CorrelationPolarity::Positive,
-        Cancellable* cancellable = nullptr, Progressable* progressable = nullptr) const final
-    {
-        if(rows.empty())
-            return {};
+private:
+    CorrelationPrecision _precision = CorrelationPrecision::Double;
 
-        size_t numColumns = std::distance(rows.front().begin(), rows.front().end());
+    struct Tile
+    {
+        size_t _index = 0;
+        uint64_t _cost = 0;
 
-        if(progressable != nullptr)
-            progressable->setProgress(-1);
+        uint64_t computeCostHint() const { return _cost; }
+    };
 
-        uint64_t totalCost = 0;
-        for(const auto& row : rows)
+    template<typename T>
+    void processTiles(const std::vector<CorrelationDataRow>& rows,
+        double minimumThreshold, CorrelationPolarity polarity, CorrelationEdgeStore& edgeStore,
+        Cancellable* cancellable, Progressable* progressable) const
+    {
+        using namespace CorrelationKernel;
+
+        const size_t numRows = rows.size();
+        const size_t numColumns = std::distance(rows.front().begin(), rows.front().end());
+        const size_t stride = strideFor(numColumns);
+
+        ThreadPool threadPool(QStringLiteral("Correlation"));
+
+        // For very large inputs the transformed rows may be file backed, in which case
+        // the tiles that are currently being processed are paged in as required; when
+        // they're in memory, they count against the same budget as the edges
+        ScratchBuffer<T> transformedRows(numRows * stride, edgeStore.memoryAvailable());
+        const uint64_t transformedRowsBytes = transformedRows.mapped() ? 0 :
+            static_cast<uint64_t>(transformedRows.size() * sizeof(T));
+        edgeStore.charge(transformedRowsBytes);
+        auto atExit = std::experimental::make_scope_exit([&]
+            { edgeStore.discharge(transformedRowsBytes); });
+
+        threadPool.concurrent_for(rows.begin(), rows.end(),
+        [&](std::vector<CorrelationDataRow>::const_iterator rowIt)
         {
-            totalCost += row.computeCostHint();
+            const auto* row = &(*rowIt);
 
             if constexpr(rowType == RowType::Ranking)
-                row.generateRanking();
-        }
+                row = row->ranking();
 
-        std::atomic<uint64_t> cost(0);
+            auto offset = static_cast<size_t>(std::distance(rows.begin(), rowIt)) * stride;
+            Algorithm::transform(*row, &transformedRows[offset]);
+        });
+
+        // Roughly the rounding error of a dot product of rows of this length
+        const double borderline = 4.0 * std::numeric_limits<T>::epsilon() *
+            std::sqrt(static_cast<double>(numColumns));
 
-        auto results = ThreadPool(QStringLiteral("Correlation")).concurrent_for(rows.begin(), rows.end(),
-        [&](std::vector<CorrelationDataRow>::const_iterator rowAIt)
+        const size_t numTiles = (numRows + TileSize - 1) / TileSize;
+        std::vector<Tile> tiles(numTiles);
+        uint64_t totalCost = 0;
+        for(size_t i = 0; i < numTiles; i++)
         {
-            const auto* rowA = &(*rowAIt);
+            // Each tile is correlated against itself and all the tiles after it
+            tiles[i] = {i, numRows - (i * TileSize)};
+            totalCost += tiles[i]._cost;
+        }
 
-            if constexpr(rowType == RowType::Ranking)
-                rowA = rowA->ranking();
+        edgeStore.resize(numTiles);
 
-            std::vector<CorrelationEdge> edges;
+        std::atomic<uint64_t> cost(0);
 
+        threadPool.concurrent_for(tiles.begin(), tiles.end(),
+        [&](const Tile& tile)
+        {
             if(cancellable != nullptr && cancellable->cancelled())
-                return edges;
+                return;
 
-            for(auto rowBIt = rowAIt + 1; rowBIt != rows.end(); ++rowBIt)
-            {
-                const auto* rowB = &(*rowBIt);
+            const size_t firstA = tile._index * TileSize;
+            const size_t numA = std::min(TileSize, numRows - firstA);
 
-                if constexpr(rowType == RowType::Ranking)
-                    rowB = rowB->ranking();
+            // Edges are collected per row of the tile, so that
+            // they're in the same order as an untiled traversal
+            std::vector<std::vector<CorrelationEdge>> rowEdges(numA);
+            std::vector<T> tileResults(TileSize * TileSize);
 
-                double r = Algorithm::evaluate(numColumns, rowA, rowB);
+            // The tile's edges are charged to the budget as they accumulate, so that
+            // blocks completed in the meantime are spilled rather than kept in memory
+            size_t numTileEdges = 0;
+            auto chargedBytes = [&numTileEdges] { return numTileEdges * sizeof(CorrelationEdge); };
+            auto atTileExit = std::experimental::make_scope_exit([&]
+                { edgeStore.discharge(chargedBytes()); });
 
-                if(!std::isfinite(r))
-                    continue;
+            for(size_t firstB = firstA; firstB < numRows; firstB += TileSize)
+            {
+                if(cancellable != nullptr && cancellable->cancelled())
+                    return;
+
+                const size_t numB = std::min(TileSize, numRows - firstB);
 
-                bool createEdge = false;
+                dotProducts(&transformedRows[firstA * stride], numA,
+                    &transformedRows[firstB * stride], numB, stride, tileResults.data());
 
-                switch(polarity)
+                for(size_t a = 0; a < numA; a++)
                 {
-                default:
-                case CorrelationPolarity::Positive: createEdge = (r >= minimumThreshold); break;
-                case CorrelationPolarity::Negative: createEdge = (r <= -minimumThreshold); break;
-                case CorrelationPolarity::Both:     createEdge = (std::abs(r) >= minimumThreshold); break;
+                    const auto& nodeRowA = rows[firstA + a];
+
+                    // Only consider each pair once, and not rows against themselves
+                    for(size_t b = (firstA == firstB ? a + 1 : 0); b < numB; b++)
+                    {
+                        auto r = static_cast<double>(tileResults[(a * numB) + b]);
+
+                        if(!std::isfinite(r))
+                            continue;
+
+                        // The kernel sums in a different order to a straightforward evaluation,
+                        // so values within rounding of the threshold are evaluated again, in
+                        // double precision, so that they land on the same side of it as before
+                        if(std::abs(std::abs(r) - minimumThreshold) <= borderline)
+                        {
+                            const auto* rowA = &rows[firstA + a];
+                            const auto* rowB = &rows[firstB + b];
+
+                            if constexpr(rowType == RowType::Ranking)
+                            {
+                                rowA = rowA->ranking();
+                                rowB = rowB->ranking();
+                            }
+
+                            r = Algorithm::evaluate(numColumns, rowA, rowB);
+
+                            if(!std::isfinite(r))
+                                continue;
+                        }
+
+                        bool createEdge = false;
+
+                        switch(polarity)
+                        {
+                        default:
+                        case CorrelationPolarity::Positive: createEdge = (r >= minimumThreshold); break;
+                        case CorrelationPolarity::Negative: createEdge = (r <= -minimumThreshold); break;
+                        case CorrelationPolarity::Both:     createEdge = (std::abs(r) >= minimumThreshold); break;
+                        }
+
+                        if(createEdge)
+                            rowEdges[a].push_back({nodeRowA.nodeId(), rows[firstB + b].nodeId(), r});
+                    }
                 }
 
-                if(createEdge)
-                    edges.push_back({rowA->nodeId(), rowB->nodeId(), r});
+                size_t numEdges = 0;
+                for(const auto& edgesOfRow : rowEdges)
+                    numEdges += edgesOfRow.size();
+
+                edgeStore.charge((numEdges - numTileEdges) * sizeof(CorrelationEdge));
+                numTileEdges = numEdges;
+            }
+
+            std::vector<CorrelationEdge> edges;
+            edges.reserve(numTileEdges);
+            for(auto& tileRowEdges : rowEdges)
+            {
+                edges.insert(edges.end(), tileRowEdges.begin(), tileRowEdges.end());
+                std::vector<CorrelationEdge>().swap(tileRowEdges);
             }
 
-            cost += rowA->computeCostHint();
+            // setBlock charges the edges again if it keeps them in memory
+            edgeStore.discharge(chargedBytes());
+            atTileExit.release();
+            edgeStore.setBlock(tile._index, std::move(edges));
+
+            cost += tile._cost;
 
             if(progressable != nullptr)
                 progressable->setProgress(static_cast<int>((cost * 100) / totalCost));
-
-            return edges;
         });
 
         if(progressable != nullptr)
-        {
-            // Returning the results might take time
             progressable->setProgress(-1);
-        }
+    }
+
+public:
+    explicit CovarianceCorrelation(CorrelationPrecision precision = CorrelationPrecision::Double) :
+        _precision(precision)
+    {}
+
+    void processToStore(const std::vector<CorrelationDataRow>& rows,
+        double minimumThreshold, CorrelationPolarity polarity, CorrelationEdgeStore& edges,
+        Cancellable* cancellable = nullptr, Progressable* progressable = nullptr) const final
+    {
+        if(rows.empty())
+            return;
 
-        std::vector<CorrelationEdge> edges;
-        edges.reserve(std::distance(results.begin(), results.end()));
-        edges.insert(edges.end(), std::make_move_iterator(results.begin()),
-            std::make_move_iterator(results.end()));
+        if(progressable != nullptr)
+            progressable->setProgress(-1);
 
-        return edges;
+        if constexpr(rowType == RowType::Ranking)
+        {
+            for(const auto& row : rows)
+                row.generateRanking();
+        }
+
+        if(_precision == CorrelationPrecision::Single)
+            processTiles<float>(rows, minimumThreshold, polarity, edges, cancellable, progressable);
+        else
+            processTiles<double>(rows, minimumThreshold, polarity, edges, cancellable, progressable);
     }
 };
 
 struct PearsonAlgorithm
 {
+    // Directly evaluates the correlation of two rows, without transforming them
     static double evaluate(size_t numColumns, const CorrelationDataRow* rowA, const CorrelationDataRow* rowB)
     {
         double productSum = std::inner_product(rowA->begin(), rowA->end(), rowB->begin(), 0.0);
-        double numerator = (numColumns * productSum) - (rowA->sum() * rowB->sum());
+        double numerator = (static_cast<double>(numColumns) * productSum) - (rowA->sum() * rowB->sum());
         double denominator = rowA->variability() * rowB->variability();
 
         return numerator / denominator;
     }
+
+    // Centre and scale the row such that the dot product of two
+    // transformed rows is their Pearson correlation coefficient;
+    // rows with no variance become NaN, and hence never correlate
+    template<typename T>
+    static void transform(const CorrelationDataRow& row, T* out)
+    {
+        const double sumOfSquares = row.variance() * static_cast<double>(row.numColumns());
+        const double scale = 1.0 / std::sqrt(sumOfSquares);
+
+        for(auto value : row)
+            *out++ = static_cast<T>((value - row.mean()) * scale);
+    }
 };
 
 class PearsonCorrelation : public CovarianceCorrelation<PearsonAlgorithm>
 {
 public:
+    using CovarianceCorrelation::CovarianceCorrelation;
+
     QString attributeName() const override
     {
         return QObject::tr("Pearson Correlation Value");
@@ -189,6 +354,8 @@ public:
 class SpearmanRankCorrelation : public CovarianceCorrelation<PearsonAlgorithm, RowType::Ranking>
 {
 public:
+    using CovarianceCorrelation::CovarianceCorrelation;
+
     QString attributeName() const override
     {
         return QObject::tr("Spearman Rank Correlation Value");
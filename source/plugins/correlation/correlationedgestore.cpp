@@ -0,0 +1,154 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "correlationedgestore.h"
+
+#include <QDebug>
+
+#include <type_traits>
+
+static_assert(std::is_trivially_copyable_v<CorrelationEdge>,
+    "CorrelationEdge must be trivially copyable in order to be spilled to disk");
+
+void CorrelationEdgeStore::resize(size_t numBlocks)
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    _blocks.resize(numBlocks);
+}
+
+uint64_t CorrelationEdgeStore::memoryAvailable() const
+{
+    const uint64_t memoryUsed = _memoryUsed;
+    return memoryUsed < _memoryBudget ? _memoryBudget - memoryUsed : 0;
+}
+
+qint64 CorrelationEdgeStore::spill(const std::vector<CorrelationEdge>& edges)
+{
+    std::unique_lock<std::mutex> lock(_fileMutex);
+
+    if(_file == nullptr)
+    {
+        auto file = std::make_unique<QTemporaryFile>();
+
+        if(!file->open())
+        {
+            qDebug() << "CorrelationEdgeStore failed to open" << file->fileName();
+            return -1;
+        }
+
+        _file = std::move(file);
+    }
+
+    const auto numBytes = static_cast<qint64>(edges.size() * sizeof(CorrelationEdge));
+    const auto offset = _file->size();
+
+    if(!_file->seek(offset) || _file->write(reinterpret_cast<const char*>( // NOLINT
+        edges.data()), numBytes) != numBytes)
+    {
+        qDebug() << "CorrelationEdgeStore failed to write to" << _file->fileName();
+        return -1;
+    }
+
+    return offset;
+}
+
+void CorrelationEdgeStore::setBlock(size_t index, std::vector<CorrelationEdge>&& edges)
+{
+    const auto numEdges = edges.size();
+    const auto numBytes = numEdges * sizeof(CorrelationEdge);
+
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _blocks.at(index)._size = numEdges;
+        _size += numEdges;
+    }
+
+    // The edges are written out without holding the store's lock; if they
+    // can't be written, they're kept in memory regardless
+    qint64 fileOffset = -1;
+    if(numEdges > 0 && _memoryUsed + numBytes > _memoryBudget)
+        fileOffset = spill(edges);
+
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto& block = _blocks.at(index);
+
+    if(fileOffset >= 0)
+    {
+        block._fileOffset = fileOffset;
+        return;
+    }
+
+    block._edges = std::move(edges);
+    _memoryUsed += numBytes;
+}
+
+bool CorrelationEdgeStore::forEach(const std::function<bool(const CorrelationEdge&)>& fn) const
+{
+    std::unique_lock<std::mutex> lock(_mutex);
+    std::unique_lock<std::mutex> fileLock(_fileMutex);
+
+    if(_file != nullptr)
+        _file->flush();
+
+    for(const auto& block : _blocks)
+    {
+        if(block._fileOffset < 0)
+        {
+            for(const auto& edge : block._edges)
+            {
+                if(!fn(edge))
+                    return false;
+            }
+
+            continue;
+        }
+
+        const auto numBytes = static_cast<qint64>(block._size * sizeof(CorrelationEdge));
+        auto* data = _file->map(block._fileOffset, numBytes);
+
+        if(data == nullptr)
+        {
+            qDebug() << "CorrelationEdgeStore failed to map" << _file->fileName();
+            return false;
+        }
+
+        const auto* edges = reinterpret_cast<const CorrelationEdge*>(data); // NOLINT
+        bool complete = true;
+
+        for(size_t i = 0; i < block._size && complete; i++)
+            complete = fn(edges[i]);
+
+        _file->unmap(data);
+
+        if(!complete)
+            return false;
+    }
+
+    return true;
+}
+
+bool CorrelationEdgeStore::toVector(std::vector<CorrelationEdge>& edges) const
+{
+    edges.clear();
+    edges.reserve(_size);
+
+    return forEach([&edges](const auto& edge)
+    {
+        edges.push_back(edge);
+        return true;
+    });
+}
@@ -0,0 +1,92 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CORRELATIONEDGESTORE_H
+#define CORRELATIONEDGESTORE_H
+
+#include "correlationedge.h"
+
+#include <QTemporaryFile>
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <limits>
+#include <cstdint>
+
+// Collects the edges produced by a correlation, in blocks that may be completed in
+// any order; once the edges held in memory exceed the memory budget, any further
+// blocks are written to a temporary file, which is later memory mapped one block
+// at a time to read them back, in block order
+// The budget is shared with the producer of the edges, which charges it for its own
+// working memory, so that the total in use stays within it
+class CorrelationEdgeStore
+{
+private:
+    struct Block
+    {
+        std::vector<CorrelationEdge> _edges;
+        qint64 _fileOffset = -1;
+        size_t _size = 0;
+    };
+
+    uint64_t _memoryBudget = std::numeric_limits<uint64_t>::max();
+    std::atomic<uint64_t> _memoryUsed{0};
+    size_t _size = 0;
+
+    std::vector<Block> _blocks;
+    mutable std::mutex _mutex;
+
+    // Writing to the file is serialised separately, so that a block being
+    // spilled doesn't hold up blocks that are being kept in memory
+    std::unique_ptr<QTemporaryFile> _file;
+    mutable std::mutex _fileMutex;
+
+    qint64 spill(const std::vector<CorrelationEdge>& edges);
+
+public:
+    CorrelationEdgeStore() = default;
+    explicit CorrelationEdgeStore(uint64_t memoryBudget) :
+        _memoryBudget(memoryBudget)
+    {}
+
+    void resize(size_t numBlocks);
+
+    // May be called concurrently
+    void setBlock(size_t index, std::vector<CorrelationEdge>&& edges);
+
+    uint64_t memoryBudget() const { return _memoryBudget; }
+    uint64_t memoryAvailable() const;
+
+    // Account for memory that is held outside the store, but counts against its budget
+    void charge(uint64_t numBytes) { _memoryUsed += numBytes; }
+    void discharge(uint64_t numBytes) { _memoryUsed -= numBytes; }
+
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    bool spilled() const { return _file != nullptr; }
+
+    // Calls fn for each edge, in order, stopping early if it returns false
+    bool forEach(const std::function<bool(const CorrelationEdge&)>& fn) const;
+
+    // Returns false if any edges couldn't be read back, in which case edges is incomplete
+    bool toVector(std::vector<CorrelationEdge>& edges) const;
+};
+
+#endif // CORRELATIONEDGESTORE_H
@@ -0,0 +1,151 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "correlationkernel.h"
+
+#include <array>
+
+#if (defined(__GNUC__) || defined(__clang__)) && defined(__x86_64__)
+#define CORRELATION_KERNEL_DISPATCH
+#define CORRELATION_KERNEL_INLINE inline __attribute__((always_inline)) /* NOLINT cppcoreguidelines-macro-usage */
+#else
+#define CORRELATION_KERNEL_INLINE inline /* NOLINT cppcoreguidelines-macro-usage */
+#endif
+
+namespace
+{
+// The number of rows of a that are multiplied against each row of b at once
+constexpr size_t BlockSize = 4;
+
+// The accumulators are split into independent lanes, such that the compiler can
+// vectorise the inner loop without reordering any floating point operations
+template<typename T> constexpr size_t NumLanes = CorrelationKernel::RowAlignment;
+
+template<typename T>
+CORRELATION_KERNEL_INLINE T sumOf(const std::array<T, NumLanes<T>>& lanes)
+{
+    T sum = 0;
+    for(auto lane : lanes)
+        sum += lane;
+
+    return sum;
+}
+
+template<typename T>
+CORRELATION_KERNEL_INLINE void dotProductsImpl(const T* a, size_t numA, const T* b, size_t numB,
+    size_t stride, T* out)
+{
+    constexpr size_t L = NumLanes<T>;
+
+    size_t i = 0;
+    for(; i + BlockSize <= numA; i += BlockSize)
+    {
+        const T* a0 = a + ((i + 0) * stride);
+        const T* a1 = a + ((i + 1) * stride);
+        const T* a2 = a + ((i + 2) * stride);
+        const T* a3 = a + ((i + 3) * stride);
+
+        for(size_t j = 0; j < numB; j++)
+        {
+            const T* bj = b + (j * stride);
+
+            std::array<T, L> s0{}, s1{}, s2{}, s3{};
+
+            for(size_t k = 0; k < stride; k += L)
+            {
+                for(size_t l = 0; l < L; l++)
+                {
+                    const T bv = bj[k + l];
+                    s0[l] += a0[k + l] * bv;
+                    s1[l] += a1[k + l] * bv;
+                    s2[l] += a2[k + l] * bv;
+                    s3[l] += a3[k + l] * bv;
+                }
+            }
+
+            out[((i + 0) * numB) + j] = sumOf<T>(s0);
+            out[((i + 1) * numB) + j] = sumOf<T>(s1);
+            out[((i + 2) * numB) + j] = sumOf<T>(s2);
+            out[((i + 3) * numB) + j] = sumOf<T>(s3);
+        }
+    }
+
+    for(; i < numA; i++)
+    {
+        const T* ai = a + (i * stride);
+
+        for(size_t j = 0; j < numB; j++)
+        {
+            const T* bj = b + (j * stride);
+
+            std::array<T, L> s{};
+
+            for(size_t k = 0; k < stride; k += L)
+            {
+                for(size_t l = 0; l < L; l++)
+                    s[l] += ai[k + l] * bj[k + l];
+            }
+
+            out[(i * numB) + j] = sumOf<T>(s);
+        }
+    }
+}
+
+#ifdef CORRELATION_KERNEL_DISPATCH
+template<typename T>
+__attribute__((target("avx512f")))
+void dotProductsAVX512(const T* a, size_t numA, const T* b, size_t numB, size_t stride, T* out)
+{
+    dotProductsImpl(a, numA, b, numB, stride, out);
+}
+
+template<typename T>
+__attribute__((target("avx2,fma")))
+void dotProductsAVX2(const T* a, size_t numA, const T* b, size_t numB, size_t stride, T* out)
+{
+    dotProductsImpl(a, numA, b, numB, stride, out);
+}
+#endif
+
+template<typename T>
+void dotProductsDispatch(const T* a, size_t numA, const T* b, size_t numB, size_t stride, T* out)
+{
+#ifdef CORRELATION_KERNEL_DISPATCH
+    static const bool hasAVX512 = __builtin_cpu_supports("avx512f");
+    static const bool hasAVX2 = __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+
+    if(hasAVX512)
+        dotProductsAVX512(a, numA, b, numB, stride, out);
+    else if(hasAVX2)
+        dotProductsAVX2(a, numA, b, numB, stride, out);
+    else
+#endif
+        dotProductsImpl(a, numA, b, numB, stride, out);
+}
+} // namespace
+
+void CorrelationKernel::dotProducts(const double* a, size_t numA, const double* b, size_t numB,
+    size_t stride, double* out)
+{
+    dotProductsDispatch(a, numA, b, numB, stride, out);
+}
+
+void CorrelationKernel::dotProducts(const float* a, size_t numA, const float* b, size_t numB,
+    size_t stride, float* out)
+{
+    dotProductsDispatch(a, numA, b, numB, stride, out);
+}
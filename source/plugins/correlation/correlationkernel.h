@@ -0,0 +1,45 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef CORRELATIONKERNEL_H
+#define CORRELATIONKERNEL_H
+
+#include <vector>
+#include <cstddef>
+
+namespace CorrelationKernel
+{
+// The number of rows in each of the tiles that are correlated against each other
+constexpr size_t TileSize = 64;
+
+// Rows are padded to a multiple of this, so that the kernel needs no remainder loop
+constexpr size_t RowAlignment = 16;
+
+inline size_t strideFor(size_t numColumns)
+{
+    return ((numColumns + RowAlignment - 1) / RowAlignment) * RowAlignment;
+}
+
+// For each of the numA rows in a and numB rows in b, stride elements apart,
+// computes the dot product of a[i] and b[j] and stores it in out[(i * numB) + j]
+void dotProducts(const double* a, size_t numA, const double* b, size_t numB,
+    size_t stride, double* out);
+void dotProducts(const float* a, size_t numA, const float* b, size_t numB,
+    size_t stride, float* out);
+} // namespace CorrelationKernel
+
+#endif // CORRELATIONKERNEL_H
@@ -33,7 +33,7 @@
 
 #include "shared/attributes/iattribute.h"
 
-#include "shared/ui/visualisations/ielementvisual.h"
+#include "shared/ui/visualisations/elementvisual.h"
 
 #include "shared/loading/xlsxtabulardataparser.h"
 
@@ -93,7 +93,8 @@ bool CorrelationPluginInstance::loadUserData(const TabularData& tabularData,
             uint64_t dataPoint = columnIndex + rowOffset;
             parser.setProgress(static_cast<int>((dataPoint * 100) / numDataPoints));
 
-            const auto& value = tabularData.valueAt(columnIndex, rowIndex);
+            // Only the names and attributes are needed as text; the data is read directly
+            auto value = [&] { return tabularData.valueAt(columnIndex, rowIndex); };
 
             size_t dataColumnIndex = columnIndex - dataRect.x();
             size_t dataRowIndex = rowIndex - dataRect.y();
@@ -116,25 +117,25 @@ bool CorrelationPluginInstance::loadUserData(const TabularData& tabularData,
             if(rowIndex == 0)
             {
                 if(isColumnInDataRect)
-                    setDataColumnName(dataColumnIndex, value);
+                    setDataColumnName(dataColumnIndex, value());
                 else if(isRowAttribute)
-                    _userNodeData.add(value);
+                    _userNodeData.add(value());
             }
             else if(isColumnAnnotation)
             {
                 if(columnIndex == 0)
-                    _userColumnData.add(value);
+                    _userColumnData.add(value());
                 else if(isColumnInDataRect)
-                    _userColumnData.setValue(dataColumnIndex, tabularData.valueAt(0, rowIndex), value);
+                    _userColumnData.setValue(dataColumnIndex, tabularData.valueAt(0, rowIndex), value());
             }
             else if(isColumnInDataRect)
             {
                 double transformedValue = 0.0;
 
-                if(!value.isEmpty())
+                if(!tabularData.valueIsEmpty(columnIndex, rowIndex))
                 {
                     bool success = false;
-                    transformedValue = value.toDouble(&success);
+                    transformedValue = tabularData.numericValueAt(columnIndex, rowIndex, &success);
                     Q_ASSERT(success);
                 }
                 else
@@ -148,7 +149,7 @@ bool CorrelationPluginInstance::loadUserData(const TabularData& tabularData,
                 setData(dataColumnIndex, dataRowIndex, transformedValue);
             }
             else if(isRowAttribute)
-                _userNodeData.setValue(dataRowIndex, tabularData.valueAt(columnIndex, 0), value);
+                _userNodeData.setValue(dataRowIndex, tabularData.valueAt(columnIndex, 0), value());
         }
     }
 
@@ -250,7 +251,8 @@ void CorrelationPluginInstance::createAttributes()
             "with the node. It is defined as the standard deviation divided by the mean.")
             .arg(u::redirectLink("coef_variation", tr("Coefficient of Variation"))));
 
-    auto correlation = Correlation::create(static_cast<CorrelationType>(_correlationType));
+    auto correlation = Correlation::create(static_cast<CorrelationType>(_correlationType),
+        _correlationPrecision);
     _correlationAttributeName = correlation->attributeName();
 
     graphModel()->createAttribute(_correlationAttributeName)
@@ -312,30 +314,36 @@ QStringList CorrelationPluginInstance::sharedValuesAttributeNames() const
     return attributeNames;
 }
 
-std::vector<CorrelationEdge> CorrelationPluginInstance::correlation(double minimumThreshold, IParser& parser)
+bool CorrelationPluginInstance::correlation(double minimumThreshold,
+    CorrelationEdgeStore& edges, IParser& parser)
 {
-    auto correlation = Correlation::create(static_cast<CorrelationType>(_correlationType));
-    return correlation->process(_dataRows, minimumThreshold,
-        static_cast<CorrelationPolarity>(_correlationPolarity), &parser, &parser);
+    auto correlation = Correlation::create(static_cast<CorrelationType>(_correlationType),
+        _correlationPrecision);
+    correlation->processToStore(_dataRows, minimumThreshold,
+        static_cast<CorrelationPolarity>(_correlationPolarity), edges, &parser, &parser);
+
+    return !parser.cancelled();
 }
 
-bool CorrelationPluginInstance::createEdges(const std::vector<CorrelationEdge>& edges, IParser& parser)
+bool CorrelationPluginInstance::createEdges(const CorrelationEdgeStore& edges, IParser& parser)
 {
     parser.setProgress(-1);
-    for(auto edgeIt = edges.begin(); edgeIt != edges.end(); ++edgeIt)
+
+    uint64_t numEdgesCreated = 0;
+    const auto numEdges = static_cast<uint64_t>(edges.size());
+
+    return edges.forEach([&](const CorrelationEdge& edge)
     {
         if(parser.cancelled())
             return false;
 
-        parser.setProgress(static_cast<int>(std::distance(edges.begin(), edgeIt)) * 100 /
-            static_cast<int>(edges.size()));
+        parser.setProgress(static_cast<int>((numEdgesCreated++ * 100) / numEdges));
 
-        const auto& edge = *edgeIt;
         auto edgeId = graphModel()->mutableGraph().addEdge(edge._source, edge._target);
         _correlationValues->set(edgeId, edge._r);
-    }
 
-    return true;
+        return true;
+    });
 }
 
 void CorrelationPluginInstance::setDimensions(size_t numColumns, size_t numRows)
@@ -493,6 +501,8 @@ void CorrelationPluginInstance::applyParameter(const QString& name, const QVaria
         _correlationType = static_cast<CorrelationType>(value.toInt());
     else if(name == QLatin1String("correlationPolarity"))
         _correlationPolarity = static_cast<CorrelationPolarity>(value.toInt());
+    else if(name == QLatin1String("correlationPrecision"))
+        _correlationPrecision = static_cast<CorrelationPrecision>(value.toInt());
     else if(name == QLatin1String("scaling"))
         _scalingType = static_cast<ScalingType>(value.toInt());
     else if(name == QLatin1String("normalise"))
@@ -654,6 +664,7 @@ QByteArray CorrelationPluginInstance::save(IMutableGraph& graph, Progressable& p
     jsonObject["transpose"] = _transpose;
     jsonObject["correlationType"] = static_cast<int>(_correlationType);
     jsonObject["correlationPolarity"] = static_cast<int>(_correlationPolarity);
+    jsonObject["correlationPrecision"] = static_cast<int>(_correlationPrecision);
     jsonObject["scaling"] = static_cast<int>(_scalingType);
     jsonObject["normalisation"] = static_cast<int>(_normaliseType);
     jsonObject["missingDataType"] = static_cast<int>(_missingDataType);
@@ -785,6 +796,10 @@ bool CorrelationPluginInstance::load(const QByteArray& data, int dataVersion, IM
         _correlationPolarity = static_cast<CorrelationPolarity>(jsonObject["correlationPolarity"]);
     }
 
+    // Files saved before the precision was selectable were all calculated in double precision
+    if(u::contains(jsonObject, "correlationPrecision"))
+        _correlationPrecision = static_cast<CorrelationPrecision>(jsonObject["correlationPrecision"]);
+
     createAttributes();
     makeDataColumnNamesUnique();
     setNodeAttributeTableModelDataColumns();
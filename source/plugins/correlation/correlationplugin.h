@@ -31,6 +31,7 @@
 
 #include "columnannotation.h"
 #include "correlationedge.h"
+#include "correlationedgestore.h"
 #include "correlationdatarow.h"
 #include "correlationnodeattributetablemodel.h"
 
@@ -90,6 +91,7 @@ private:
     QRect _dataRect;
     CorrelationType _correlationType = CorrelationType::Pearson;
     CorrelationPolarity _correlationPolarity = CorrelationPolarity::Positive;
+    CorrelationPrecision _correlationPrecision = CorrelationPrecision::Double;
     ScalingType _scalingType = ScalingType::None;
     NormaliseType _normaliseType = NormaliseType::None;
     MissingDataType _missingDataType = MissingDataType::Constant;
@@ -134,12 +136,12 @@ public:
     void finishDataRows();
     void createAttributes();
 
-    std::vector<CorrelationEdge> correlation(double minimumThreshold, IParser& parser);
+    bool correlation(double minimumThreshold, CorrelationEdgeStore& edges, IParser& parser);
 
     double minimumCorrelation() const { return _minimumCorrelationValue; }
     bool transpose() const { return _transpose; }
 
-    bool createEdges(const std::vector<CorrelationEdge>& edges, IParser& parser);
+    bool createEdges(const CorrelationEdgeStore& edges, IParser& parser);
 
     std::unique_ptr<IParser> parserForUrlTypeName(const QString& urlTypeName) override;
     void applyParameter(const QString& name, const QVariant& value) override;
@@ -30,12 +30,14 @@
 
 #include "shared/utils/container.h"
 #include "shared/utils/container_randomsample.h"
+#include "shared/utils/preferences.h"
 
 #include <QRect>
 
 #include <vector>
 #include <stack>
 #include <utility>
+#include <limits>
 
 CorrelationFileParser::CorrelationFileParser(CorrelationPluginInstance* plugin, QString urlTypeName,
                                              TabularData& tabularData, QRect dataRect) :
@@ -51,8 +53,7 @@ static QRect findLargestDataRect(const TabularData& tabularData, size_t startCol
     {
         for(size_t row = tabularData.numRows(); row-- > startRow; )
         {
-            const auto& value = tabularData.valueAt(column, row);
-            if(u::isNumeric(value) || value.isEmpty())
+            if(tabularData.valueIsNumeric(column, row) || tabularData.valueIsEmpty(column, row))
                 heightHistogram.at(column)++;
             else
                 break;
@@ -125,10 +126,7 @@ static bool dataRectHasMissingValues(const TabularData& tabularData, const QRect
     {
         for(auto row = dataRect.top(); row <= dataRect.bottom(); row++)
         {
-            const auto& value = tabularData.valueAt(
-                static_cast<size_t>(column), static_cast<size_t>(row));
-
-            if(value.isEmpty())
+            if(tabularData.valueIsEmpty(static_cast<size_t>(column), static_cast<size_t>(row)))
                 return true;
         }
     }
@@ -159,10 +157,9 @@ double CorrelationFileParser::imputeValue(MissingDataType missingDataType,
         size_t rowCount = 0;
         for(size_t avgRowIndex = left; avgRowIndex < right; avgRowIndex++)
         {
-            const auto& value = tabularData.valueAt(columnIndex, avgRowIndex);
-            if(!value.isEmpty())
+            if(!tabularData.valueIsEmpty(columnIndex, avgRowIndex))
             {
-                averageValue += value.toDouble();
+                averageValue += tabularData.numericValueAt(columnIndex, avgRowIndex);
                 rowCount++;
             }
         }
@@ -185,10 +182,9 @@ double CorrelationFileParser::imputeValue(MissingDataType missingDataType,
         // Find right value
         for(size_t rightColumn = columnIndex; rightColumn < right; rightColumn++)
         {
-            const auto& value = tabularData.valueAt(rightColumn, rowIndex);
-            if(!value.isEmpty())
+            if(!tabularData.valueIsEmpty(rightColumn, rowIndex))
             {
-                rightValue = value.toDouble();
+                rightValue = tabularData.numericValueAt(rightColumn, rowIndex);
                 rightValueFound = true;
                 rightDistance = (rightColumn > columnIndex) ? rightColumn - columnIndex : columnIndex - rightColumn;
                 break;
@@ -197,10 +193,9 @@ double CorrelationFileParser::imputeValue(MissingDataType missingDataType,
         // Find left value
         for(size_t leftColumn = columnIndex; leftColumn-- != left;)
         {
-            const auto& value = tabularData.valueAt(leftColumn, rowIndex);
-            if(!value.isEmpty())
+            if(!tabularData.valueIsEmpty(leftColumn, rowIndex))
             {
-                leftValue = value.toDouble();
+                leftValue = tabularData.numericValueAt(leftColumn, rowIndex);
                 leftValueFound = true;
                 leftDistance = (leftColumn > columnIndex) ? leftColumn - columnIndex : columnIndex - leftColumn;
                 break;
@@ -345,16 +340,26 @@ bool CorrelationFileParser::parse(const QUrl&, IGraphModel* graphModel)
     setProgress(-1);
 
     graphModel->mutableGraph().setPhase(QObject::tr("Correlation"));
-    auto edges = _plugin->correlation(_plugin->minimumCorrelation(), *this);
 
-    if(cancelled())
+    // Beyond the memory budget, intermediate data and edges are kept on disk
+    auto memoryBudget = static_cast<uint64_t>(
+        u::pref(QStringLiteral("misc/correlationMemoryBudget")).toULongLong()) * 1024 * 1024;
+    CorrelationEdgeStore edges(memoryBudget > 0 ? memoryBudget :
+        std::numeric_limits<uint64_t>::max());
+
+    if(!_plugin->correlation(_plugin->minimumCorrelation(), edges, *this) || cancelled())
         return false;
 
     _plugin->createAttributes();
 
     graphModel->mutableGraph().setPhase(QObject::tr("Building Graph"));
     if(!_plugin->createEdges(edges, *this))
+    {
+        if(!cancelled())
+            setFailureReason(QObject::tr("Failed to read back the correlation edges from temporary storage."));
+
         return false;
+    }
 
     graphModel->mutableGraph().clearPhase();
 
@@ -540,18 +545,17 @@ std::vector<CorrelationDataRow> TabularDataParser::sampledDataRows(size_t numSam
             if(_graphSizeEstimateCancellable.cancelled())
                 return {};
 
-            const auto& value = _dataPtr->valueAt(columnIndex, rowIndex);
             double transformedValue = 0.0;
 
-            if(!value.isEmpty())
+            if(!_dataPtr->valueIsEmpty(columnIndex, rowIndex))
             {
                 bool success = false;
-                transformedValue = value.toDouble(&success);
+                transformedValue = _dataPtr->numericValueAt(columnIndex, rowIndex, &success);
 
                 if(!success)
                 {
                     qDebug() << QStringLiteral("WARNING: non-numeric value at (%1, %2): %3")
-                        .arg(columnIndex).arg(rowIndex).arg(value);
+                        .arg(columnIndex).arg(rowIndex).arg(_dataPtr->valueAt(columnIndex, rowIndex));
                 }
             }
             else
@@ -606,9 +610,15 @@ void TabularDataParser::estimateGraphSize()
         if(dataRows.empty())
             return QVariantMap();
 
-        auto correlation = Correlation::create(static_cast<CorrelationType>(_correlationType));
-        auto sampleEdges = correlation->process(dataRows, _minimumCorrelation,
-            static_cast<CorrelationPolarity>(_correlationPolarity), &_graphSizeEstimateCancellable);
+        auto correlation = Correlation::create(static_cast<CorrelationType>(_correlationType),
+            static_cast<CorrelationPrecision>(_correlationPrecision));
+        std::vector<CorrelationEdge> sampleEdges;
+        if(!correlation->process(dataRows, _minimumCorrelation,
+            static_cast<CorrelationPolarity>(_correlationPolarity), sampleEdges, &_graphSizeEstimateCancellable))
+        {
+            qDebug() << "Failed to read back sampled correlation edges; not estimating graph size";
+            return QVariantMap();
+        }
 
         if(sampleEdges.empty())
             return QVariantMap();
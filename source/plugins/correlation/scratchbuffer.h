@@ -0,0 +1,80 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef SCRATCHBUFFER_H
+#define SCRATCHBUFFER_H
+
+#include <QTemporaryFile>
+
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <type_traits>
+
+// A fixed size buffer that lives in memory when it fits within memoryBudget bytes,
+// and otherwise in a memory mapped temporary file, leaving the OS to page it in and
+// out as required; if the file can't be created, it falls back to memory anyway
+template<typename T>
+class ScratchBuffer
+{
+    static_assert(std::is_trivially_copyable_v<T>, "ScratchBuffer type must be trivially copyable");
+
+private:
+    std::vector<T> _memory;
+    std::unique_ptr<QTemporaryFile> _file;
+    T* _data = nullptr;
+    size_t _size = 0;
+
+public:
+    ScratchBuffer(size_t size, uint64_t memoryBudget) :
+        _size(size)
+    {
+        const auto numBytes = static_cast<qint64>(size * sizeof(T));
+
+        if(static_cast<uint64_t>(numBytes) > memoryBudget)
+        {
+            _file = std::make_unique<QTemporaryFile>();
+
+            // Newly resized space in the file reads as zeroes, as does the vector below
+            if(_file->open() && _file->resize(numBytes))
+                _data = reinterpret_cast<T*>(_file->map(0, numBytes)); // NOLINT
+
+            if(_data == nullptr)
+                _file.reset();
+        }
+
+        if(_data == nullptr)
+        {
+            _memory.resize(size);
+            _data = _memory.data();
+        }
+    }
+
+    ScratchBuffer(const ScratchBuffer&) = delete;
+    ScratchBuffer& operator=(const ScratchBuffer&) = delete;
+
+    bool mapped() const { return _file != nullptr; }
+    size_t size() const { return _size; }
+
+    T* data() { return _data; }
+    const T* data() const { return _data; }
+
+    T& operator[](size_t index) { return _data[index]; }
+    const T& operator[](size_t index) const { return _data[index]; }
+};
+
+#endif // SCRATCHBUFFER_H
@@ -55,6 +55,7 @@ BaseParameterDialog
         minimumCorrelation: minimumCorrelationSpinBox.value
         correlationType: { return algorithm.model.get(algorithm.currentIndex).value; }
         correlationPolarity: { return polarity.model.get(polarity.currentIndex).value; }
+        correlationPrecision: { return precision.model.get(precision.currentIndex).value; }
         scalingType: { return scaling.model.get(scaling.currentIndex).value; }
         normaliseType: { return normalise.model.get(normalise.currentIndex).value; }
         missingDataType: { return missingDataType.model.get(missingDataType.currentIndex).value; }
@@ -644,6 +645,40 @@ BaseParameterDialog
                                            "account of the magnitude of the correlation.")
                             }
                         }
+
+                        Text { text: qsTr("Precision:") }
+
+                        ComboBox
+                        {
+                            id: precision
+
+                            model: ListModel
+                            {
+                                ListElement { text: qsTr("Double");   value: CorrelationPrecision.Double }
+                                ListElement { text: qsTr("Single");   value: CorrelationPrecision.Single }
+                            }
+                            textRole: "text"
+
+                            onCurrentIndexChanged:
+                            {
+                                parameters.correlationPrecision = model.get(currentIndex).value;
+                            }
+
+                            property int value: { return model.get(currentIndex).value; }
+                        }
+
+                        HelpTooltip
+                        {
+                            title: qsTr("Precision")
+                            Text
+                            {
+                                wrapMode: Text.WordWrap
+                                text: qsTr("Correlation values are calculated in double precision " +
+                                           "by default. Single precision is faster and uses less " +
+                                           "memory, but values very close to the " +
+                                           "minimum threshold may fall on the other side of it.")
+                            }
+                        }
                     }
 
                     RowLayout
@@ -1401,6 +1436,7 @@ BaseParameterDialog
 
                         summaryString += qsTr("Correlation Metric: ") + algorithm.currentText + "<br>";
                         summaryString += qsTr("Correlation Polarity: ") + polarity.currentText + "<br>";
+                        summaryString += qsTr("Correlation Precision: ") + precision.currentText + "<br>";
                         summaryString += qsTr("Minimum Correlation Value: ") + minimumCorrelationSpinBox.value + "<br>";
                         summaryString += qsTr("Initial Correlation Threshold: ") + initialCorrelationSpinBox.value + "<br>";
 
@@ -1511,6 +1547,7 @@ BaseParameterDialog
             initialThreshold: DEFAULT_INITIAL_CORRELATION, transpose: false,
             correlationType: CorrelationType.Pearson,
             correlationPolarity: CorrelationPolarity.Positive,
+            correlationPrecision: CorrelationPrecision.Double,
             scaling: ScalingType.None, normalise: NormaliseType.None,
             missingDataType: MissingDataType.Constant };
 
@@ -28,7 +28,7 @@
 class IGraph;
 class IMutableGraph;
 class IAttribute;
-struct IElementVisual;
+struct ElementVisual;
 
 class IGraphModel
 {
@@ -40,16 +40,16 @@ protected:
     virtual const IMutableGraph& mutableGraphImpl() const = 0;
     virtual const IGraph& graphImpl() const = 0;
 
-    virtual const IElementVisual& nodeVisualImpl(NodeId nodeId) const = 0;
-    virtual const IElementVisual& edgeVisualImpl(EdgeId edgeId) const = 0;
+    virtual const ElementVisual& nodeVisualImpl(NodeId nodeId) const = 0;
+    virtual const ElementVisual& edgeVisualImpl(EdgeId edgeId) const = 0;
 
 public:
     IMutableGraph& mutableGraph() { return mutableGraphImpl(); }
     const IMutableGraph& mutableGraph() const { return mutableGraphImpl(); }
     const IGraph& graph() const { return graphImpl(); }
 
-    const IElementVisual& nodeVisual(NodeId nodeId) const { return nodeVisualImpl(nodeId); }
-    const IElementVisual& edgeVisual(EdgeId edgeId) const { return edgeVisualImpl(edgeId); }
+    const ElementVisual& nodeVisual(NodeId nodeId) const { return nodeVisualImpl(nodeId); }
+    const ElementVisual& edgeVisual(EdgeId edgeId) const { return edgeVisualImpl(edgeId); }
 
     virtual QString nodeName(NodeId nodeId) const = 0;
     virtual void setNodeName(NodeId nodeId, const QString& name) = 0;
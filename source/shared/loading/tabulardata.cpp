@@ -18,12 +18,212 @@
 
 #include "tabulardata.h"
 
-TabularData::TabularData(TabularData&& other) noexcept :
-    _data(std::move(other._data)),
-    _columns(other._columns),
-    _rows(other._rows),
-    _transposed(other._transposed)
+#include <QByteArray>
+#include <QLocale>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+const double EmptyValue = std::numeric_limits<double>::quiet_NaN();
+
+bool formatAsInteger(double value)
+{
+    // Integral values are formatted as such, rather than in scientific notation
+    return value == std::trunc(value) && std::abs(value) < 1e15;
+}
+
+#ifdef __cpp_lib_to_chars
+using NumberBuffer = std::array<char, 32>;
+
+std::string_view formatNumber(double value, NumberBuffer& buffer)
+{
+    auto* first = buffer.data();
+    auto* last = first + buffer.size();
+
+    auto [ptr, ec] = formatAsInteger(value) ?
+        std::to_chars(first, last, static_cast<int64_t>(value)) :
+        std::to_chars(first, last, value);
+
+    Q_ASSERT(ec == std::errc());
+    return {first, static_cast<size_t>(ptr - first)};
+}
+#endif
+
+QString numberToString(double value)
+{
+#ifdef __cpp_lib_to_chars
+    NumberBuffer buffer;
+    auto text = formatNumber(value, buffer);
+    return QString::fromLatin1(text.data(), static_cast<int>(text.size()));
+#else
+    if(formatAsInteger(value))
+        return QString::number(static_cast<qint64>(value));
+
+    return QString::number(value, 'g', QLocale::FloatingPointShortest);
+#endif
+}
+
+// Whether the text a number was parsed from is exactly what numberToString
+// gives for that number, in which case the text needn't be kept
+bool textIsCanonical(std::string_view text, double value)
+{
+#ifdef __cpp_lib_to_chars
+    NumberBuffer buffer;
+    return formatNumber(value, buffer) == text;
+#else
+    return numberToString(value) == QLatin1String(text.data(), static_cast<int>(text.size()));
+#endif
+}
+
+// The UTF-8 encodings of the non-ASCII characters that QChar::isSpace is true for
+constexpr std::array<std::string_view, 19> UnicodeSpaces =
+{{
+    "\xC2\x85", "\xC2\xA0", "\xE1\x9A\x80",
+    "\xE2\x80\x80", "\xE2\x80\x81", "\xE2\x80\x82", "\xE2\x80\x83", "\xE2\x80\x84",
+    "\xE2\x80\x85", "\xE2\x80\x86", "\xE2\x80\x87", "\xE2\x80\x88", "\xE2\x80\x89",
+    "\xE2\x80\x8A", "\xE2\x80\xA8", "\xE2\x80\xA9", "\xE2\x80\xAF", "\xE2\x81\x9F",
+    "\xE3\x80\x80"
+}};
+
+// Returns the length of the whitespace character value starts or ends with, or 0 if there isn't one
+size_t whitespaceLength(std::string_view value, bool atEnd)
+{
+    if(value.empty())
+        return 0;
+
+    auto c = atEnd ? value.back() : value.front();
+    if(c == ' ' || (c >= '\t' && c <= '\r'))
+        return 1;
+
+    for(auto space : UnicodeSpaces)
+    {
+        if(value.size() >= space.size() &&
+            value.compare(atEnd ? value.size() - space.size() : 0, space.size(), space) == 0)
+        {
+            return space.size();
+        }
+    }
+
+    return 0;
+}
+
+// Equivalent to QString::trimmed, but for UTF-8
+std::string_view trimmed(std::string_view value)
+{
+    while(auto length = whitespaceLength(value, false))
+        value.remove_prefix(length);
+
+    while(auto length = whitespaceLength(value, true))
+        value.remove_suffix(length);
+
+    return value;
+}
+
+// Returns true if value is a number that can be stored as such without losing anything
+// significant, such as the leading zeros in an identifier like 007
+bool parseNumber(std::string_view value, double& number)
+{
+    size_t i = value.front() == '-' ? 1 : 0;
+
+    if(value.front() == '+' || (i + 1 < value.size() && value[i] == '0' && value[i + 1] != '.'))
+        return false;
+
+#ifdef __cpp_lib_to_chars
+    // Locale independent, and doesn't allocate
+    const auto* end = value.data() + value.size();
+    auto [ptr, ec] = std::from_chars(value.data(), end, number);
+    bool success = ec == std::errc() && ptr == end;
+#else
+    bool success = false;
+    number = QByteArray::fromRawData(value.data(), static_cast<int>(value.size())).toDouble(&success);
+#endif
+
+    return success && std::isfinite(number);
+}
+
+template<typename RowStrings>
+auto findRow(RowStrings& rowStrings, size_t row)
+{
+    return std::lower_bound(rowStrings.begin(), rowStrings.end(), row,
+        [](const auto& rowString, size_t r) { return rowString.first < r; });
+}
+
+// The string index at row, or 0 if there isn't one
+template<typename RowStrings>
+int stringIndexAt(const RowStrings& rowStrings, size_t row)
+{
+    auto it = findRow(rowStrings, row);
+    return it != rowStrings.end() && it->first == row ? it->second : 0;
+}
+
+// Setting a string index of 0 removes the row
+template<typename RowStrings>
+void setStringIndexAt(RowStrings& rowStrings, size_t row, int stringIndex)
+{
+    auto it = findRow(rowStrings, row);
+
+    if(it != rowStrings.end() && it->first == row)
+    {
+        if(stringIndex != 0)
+            it->second = stringIndex;
+        else
+            rowStrings.erase(it);
+    }
+    else if(stringIndex != 0)
+        rowStrings.insert(it, {row, stringIndex});
+}
+} // namespace
+
+void TabularData::Column::reserve(size_t size)
+{
+    if(_numeric)
+        _numbers.reserve(size);
+    else
+        _stringIndices.reserve(size);
+}
+
+void TabularData::Column::resize(size_t size)
+{
+    if(_numeric)
+    {
+        _numbers.resize(size, EmptyValue);
+
+        while(!_textCells.empty() && _textCells.back().first >= size)
+            _textCells.pop_back();
+
+        while(!_sourceTexts.empty() && _sourceTexts.back().first >= size)
+            _sourceTexts.pop_back();
+    }
+    else
+        _stringIndices.resize(size, 0);
+}
+
+void TabularData::Column::shrinkToFit()
+{
+    _numbers.shrink_to_fit();
+    _textCells.shrink_to_fit();
+    _sourceTexts.shrink_to_fit();
+    _stringIndices.shrink_to_fit();
+}
+
+TabularData::TabularData()
+{
+    reset();
+}
 
+TabularData::TabularData(TabularData&& other) noexcept :
+    _columns(std::move(other._columns)),
+    _strings(std::move(other._strings)),
+    _stringIndices(std::move(other._stringIndices)),
+    _numColumns(other._numColumns),
+    _numRows(other._numRows),
+    _transposed(other._transposed),
+    _reservedRows(other._reservedRows)
 {
     other.reset();
 }
@@ -32,10 +232,13 @@ TabularData& TabularData::operator=(TabularData&& other) noexcept
 {
     if(this != &other)
     {
-        _data = std::move(other._data);
-        _columns = other._columns;
-        _rows = other._rows;
+        _columns = std::move(other._columns);
+        _strings = std::move(other._strings);
+        _stringIndices = std::move(other._stringIndices);
+        _numColumns = other._numColumns;
+        _numRows = other._numRows;
         _transposed = other._transposed;
+        _reservedRows = other._reservedRows;
 
         other.reset();
     }
@@ -45,65 +248,101 @@ TabularData& TabularData::operator=(TabularData&& other) noexcept
 
 void TabularData::reserve(size_t columns, size_t rows)
 {
-    _data.reserve(columns * rows);
+    _columns.reserve(columns);
+    _reservedRows = std::max(_reservedRows, rows);
+
+    for(auto& column : _columns)
+        column.reserve(_reservedRows);
 }
 
 bool TabularData::empty() const
 {
-    return _data.empty();
+    return _numColumns == 0 || _numRows == 0;
 }
 
-size_t TabularData::index(size_t column, size_t row) const
+std::pair<size_t, size_t> TabularData::storageIndex(size_t column, size_t row) const
 {
     Q_ASSERT(column < numColumns());
     Q_ASSERT(row < numRows());
 
-    auto index = !_transposed ?
-        column + (row * _columns) :
-        row + (column * _columns);
-
-    return index;
+    return !_transposed ?
+        std::make_pair(column, row) :
+        std::make_pair(row, column);
 }
 
 size_t TabularData::numColumns() const
 {
-    return !_transposed ? _columns : _rows;
+    return !_transposed ? _numColumns : _numRows;
 }
 
 size_t TabularData::numRows() const
 {
-    return !_transposed ? _rows : _columns;
+    return !_transposed ? _numRows : _numColumns;
 }
 
-void TabularData::setValueAt(size_t column, size_t row, QString&& value, int progressHint)
+int TabularData::indexOfString(const QString& value)
 {
-    size_t columns = column >= _columns ? column + 1 : _columns;
-    size_t rows = row >= _rows ? row + 1 : _rows;
-    auto newSize = columns * rows;
+    auto it = _stringIndices.find(value);
+    if(it != _stringIndices.end())
+        return it.value();
+
+    auto index = static_cast<int>(_strings.size());
+    _strings.push_back(value);
+    _stringIndices.insert(value, index);
 
-    // If the column count is increasing, jiggle all the existing rows around,
-    // taking into account the new row width
-    if(_rows > 0 && rows > 1 && columns > _columns)
+    return index;
+}
+
+const QString* TabularData::textAt(const Column& column, size_t row) const
+{
+    if(column._numeric)
     {
-        _data.resize(newSize);
+        auto stringIndex = stringIndexAt(column._textCells, row);
+        if(stringIndex == 0)
+            return nullptr;
 
-        for(size_t offset = _rows - 1; offset > 0; offset--)
-        {
-            auto oldPosition = _data.begin() + (offset * _columns);
-            auto newPosition = _data.begin() + (offset * columns);
+        return &_strings.at(static_cast<size_t>(stringIndex));
+    }
+
+    return &_strings.at(static_cast<size_t>(column._stringIndices.at(row)));
+}
+
+void TabularData::convertToText(Column& column)
+{
+    Q_ASSERT(column._numeric);
+
+    std::vector<int> stringIndices(column._numbers.size(), 0);
+    auto textCell = column._textCells.begin();
+    auto sourceText = column._sourceTexts.begin();
 
-            std::move_backward(oldPosition,
-                oldPosition + _columns,
-                newPosition + _columns);
+    for(size_t row = 0; row < column._numbers.size(); row++)
+    {
+        auto number = column._numbers[row];
+
+        if(!std::isnan(number))
+        {
+            if(sourceText != column._sourceTexts.end() && sourceText->first == row)
+                stringIndices[row] = (sourceText++)->second;
+            else
+                stringIndices[row] = indexOfString(numberToString(number));
         }
+        else if(textCell != column._textCells.end() && textCell->first == row)
+            stringIndices[row] = (textCell++)->second;
     }
 
-    _columns = columns;
-    _rows = rows;
+    column._numeric = false;
+    column._numbers = {};
+    column._textCells = {};
+    column._sourceTexts = {};
+    column._stringIndices = std::move(stringIndices);
+    column._stringIndices.reserve(_reservedRows);
+}
 
-    if(newSize > _data.capacity())
+TabularData::Column& TabularData::resizeFor(size_t column, size_t row, int progressHint)
+{
+    if(row >= _reservedRows)
     {
-        size_t reserveSize = newSize;
+        size_t reserveRows = row + 1;
 
         if(progressHint >= 10)
         {
@@ -114,53 +353,249 @@ void TabularData::setValueAt(size_t column, size_t row, QString&& value, int pro
             // is on the small side. Otherwise, when we hit 100, we would default to
             // reallocating for each new element -- exactly what we're trying to avoid
             const auto extraFudgeFactor = 2;
-            auto estimate = ((100 + extraFudgeFactor) * newSize) / progressHint;
+            auto estimate = ((100 + extraFudgeFactor) * reserveRows) /
+                static_cast<size_t>(progressHint);
 
-            reserveSize = std::max(reserveSize, estimate);
+            reserveRows = std::max(reserveRows, estimate);
         }
         else
         {
             // ...otherwise just double the reservation each time we need more space
-            reserveSize = newSize * 2;
+            reserveRows *= 2;
         }
 
-        _data.reserve(reserveSize);
+        for(auto& existingColumn : _columns)
+            existingColumn.reserve(reserveRows);
+
+        _reservedRows = reserveRows;
+    }
+
+    if(column >= _columns.size())
+    {
+        auto numColumns = _columns.size();
+        _columns.resize(column + 1);
+
+        for(auto i = numColumns; i < _columns.size(); i++)
+            _columns[i].reserve(_reservedRows);
+    }
+
+    _numColumns = std::max(_numColumns, column + 1);
+    _numRows = std::max(_numRows, row + 1);
+
+    auto& storageColumn = _columns.at(column);
+
+    if(row >= storageColumn.size())
+        storageColumn.resize(row + 1);
+
+    return storageColumn;
+}
+
+void TabularData::setNumberAt(Column& column, size_t row, double value, int sourceTextIndex)
+{
+    if(!column._numeric)
+    {
+        column._stringIndices.at(row) = sourceTextIndex != 0 ?
+            sourceTextIndex : indexOfString(numberToString(value));
+        return;
+    }
+
+    column._numbers.at(row) = value;
+    setStringIndexAt(column._sourceTexts, row, sourceTextIndex);
+
+    // Remove any text previously set at row
+    setStringIndexAt(column._textCells, row, 0);
+}
+
+void TabularData::setTextAt(Column& column, size_t row, const QString& value)
+{
+    auto stringIndex = value.isEmpty() ? 0 : indexOfString(value);
+
+    if(!column._numeric)
+    {
+        column._stringIndices.at(row) = stringIndex;
+        return;
     }
 
-    _data.resize(newSize);
-    _data.at(index(column, row)) = value.trimmed();
+    column._numbers.at(row) = EmptyValue;
+    setStringIndexAt(column._sourceTexts, row, 0);
+    setStringIndexAt(column._textCells, row, stringIndex);
+
+    if(column._textCells.size() > MaxTextCellsInNumericColumn)
+        convertToText(column);
+}
+
+void TabularData::setValueAt(size_t column, size_t row, QString&& value, int progressHint)
+{
+    auto utf8Value = value.toUtf8();
+    setValueAt(column, row, std::string_view(utf8Value.constData(),
+        static_cast<size_t>(utf8Value.size())), progressHint);
+}
+
+TabularData::ParsedValue TabularData::parseValue(std::string_view value)
+{
+    ParsedValue parsedValue;
+    parsedValue._text = trimmed(value);
+
+    if(!parsedValue._text.empty())
+        parsedValue._isNumeric = parseNumber(parsedValue._text, parsedValue._number);
+
+    if(parsedValue._isNumeric)
+        parsedValue._isCanonical = textIsCanonical(parsedValue._text, parsedValue._number);
+
+    return parsedValue;
+}
+
+void TabularData::setValueAt(size_t column, size_t row, std::string_view value, int progressHint)
+{
+    setValueAt(column, row, parseValue(value), progressHint);
+}
+
+void TabularData::setValueAt(size_t column, size_t row, const ParsedValue& value, int progressHint)
+{
+    auto& storageColumn = resizeFor(column, row, progressHint);
+
+    if(value._text.empty())
+        setTextAt(storageColumn, row, {});
+    else if(storageColumn._numeric && value._isNumeric)
+    {
+        // The input text is only kept when it isn't how the number would be formatted
+        auto sourceTextIndex = value._isCanonical ? 0 :
+            indexOfString(QString::fromUtf8(value._text.data(), static_cast<int>(value._text.size())));
+
+        setNumberAt(storageColumn, row, value._number, sourceTextIndex);
+    }
+    else
+    {
+        // Text columns keep the original text, even if it is numeric
+        setTextAt(storageColumn, row, QString::fromUtf8(value._text.data(),
+            static_cast<int>(value._text.size())));
+    }
 }
 
 void TabularData::shrinkToFit()
 {
-    auto lastRowIsEmpty = [this]
+    auto cellIsEmpty = [this](const Column& column, size_t row)
     {
-        size_t column = 0;
-        while(column < _columns && valueAt(column, _rows - 1).isEmpty())
-            column++;
+        if(row >= column.size())
+            return true;
 
-        return column >= _columns;
+        if(column._numeric)
+            return std::isnan(column._numbers[row]) && textAt(column, row) == nullptr;
+
+        return column._stringIndices[row] == 0;
+    };
+
+    auto lastRowIsEmpty = [this, &cellIsEmpty]
+    {
+        return std::all_of(_columns.begin(), _columns.end(),
+            [this, &cellIsEmpty](const auto& column) { return cellIsEmpty(column, _numRows - 1); });
     };
 
     // Truncate any trailing empty rows
-    while(_rows > 0 && lastRowIsEmpty())
+    while(_numRows > 0 && lastRowIsEmpty())
     {
-        _data.resize(_data.size() - _columns);
-        _rows--;
+        _numRows--;
+
+        for(auto& column : _columns)
+        {
+            if(column.size() > _numRows)
+                column.resize(_numRows);
+        }
     }
 
-    _data.shrink_to_fit();
+    for(auto& column : _columns)
+        column.shrinkToFit();
+
+    _columns.shrink_to_fit();
+    _strings.shrink_to_fit();
+    _stringIndices.squeeze();
+    _reservedRows = _numRows;
 }
 
 void TabularData::reset()
 {
-    _data.clear();
-    _columns = 0;
-    _rows = 0;
+    _columns.clear();
+    _strings = {QString()};
+    _stringIndices.clear();
+    _stringIndices.insert(QString(), 0);
+    _numColumns = 0;
+    _numRows = 0;
     _transposed = false;
+    _reservedRows = 0;
+}
+
+bool TabularData::columnIsNumeric(size_t column) const
+{
+    // When transposed, "columns" are spread across all the storage columns
+    if(_transposed)
+        return false;
+
+    return column < _columns.size() && _columns.at(column)._numeric;
+}
+
+QString TabularData::valueAt(size_t column, size_t row) const
+{
+    auto [storageColumn, storageRow] = storageIndex(column, row);
+    const auto& c = _columns.at(storageColumn);
+
+    if(storageRow >= c.size())
+        return {};
+
+    if(c._numeric && !std::isnan(c._numbers[storageRow]))
+    {
+        auto sourceTextIndex = stringIndexAt(c._sourceTexts, storageRow);
+        if(sourceTextIndex != 0)
+            return _strings.at(static_cast<size_t>(sourceTextIndex));
+
+        return numberToString(c._numbers[storageRow]);
+    }
+
+    const auto* text = textAt(c, storageRow);
+    return text != nullptr ? *text : QString();
+}
+
+bool TabularData::valueIsEmpty(size_t column, size_t row) const
+{
+    auto [storageColumn, storageRow] = storageIndex(column, row);
+    const auto& c = _columns.at(storageColumn);
+
+    if(storageRow >= c.size())
+        return true;
+
+    if(c._numeric)
+        return std::isnan(c._numbers[storageRow]) && textAt(c, storageRow) == nullptr;
+
+    return c._stringIndices[storageRow] == 0;
 }
 
-const QString& TabularData::valueAt(size_t column, size_t row) const
+bool TabularData::valueIsNumeric(size_t column, size_t row) const
 {
-    return _data.at(index(column, row));
+    bool success = false;
+    numericValueAt(column, row, &success);
+
+    return success;
+}
+
+double TabularData::numericValueAt(size_t column, size_t row, bool* success) const
+{
+    auto [storageColumn, storageRow] = storageIndex(column, row);
+    const auto& c = _columns.at(storageColumn);
+
+    if(storageRow < c.size() && c._numeric && !std::isnan(c._numbers[storageRow]))
+    {
+        if(success != nullptr)
+            *success = true;
+
+        return c._numbers[storageRow];
+    }
+
+    // Text that is numeric, but wasn't stored as a number
+    const auto* text = storageRow < c.size() ? textAt(c, storageRow) : nullptr;
+    if(text != nullptr)
+        return text->toDouble(success);
+
+    if(success != nullptr)
+        *success = false;
+
+    return 0.0;
 }
@@ -22,33 +22,79 @@
 #include "shared/graph/igraphmodel.h"
 #include "shared/graph/imutablegraph.h"
 #include "shared/loading/iparser.h"
+#include "shared/loading/textdelimitedtokenizer.h"
 #include "shared/utils/string.h"
 
 #include <csv/parser.hpp>
 
 #include <QObject>
 #include <QString>
+#include <QHash>
 #include <QUrl>
 
 #include <fstream>
 #include <iostream>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <utility>
 #include <array>
 #include <cstring>
 
+// Cells are stored by column; a column is numeric (a contiguous array of doubles) until
+// it contains too many non-numeric cells, at which point it becomes a text column,
+// which holds indices into a string pool shared by all the columns
+// The text of a numeric cell is always that of the input; where it differs from the
+// canonical formatting of its number (e.g. 1.50 or 1e3), the input text is kept too
 class TabularData
 {
 private:
-    std::vector<QString> _data;
-    size_t _columns = 0;
-    size_t _rows = 0;
+    // Numeric columns may contain this many text cells (e.g. headers, annotations)
+    static constexpr size_t MaxTextCellsInNumericColumn = 64;
+
+    // Sorted (row, string index) pairs, for cells that are the exception in their column
+    using RowStrings = std::vector<std::pair<size_t, int>>;
+
+    struct Column
+    {
+        bool _numeric = true;
+
+        // Numeric columns; empty and text cells are NaN
+        std::vector<double> _numbers;
+        RowStrings _textCells;
+        RowStrings _sourceTexts;
+
+        // Text columns; index 0 is the empty string
+        std::vector<int> _stringIndices;
+
+        size_t size() const { return _numeric ? _numbers.size() : _stringIndices.size(); }
+        void reserve(size_t size);
+        void resize(size_t size);
+        void shrinkToFit();
+    };
+
+    std::vector<Column> _columns;
+    std::vector<QString> _strings;
+    QHash<QString, int> _stringIndices;
+    size_t _numColumns = 0;
+    size_t _numRows = 0;
     bool _transposed = false;
 
-    size_t index(size_t column, size_t row) const;
+    size_t _reservedRows = 0;
+
+    // Maps a (possibly transposed) column and row onto the column and row as stored
+    std::pair<size_t, size_t> storageIndex(size_t column, size_t row) const;
+
+    int indexOfString(const QString& value);
+    const QString* textAt(const Column& column, size_t row) const;
+    void convertToText(Column& column);
+    Column& resizeFor(size_t column, size_t row, int progressHint);
+
+    void setNumberAt(Column& column, size_t row, double value, int sourceTextIndex = 0);
+    void setTextAt(Column& column, size_t row, const QString& value);
 
 public:
-    TabularData() = default;
+    TabularData();
     TabularData(TabularData&&) noexcept;
     TabularData& operator=(TabularData&&) noexcept;
 
@@ -62,10 +108,33 @@ public:
     size_t numColumns() const;
     size_t numRows() const;
     bool transposed() const { return _transposed; }
-    const QString& valueAt(size_t column, size_t row) const;
+
+    bool columnIsNumeric(size_t column) const;
+
+    // The text of the cell, exactly as it was input, even for numeric cells
+    QString valueAt(size_t column, size_t row) const;
+    bool valueIsEmpty(size_t column, size_t row) const;
+    bool valueIsNumeric(size_t column, size_t row) const;
+    double numericValueAt(size_t column, size_t row, bool* success = nullptr) const;
+
+    // A trimmed value and, if it can be stored as such, its numeric equivalent
+    struct ParsedValue
+    {
+        std::string_view _text;
+        double _number = 0.0;
+        bool _isNumeric = false;
+
+        // The text is exactly how the number is formatted, so needn't be kept
+        bool _isCanonical = false;
+    };
+
+    // Parsing is independent of any TabularData state, so may be done concurrently
+    static ParsedValue parseValue(std::string_view value);
 
     void setTransposed(bool transposed) { _transposed = transposed; }
     void setValueAt(size_t column, size_t row, QString&& value, int progressHint = -1);
+    void setValueAt(size_t column, size_t row, std::string_view value, int progressHint = -1);
+    void setValueAt(size_t column, size_t row, const ParsedValue& value, int progressHint = -1);
 
     void shrinkToFit();
     void reset();
@@ -92,40 +161,12 @@ public:
         if(graphModel != nullptr)
             graphModel->mutableGraph().setPhase(QObject::tr("Parsing"));
 
-        size_t columnIndex = 0;
-        size_t rowIndex = 0;
+        TextDelimitedTokenizer tokenizer(Delimiter);
+        tokenizer.setRowLimit(_rowLimit);
 
-        std::ifstream file(url.toLocalFile().toStdString());
-
-        if(!file)
+        if(!tokenizer.tokenize(url.toLocalFile(), _tabularData, *this))
             return false;
 
-        auto fileSize = file.tellg();
-        file.seekg(0, std::ios::end);
-        fileSize = file.tellg() - fileSize;
-        file.seekg(0, std::ios::beg);
-
-        auto parser = std::make_unique<aria::csv::CsvParser>(file);
-        parser->delimiter(Delimiter);
-        for(const auto& row : *parser)
-        {
-            auto progress = file.eof() ? 100 :
-                static_cast<int>(parser->position() * 100 / fileSize);
-            setProgress(progress);
-
-            for(const auto& field : row)
-            {
-                _tabularData.setValueAt(columnIndex++, rowIndex,
-                    QString::fromStdString(field), progress);
-            }
-
-            rowIndex++;
-            columnIndex = 0;
-
-            if(_rowLimit > 0 && rowIndex > _rowLimit)
-                break;
-        }
-
         // Free up any over-allocation
         _tabularData.shrinkToFit();
 
@@ -0,0 +1,377 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "textdelimitedtokenizer.h"
+
+#include "shared/loading/iparser.h"
+#include "shared/loading/tabulardata.h"
+#include "shared/utils/threadpool.h"
+
+#include <QFile>
+
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace
+{
+// Chunks are tokenized in batches, so that the memory used by cells that have been
+// tokenized, but not yet added to the TabularData, doesn't depend on the file size
+constexpr size_t ChunkSize = 256 * 1024;
+constexpr size_t ChunksPerThread = 4;
+
+bool isTerminator(char c) { return c == '\n' || c == '\r'; }
+
+// \r\n is treated as a single terminator
+const char* skipTerminator(const char* it, const char* end)
+{
+    if(*it == '\r' && (it + 1) < end && *(it + 1) == '\n')
+        return it + 2;
+
+    return it + 1;
+}
+
+struct TokenizeResult
+{
+    const char* _position = nullptr;
+
+    // False if tokenization stopped part way through a row
+    bool _atRowBoundary = false;
+};
+
+// Calls onCell for each cell and onRowEnd at the end of each row, stopping at the
+// first row boundary at or after until, or when onRowEnd returns false
+template<typename CellFn, typename RowEndFn>
+TokenizeResult tokenizeCells(const char* begin, const char* until, const char* end,
+    char delimiter, std::string& buffer, CellFn&& onCell, RowEndFn&& onRowEnd)
+{
+    const char* it = begin;
+    bool rowHasCells = false;
+
+    while(it < end)
+    {
+        if(isTerminator(*it))
+        {
+            it = skipTerminator(it, end);
+            rowHasCells = false;
+
+            if(!onRowEnd() || it >= until)
+                return {it, true};
+
+            continue;
+        }
+
+        std::string_view cell;
+        bool inPlace = true;
+
+        if(*it != '\"')
+        {
+            const char* cellEnd = it;
+            while(cellEnd < end && *cellEnd != delimiter && !isTerminator(*cellEnd))
+                cellEnd++;
+
+            cell = std::string_view(it, static_cast<size_t>(cellEnd - it));
+            it = cellEnd;
+        }
+        else
+        {
+            const char* cellBegin = ++it;
+            const char* closingQuote = std::find(cellBegin, end, '\"');
+            const char* next = closingQuote != end ? closingQuote + 1 : end;
+
+            if(next == end || *next == delimiter || isTerminator(*next))
+            {
+                // The common case: no escaped quotes or trailing text, so no copy is necessary
+                cell = std::string_view(cellBegin, static_cast<size_t>(closingQuote - cellBegin));
+                it = next;
+            }
+            else
+            {
+                // A doubled quote is a literal quote; text following the closing
+                // quote is appended to the cell, with any quotes taken literally
+                buffer.clear();
+                bool inQuotes = true;
+
+                while(it < end)
+                {
+                    if(inQuotes)
+                    {
+                        const char* quote = std::find(it, end, '\"');
+                        buffer.append(it, quote);
+                        it = quote;
+
+                        if(it == end)
+                            break;
+
+                        it++;
+
+                        if(it < end && *it == '\"')
+                        {
+                            buffer += '\"';
+                            it++;
+                        }
+                        else
+                            inQuotes = false;
+                    }
+                    else if(*it == delimiter || isTerminator(*it))
+                        break;
+                    else
+                        buffer += *it++;
+                }
+
+                cell = buffer;
+                inPlace = false;
+            }
+        }
+
+        if(it == end)
+        {
+            // An empty cell at the very end of the input is ignored
+            if(!cell.empty())
+            {
+                onCell(cell, inPlace);
+                rowHasCells = true;
+            }
+
+            break;
+        }
+
+        onCell(cell, inPlace);
+        rowHasCells = true;
+
+        if(*it == delimiter)
+            it++;
+    }
+
+    if(rowHasCells)
+        onRowEnd();
+
+    return {end, false};
+}
+
+// Finds the first row boundary at or after position, assuming that quotes are balanced
+const char* findRowBoundary(const char* position, const char* end, bool inQuotes)
+{
+    for(const char* it = position; it < end; it++)
+    {
+        if(*it == '\"')
+            inQuotes = !inQuotes;
+        else if(!inQuotes && isTerminator(*it))
+            return skipTerminator(it, end);
+    }
+
+    return end;
+}
+
+struct Chunk
+{
+    const char* _begin = nullptr;
+    const char* _end = nullptr;
+    size_t _numQuotes = 0;
+
+    std::vector<TabularData::ParsedValue> _values;
+    std::vector<size_t> _rowEnds;
+
+    // Cells that contain escaped quotes can't reference the file directly
+    std::deque<std::string> _unescapedValues;
+
+    bool _valid = false;
+};
+
+int progressAt(const char* position, const char* data, size_t size)
+{
+    return static_cast<int>((static_cast<size_t>(position - data) * 100) / size);
+}
+
+// Adds the cells to tabularData as they are tokenized
+TokenizeResult tokenizeInto(TabularData& tabularData, size_t& rowIndex, size_t rowLimit,
+    const char* begin, const char* until, const char* end, char delimiter, int progressHint)
+{
+    size_t columnIndex = 0;
+    std::string buffer;
+
+    return tokenizeCells(begin, until, end, delimiter, buffer,
+    [&](std::string_view cell, bool)
+    {
+        tabularData.setValueAt(columnIndex++, rowIndex, cell, progressHint);
+    },
+    [&]
+    {
+        rowIndex++;
+        columnIndex = 0;
+
+        return rowLimit == 0 || rowIndex <= rowLimit;
+    });
+}
+} // namespace
+
+bool TextDelimitedTokenizer::tokenizeConcurrently(const char* data, size_t size,
+    TabularData& tabularData, IParser& parser) const
+{
+    const char* end = data + size;
+    const size_t batchSize = ChunkSize * ChunksPerThread *
+        std::max(std::thread::hardware_concurrency(), 1u);
+
+    ThreadPool threadPool(QStringLiteral("Tokenizer"));
+    std::vector<Chunk> chunks;
+    size_t rowIndex = 0;
+
+    const char* batchBegin = data;
+    while(batchBegin < end)
+    {
+        if(parser.cancelled())
+            return false;
+
+        const char* batchEnd = std::min(batchBegin + batchSize, end);
+
+        chunks.clear();
+        chunks.resize((static_cast<size_t>(batchEnd - batchBegin) + ChunkSize - 1) / ChunkSize);
+
+        for(size_t i = 0; i < chunks.size(); i++)
+        {
+            chunks[i]._begin = batchBegin + (i * ChunkSize);
+            chunks[i]._end = std::min(chunks[i]._begin + ChunkSize, batchEnd);
+        }
+
+        threadPool.concurrent_for(chunks.begin(), chunks.end(),
+        [](Chunk& chunk)
+        {
+            chunk._numQuotes = static_cast<size_t>(std::count(chunk._begin, chunk._end, '\"'));
+        });
+
+        // Move each chunk's start forward to the next row boundary; the number of quotes
+        // before it determines whether or not it is inside a quoted cell
+        size_t numQuotes = 0;
+        for(size_t i = 1; i < chunks.size(); i++)
+        {
+            numQuotes += chunks[i - 1]._numQuotes;
+            chunks[i]._begin = findRowBoundary(chunks[i]._begin, end, numQuotes % 2 != 0);
+            chunks[i - 1]._end = chunks[i]._begin;
+        }
+
+        numQuotes += chunks.back()._numQuotes;
+        chunks.back()._end = findRowBoundary(batchEnd, end, numQuotes % 2 != 0);
+
+        auto progress = progressAt(batchBegin, data, size);
+        parser.setProgress(progress);
+
+        if(static_cast<size_t>(chunks.back()._end - batchBegin) > 2 * batchSize)
+        {
+            // The quotes are so unbalanced that no row boundary was found anywhere near the
+            // end of the batch; rather than tokenizing a huge chunk, do this batch sequentially
+            batchBegin = tokenizeInto(tabularData, rowIndex, 0, batchBegin,
+                batchEnd, end, _delimiter, progress)._position;
+            continue;
+        }
+
+        threadPool.concurrent_for(chunks.begin(), chunks.end(),
+        [this, end](Chunk& chunk)
+        {
+            std::string buffer;
+
+            auto result = tokenizeCells(chunk._begin, chunk._end, chunk._end, _delimiter, buffer,
+            [&chunk](std::string_view cell, bool inPlace)
+            {
+                auto value = TabularData::parseValue(cell);
+
+                if(!inPlace && !value._text.empty())
+                    value._text = chunk._unescapedValues.emplace_back(value._text);
+
+                chunk._values.push_back(value);
+            },
+            [&chunk]
+            {
+                chunk._rowEnds.push_back(chunk._values.size());
+                return true;
+            });
+
+            // A chunk is tokenized as if it starts on a row boundary, which is only the case if the
+            // preceding chunk ended on one; the last chunk may legitimately end part way through a row
+            chunk._valid = chunk._begin == chunk._end ||
+                result._atRowBoundary || chunk._end == end;
+        });
+
+        for(auto& chunk : chunks)
+        {
+            if(parser.cancelled())
+                return false;
+
+            progress = progressAt(chunk._begin, data, size);
+            parser.setProgress(progress);
+
+            if(!chunk._valid)
+            {
+                // Quotes in unquoted cells can throw the row boundaries out, in which case tokenize
+                // sequentially instead, up until the first actual row boundary after the chunk
+                batchBegin = tokenizeInto(tabularData, rowIndex, 0, chunk._begin,
+                    chunk._end, end, _delimiter, progress)._position;
+                break;
+            }
+
+            size_t valueIndex = 0;
+            for(auto rowEnd : chunk._rowEnds)
+            {
+                for(size_t columnIndex = 0; valueIndex < rowEnd; columnIndex++, valueIndex++)
+                    tabularData.setValueAt(columnIndex, rowIndex, chunk._values[valueIndex], progress);
+
+                rowIndex++;
+            }
+
+            batchBegin = chunk._end;
+        }
+    }
+
+    parser.setProgress(100);
+
+    return true;
+}
+
+bool TextDelimitedTokenizer::tokenize(const QString& fileName,
+    TabularData& tabularData, IParser& parser) const
+{
+    QFile file(fileName);
+
+    if(!file.open(QIODevice::ReadOnly))
+        return false;
+
+    const auto size = static_cast<size_t>(file.size());
+
+    if(size == 0)
+        return true;
+
+    const auto* data = reinterpret_cast<const char*>(file.map(0, file.size()));
+
+    if(data == nullptr)
+        return false;
+
+    if(_rowLimit > 0)
+    {
+        // When only the first few rows are wanted, there is nothing
+        // to be gained by tokenizing the rest of the file
+        size_t rowIndex = 0;
+        tokenizeInto(tabularData, rowIndex, _rowLimit, data,
+            data + size, data + size, _delimiter, -1);
+
+        return true;
+    }
+
+    return tokenizeConcurrently(data, size, tabularData, parser);
+}
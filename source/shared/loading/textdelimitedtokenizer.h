@@ -0,0 +1,51 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TEXTDELIMITEDTOKENIZER_H
+#define TEXTDELIMITEDTOKENIZER_H
+
+#include <QString>
+
+#include <cstddef>
+
+class TabularData;
+class IParser;
+
+// Tokenizes a delimited text file into a TabularData, following the same quoting rules
+// as aria::csv::CsvParser. The file is memory mapped and split into chunks that begin
+// on row boundaries; the chunks are then tokenized concurrently and their cells added
+// to the TabularData in order
+class TextDelimitedTokenizer
+{
+private:
+    char _delimiter;
+    size_t _rowLimit = 0;
+
+    bool tokenizeConcurrently(const char* data, size_t size,
+        TabularData& tabularData, IParser& parser) const;
+
+public:
+    explicit TextDelimitedTokenizer(char delimiter) : _delimiter(delimiter) {}
+
+    // Only the first rowLimit + 1 rows are read, when non-zero
+    void setRowLimit(size_t rowLimit) { _rowLimit = rowLimit; }
+
+    bool tokenize(const QString& fileName, TabularData& tabularData, IParser& parser) const;
+};
+
+#endif // TEXTDELIMITEDTOKENIZER_H
@@ -42,7 +42,7 @@ static int cellCallback(size_t row, size_t column, const XLSXIOCHAR* value, void
         return 1;
 
     // XLSXIO is some kind of deviant library that indexes from 1
-    xlsxTabularDataParser->tabularData().setValueAt(column - 1, row - 1, value);
+    xlsxTabularDataParser->tabularData().setValueAt(column - 1, row - 1, std::string_view(value));
 
     return 0;
 }
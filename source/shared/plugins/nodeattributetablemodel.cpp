@@ -27,8 +27,15 @@
 #include "shared/attributes/valuetype.h"
 
 #include "shared/utils/container.h"
+#include "shared/utils/threadpool.h"
 
 #include <QtGlobal>
+#include <QCollator>
+#include <QHash>
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
 
 void NodeAttributeTableModel::initialise(IDocument* document, UserNodeData* userNodeData)
 {
@@ -93,6 +100,10 @@ QVariant NodeAttributeTableModel::dataValue(size_t row, const QString& columnNam
     {
         auto nodeId = _userNodeData->elementIdForIndex(row);
 
+        // This can happen if the user has deleted some nodes then saved and reloaded
+        if(nodeId.isNull())
+            return {};
+
         if(!attribute->valueMissingOf(nodeId))
             return attribute->valueOf(nodeId);
     }
@@ -104,13 +115,15 @@ void NodeAttributeTableModel::onColumnAdded(size_t columnIndex)
 {
     auto columnName = _columnNames.at(static_cast<int>(columnIndex));
 
+    if(_pendingRowPresent.size() != static_cast<size_t>(rowCount()))
+        _pendingRowPresent = rowPresence();
+
     if(columnIndex < _pendingData.size())
-        _pendingData.insert(_pendingData.begin() + static_cast<int>(columnIndex), {{}});
+        _pendingData.insert(_pendingData.begin() + static_cast<int>(columnIndex), nullptr);
     else
         _pendingData.resize(columnIndex + 1);
 
-    auto& column = _pendingData.at(columnIndex);
-    updateColumn(Qt::DisplayRole, column, columnName);
+    _pendingData.at(columnIndex) = makeColumn(columnName);
 }
 
 void NodeAttributeTableModel::onColumnRemoved(size_t columnIndex)
@@ -133,50 +146,249 @@ void NodeAttributeTableModel::updateAttribute(const QString& attributeName)
     auto index = static_cast<size_t>(indexForColumnName(attributeName));
 
     Q_ASSERT(index < _pendingData.size());
-    auto& column = _pendingData.at(index);
-
-    updateColumn(Qt::DisplayRole, column, attributeName);
+    _pendingData.at(index) = makeColumn(attributeName);
 
     QMetaObject::invokeMethod(this, "onUpdateColumnComplete", Q_ARG(QString, attributeName));
 }
 
-void NodeAttributeTableModel::updateColumn(int role, NodeAttributeTableModel::Column& column,
-    const QString& columnName)
+std::vector<bool> NodeAttributeTableModel::rowPresence() const
 {
-    column.resize(static_cast<size_t>(rowCount()));
+    const auto numRows = static_cast<size_t>(rowCount());
+    std::vector<bool> rowPresent(numRows, false);
 
-    for(size_t row = 0; row < static_cast<size_t>(rowCount()); row++)
+    for(size_t row = 0; row < numRows; row++)
     {
         NodeId nodeId = _userNodeData->elementIdForIndex(row);
+        rowPresent[row] = !nodeId.isNull() && _graph->containsNodeId(nodeId);
+    }
+
+    return rowPresent;
+}
+
+QVariant NodeAttributeTableModel::Column::value(size_t row) const
+{
+    if(row >= _valuePresent.size() || !_valuePresent[row])
+        return {};
+
+    switch(_type)
+    {
+    case ValueType::Int:    return _intValues[row];
+    case ValueType::Float:  return _floatValues[row];
+    case ValueType::String: return _stringValues[row];
+    default:                return {};
+    }
+}
+
+NodeAttributeTableModel::ColumnPtr NodeAttributeTableModel::makeColumn(const QString& columnName) const
+{
+    const auto numRows = static_cast<size_t>(rowCount());
+    auto column = std::make_shared<Column>();
+
+    if(columnIsFloatingPoint(columnName))
+        column->_type = ValueType::Float;
+    else if(columnIsNumerical(columnName))
+        column->_type = ValueType::Int;
+    else
+        column->_type = ValueType::String;
+
+    switch(column->_type)
+    {
+    case ValueType::Int:    column->_intValues.resize(numRows); break;
+    case ValueType::Float:  column->_floatValues.resize(numRows); break;
+    default:                column->_stringValues.resize(numRows); break;
+    }
+
+    column->_valuePresent.resize(numRows, false);
+
+    const auto* attribute = _document->graphModel()->attributeByName(columnName);
+
+    if(columnIsCalculated(columnName) && attribute != nullptr && attribute->isValid())
+    {
+        // Calculated values only exist for the nodes that are in the graph, but
+        // they can be read directly in their own type, avoiding any QVariants
+        Q_ASSERT(_pendingRowPresent.size() == numRows);
+        const auto valueType = attribute->valueType();
+        Q_ASSERT(valueType == column->_type || !(valueType & ValueType::Numerical));
+
+        for(size_t row = 0; row < numRows; row++)
+        {
+            if(!_pendingRowPresent[row])
+                continue;
+
+            NodeId nodeId = _userNodeData->elementIdForIndex(row);
+            if(attribute->valueMissingOf(nodeId))
+                continue;
+
+            switch(valueType)
+            {
+            case ValueType::Int:
+                column->_intValues[row] = attribute->intValueOf(nodeId);
+                break;
+
+            case ValueType::Float:
+                column->_floatValues[row] = attribute->floatValueOf(nodeId);
+                break;
+
+            case ValueType::String:
+                column->_stringValues[row] = attribute->stringValueOf(nodeId);
+                break;
+
+            default:
+                continue;
+            }
+
+            column->_valuePresent[row] = true;
+        }
+    }
+    else
+    {
+        // User data is indexed by row, so it doesn't depend on the graph and
+        // is available regardless of whether or not the row's node is present
+        for(size_t row = 0; row < numRows; row++)
+        {
+            auto value = dataValue(row, columnName);
+            if(!value.isValid())
+                continue;
+
+            switch(column->_type)
+            {
+            case ValueType::Int:    column->_intValues[row] = value.toInt(); break;
+            case ValueType::Float:  column->_floatValues[row] = value.toDouble(); break;
+            default:                column->_stringValues[row] = value.toString(); break;
+            }
+
+            column->_valuePresent[row] = true;
+        }
+    }
+
+    column->_sortKeys = sortKeysFor(*column);
+
+    return column;
+}
+
+NodeAttributeTableModel::SortKeysPtr NodeAttributeTableModel::sortKeysFor(const Column& column)
+{
+    const auto numRows = column._valuePresent.size();
+    auto sortKeys = std::make_shared<SortKeys>(numRows, std::numeric_limits<double>::quiet_NaN());
+
+    if(column._type == ValueType::Int || column._type == ValueType::Float)
+    {
+        for(size_t row = 0; row < numRows; row++)
+        {
+            if(!column._valuePresent[row])
+                continue;
+
+            (*sortKeys)[row] = column._type == ValueType::Int ?
+                static_cast<double>(column._intValues[row]) : column._floatValues[row];
+        }
+
+        return sortKeys;
+    }
+
+    // Collate each distinct string once, rather than on every comparison
+    QCollator collator;
+    collator.setNumericMode(true);
+
+    QHash<QString, size_t> distinctIndices;
+    std::vector<QCollatorSortKey> collatorKeys;
+    std::vector<size_t> rowIndices(numRows, std::numeric_limits<size_t>::max());
 
-        if(nodeId.isNull() || !_document->graphModel()->graph().containsNodeId(nodeId))
+    for(size_t row = 0; row < numRows; row++)
+    {
+        if(!column._valuePresent[row])
+            continue;
+
+        const auto& value = column._stringValues[row];
+        auto it = distinctIndices.find(value);
+
+        if(it == distinctIndices.end())
         {
-            // The graph doesn't necessarily have a node for every row since
-            // it may have been transformed, leaving empty rows
-            column[row] = {};
+            it = distinctIndices.insert(value, collatorKeys.size());
+            collatorKeys.push_back(collator.sortKey(value));
         }
-        else if(role == Roles::NodeIdRole)
-            column[row] = static_cast<int>(nodeId);
-        else if(role == Roles::NodeSelectedRole)
-            column[row] = _document->selectionManager()->nodeIsSelected(nodeId);
-        else
-            column[row] = dataValue(row, columnName);
+
+        rowIndices[row] = it.value();
+    }
+
+    std::vector<size_t> order(collatorKeys.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&collatorKeys](size_t a, size_t b)
+    {
+        return collatorKeys[a].compare(collatorKeys[b]) < 0;
+    });
+
+    // Strings that collate equally share a rank
+    std::vector<double> ranks(collatorKeys.size());
+    double rank = 0.0;
+    for(size_t i = 0; i < order.size(); i++)
+    {
+        if(i > 0 && collatorKeys[order[i - 1]].compare(collatorKeys[order[i]]) != 0)
+            rank++;
+
+        ranks[order[i]] = rank;
+    }
+
+    for(size_t row = 0; row < numRows; row++)
+    {
+        if(rowIndices[row] < ranks.size())
+            (*sortKeys)[row] = ranks[rowIndices[row]];
+    }
+
+    return sortKeys;
+}
+
+void NodeAttributeTableModel::updateNodeSelected()
+{
+    const auto numRows = static_cast<size_t>(rowCount());
+    std::vector<bool> nodeSelected(numRows, false);
+
+    for(size_t row = 0; row < numRows; row++)
+    {
+        NodeId nodeId = _userNodeData->elementIdForIndex(row);
+
+        if(!nodeId.isNull() && _graph->containsNodeId(nodeId))
+            nodeSelected[row] = _document->selectionManager()->nodeIsSelected(nodeId);
     }
+
+    _nodeSelected = std::move(nodeSelected);
 }
 
 void NodeAttributeTableModel::update()
 {
     std::unique_lock<std::recursive_mutex> lock(_updateMutex);
 
-    _pendingData.clear();
+    updateNodeSelected();
+    _pendingRowPresent = rowPresence();
 
-    updateColumn(Roles::NodeSelectedRole, _nodeSelectedColumn);
-    updateColumn(Roles::NodeIdRole, _nodeIdColumn);
+    if(_pendingData.size() != static_cast<size_t>(_columnNames.size()))
+    {
+        _pendingData.assign(static_cast<size_t>(_columnNames.size()), nullptr);
+        _resetRequired = true;
+    }
 
-    for(const auto& columnName : _columnNames)
+    // Values that come from user data don't depend on the graph, so unless
+    // they've been explicitly changed, only the calculated columns need
+    // to be rebuilt
+    std::vector<size_t> staleColumns;
+    for(size_t columnIndex = 0; columnIndex < _pendingData.size(); columnIndex++)
     {
-        _pendingData.emplace_back(rowCount());
-        updateColumn(Qt::DisplayRole, _pendingData.back(), columnName);
+        const auto& columnName = _columnNames.at(static_cast<int>(columnIndex));
+
+        if(_pendingData.at(columnIndex) == nullptr || columnIsCalculated(columnName) ||
+            u::contains(_columnsRequiringUpdates, columnName))
+        {
+            staleColumns.push_back(columnIndex);
+        }
+    }
+
+    _columnsRequiringUpdates.clear();
+
+    if(!staleColumns.empty())
+    {
+        concurrent_for(staleColumns.begin(), staleColumns.end(), [this](size_t columnIndex)
+        {
+            _pendingData.at(columnIndex) = makeColumn(_columnNames.at(static_cast<int>(columnIndex)));
+        });
     }
 
     QMetaObject::invokeMethod(this, "onUpdateComplete");
@@ -208,22 +420,25 @@ void NodeAttributeTableModel::onUpdateComplete()
 {
     std::unique_lock<std::recursive_mutex> lock(_updateMutex);
 
+    if(!_resetRequired)
+    {
+        // The columns are the same ones as before, so only their values
+        // and which rows are present have changed
+        emit layoutAboutToBeChanged();
+        _data = _pendingData;
+        _rowPresent = _pendingRowPresent;
+        emit layoutChanged();
+        return;
+    }
+
     beginResetModel();
     _data = _pendingData;
+    _rowPresent = _pendingRowPresent;
+    _resetRequired = false;
     endResetModel();
     emit columnNamesChanged();
 }
 
-void NodeAttributeTableModel::onGraphChanged(const Graph*, bool changeOccurred)
-{
-    if(changeOccurred)
-    {
-        _graph->setPhase(tr("Attribute Table"));
-        update();
-        _graph->clearPhase();
-    }
-}
-
 bool NodeAttributeTableModel::columnIsCalculated(const QString& columnName) const
 {
     return !u::contains(_userNodeData->vectorNames(), columnName);
@@ -264,8 +479,8 @@ bool NodeAttributeTableModel::columnIsNumerical(const QString& columnName) const
 
 bool NodeAttributeTableModel::rowVisible(size_t row) const
 {
-    Q_ASSERT(row < _nodeSelectedColumn.size());
-    return _nodeSelectedColumn[row].toBool();
+    Q_ASSERT(row < _nodeSelected.size());
+    return _nodeSelected[row];
 }
 
 QString NodeAttributeTableModel::columnNameFor(size_t column) const
@@ -301,8 +516,9 @@ void NodeAttributeTableModel::onAttributesChanged(const QStringList& added, cons
         return;
     }
 
-    // Any roles requiring an update will be taken care of en-masse, in onUpdateComplete
-    _columnsRequiringUpdates.clear();
+    // Any columns requiring an update are left pending, to be rebuilt
+    // along with the calculated columns when the graph next changes
+    _resetRequired = true;
 
     for(const auto& name : filteredRemoved)
     {
@@ -352,31 +568,35 @@ int NodeAttributeTableModel::columnCount(const QModelIndex&) const
 QVariant NodeAttributeTableModel::data(const QModelIndex& index, int role) const
 {
     auto column = static_cast<size_t>(index.column());
+    auto row = static_cast<size_t>(index.row());
+
     if(role == Qt::DisplayRole)
     {
-        if(column >= _data.size())
+        if(column >= _data.size() || _data.at(column) == nullptr)
             return {};
 
-        const auto& dataColumn = _data.at(column);
-
-        auto row = static_cast<size_t>(index.row());
-        if(row >= dataColumn.size())
+        if(row >= _rowPresent.size() || !_rowPresent[row])
             return {};
 
-        auto cachedValue = dataColumn.at(row);
-        return cachedValue;
+        return _data.at(column)->value(row);
     }
 
-    if(role == Roles::NodeSelectedRole && !_nodeSelectedColumn.empty())
-    {
-        auto row = static_cast<size_t>(index.row());
-        return _nodeSelectedColumn.at(row);
-    }
+    if(role == Roles::NodeSelectedRole && row < _nodeSelected.size())
+        return static_cast<bool>(_nodeSelected[row]);
+
     return {};
 }
 
+NodeAttributeTableModel::SortKeysPtr NodeAttributeTableModel::sortKeys(size_t column) const
+{
+    if(column >= _data.size() || _data.at(column) == nullptr)
+        return nullptr;
+
+    return _data.at(column)->_sortKeys;
+}
+
 void NodeAttributeTableModel::onSelectionChanged()
 {
-    updateColumn(Roles::NodeSelectedRole, _nodeSelectedColumn);
+    updateNodeSelected();
     emit selectionChanged();
 }
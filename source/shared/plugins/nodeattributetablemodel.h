@@ -22,6 +22,7 @@
 #include "shared/graph/elementid.h"
 #include "shared/ui/idocument.h"
 #include "shared/plugins/userelementdata.h"
+#include "shared/attributes/valuetype.h"
 
 #include <QAbstractTableModel>
 #include <QStringList>
@@ -31,6 +32,7 @@
 #include <vector>
 #include <mutex>
 #include <deque>
+#include <memory>
 
 class Graph;
 class IGraph;
@@ -41,6 +43,13 @@ class NodeAttributeTableModel : public QAbstractTableModel
 
     Q_PROPERTY(QStringList columnNames MEMBER _columnNames NOTIFY columnNamesChanged)
 
+public:
+    // One per row, such that ordering the keys orders the rows as their values
+    // would be ordered; strings are collated in advance, so their key is their
+    // rank, and missing values are NaN, ordered after everything else
+    using SortKeys = std::vector<double>;
+    using SortKeysPtr = std::shared_ptr<const SortKeys>;
+
 private:
     IDocument* _document = nullptr;
     const IGraph* _graph = nullptr;
@@ -50,15 +59,38 @@ private:
     std::recursive_mutex _updateMutex;
     std::vector<QString> _columnsRequiringUpdates;
 
-    using Column = std::vector<QVariant>;
-    using Table = std::vector<Column>;
+    // Values are held in a buffer of their column's type, and are only
+    // wrapped in a QVariant when the view asks for them
+    struct Column
+    {
+        ValueType _type = ValueType::Unknown;
+        std::vector<int> _intValues;
+        std::vector<double> _floatValues;
+        std::vector<QString> _stringValues;
+        std::vector<bool> _valuePresent;
+        SortKeysPtr _sortKeys;
+
+        QVariant value(size_t row) const;
+    };
+
+    // Columns are immutable once built, so publishing them to the UI thread
+    // only copies pointers, and unchanged columns are shared between updates
+    using ColumnPtr = std::shared_ptr<const Column>;
+    using Table = std::vector<ColumnPtr>;
+
+    // The graph doesn't necessarily have a node for every row since
+    // it may have been transformed, leaving empty rows
+    std::vector<bool> _pendingRowPresent;
+    std::vector<bool> _rowPresent;
 
-    Column _nodeSelectedColumn;
-    Column _nodeIdColumn;
+    std::vector<bool> _nodeSelected;
 
     Table _pendingData; // Update actually occurs here, before being copied to _data on the UI thread
     Table _data;
 
+    // Set when the columns themselves have changed, as opposed to their values
+    bool _resetRequired = true;
+
     QStringList _columnNames;
 
     int _columnCount = 0;
@@ -73,7 +105,10 @@ private:
     void onColumnAdded(size_t columnIndex);
     void onColumnRemoved(size_t columnIndex);
     void updateAttribute(const QString& attributeName);
-    void updateColumn(int role, Column& column, const QString& columnName = {});
+    std::vector<bool> rowPresence() const;
+    ColumnPtr makeColumn(const QString& columnName) const;
+    static SortKeysPtr sortKeysFor(const Column& column);
+    void updateNodeSelected();
     void update();
 
 private slots:
@@ -96,6 +131,9 @@ public:
 
     QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
 
+    // May be null, if the column has not yet been populated
+    SortKeysPtr sortKeys(size_t column) const;
+
     QHash<int, QByteArray> roleNames() const override { return _roleNames; }
 
     void onSelectionChanged();
@@ -19,6 +19,108 @@
 #include "tableproxymodel.h"
 #include "nodeattributetablemodel.h"
 
+#include "shared/utils/doasyncthen.h"
+#include "shared/utils/threadpool.h"
+
+#include <QPointer>
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <thread>
+
+namespace
+{
+using SortKeysAndOrder = std::pair<NodeAttributeTableModel::SortKeysPtr, Qt::SortOrder>;
+
+bool sortKeyLessThan(double a, double b)
+{
+    // Missing values (NaN) are greater than everything else
+    if(std::isnan(a))
+        return false;
+
+    if(std::isnan(b))
+        return true;
+
+    return a < b;
+}
+
+// Returns the position of each row when sorted by the given columns in turn, with
+// any remaining ties broken by row, so that the result matches a stable sort
+std::vector<int> sortedRowRanks(const std::vector<SortKeysAndOrder>& sortKeysAndOrders, size_t numRows)
+{
+    auto lessThan = [&sortKeysAndOrders](int a, int b)
+    {
+        for(const auto& [sortKeys, order] : sortKeysAndOrders)
+        {
+            auto keyA = (*sortKeys)[static_cast<size_t>(a)];
+            auto keyB = (*sortKeys)[static_cast<size_t>(b)];
+
+            if(keyA == keyB || (std::isnan(keyA) && std::isnan(keyB)))
+                continue;
+
+            return order == Qt::DescendingOrder ?
+                sortKeyLessThan(keyB, keyA) :
+                sortKeyLessThan(keyA, keyB);
+        }
+
+        return a < b;
+    };
+
+    std::vector<int> rows(numRows);
+    std::iota(rows.begin(), rows.end(), 0);
+
+    // Sort chunks concurrently, then merge neighbouring pairs of chunks until one remains
+    const auto numChunks = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    const auto chunkSize = std::max<size_t>((numRows + numChunks - 1) / numChunks, 1);
+
+    std::vector<std::pair<size_t, size_t>> chunks;
+    for(size_t first = 0; first < numRows; first += chunkSize)
+        chunks.emplace_back(first, std::min(first + chunkSize, numRows));
+
+    if(!chunks.empty())
+    {
+        concurrent_for(chunks.begin(), chunks.end(), [&](const std::pair<size_t, size_t>& chunk)
+        {
+            std::sort(rows.begin() + static_cast<std::ptrdiff_t>(chunk.first),
+                rows.begin() + static_cast<std::ptrdiff_t>(chunk.second), lessThan);
+        });
+    }
+
+    while(chunks.size() > 1)
+    {
+        std::vector<std::pair<size_t, size_t>> merged;
+        std::vector<size_t> pairs;
+
+        for(size_t i = 0; i < chunks.size(); i += 2)
+        {
+            if(i + 1 < chunks.size())
+            {
+                merged.emplace_back(chunks[i].first, chunks[i + 1].second);
+                pairs.push_back(i);
+            }
+            else
+                merged.push_back(chunks[i]);
+        }
+
+        concurrent_for(pairs.begin(), pairs.end(), [&](size_t i)
+        {
+            std::inplace_merge(rows.begin() + static_cast<std::ptrdiff_t>(chunks[i].first),
+                rows.begin() + static_cast<std::ptrdiff_t>(chunks[i].second),
+                rows.begin() + static_cast<std::ptrdiff_t>(chunks[i + 1].second), lessThan);
+        });
+
+        chunks = std::move(merged);
+    }
+
+    std::vector<int> ranks(numRows);
+    for(size_t i = 0; i < numRows; i++)
+        ranks[static_cast<size_t>(rows[i])] = static_cast<int>(i);
+
+    return ranks;
+}
+} // namespace
+
 bool TableProxyModel::filterAcceptsRow(int sourceRow, const QModelIndex &sourceParent) const
 {
     return sourceModel()->data(sourceModel()->index(sourceRow, 0, sourceParent),
@@ -97,7 +199,6 @@ int TableProxyModel::mapOrderedToSourceColumn(int proxyColumn) const
 TableProxyModel::TableProxyModel(QObject *parent) : QSortFilterProxyModel(parent)
 {
     connect(this, &QAbstractProxyModel::sourceModelChanged, this, &TableProxyModel::updateSourceModelFilter);
-    _collator.setNumericMode(true);
 }
 
 void TableProxyModel::setHiddenColumns(std::vector<int> hiddenColumns)
@@ -223,6 +324,9 @@ void TableProxyModel::invalidateFilter()
     calculateOrderedProxySourceMapping();
     calculateUnorderedSourceProxyColumnMapping();
     endResetModel();
+
+    // The source data may have changed, so the order needs to be determined again
+    resort();
 }
 
 void TableProxyModel::updateSourceModelFilter()
@@ -236,44 +340,58 @@ void TableProxyModel::updateSourceModelFilter()
 
 void TableProxyModel::resort()
 {
-    invalidate();
-
-    // The parameters to this don't really matter, because the actual ordering is determined
-    // by the implementation of lessThan, in combination with the contents of _sortColumnAndOrders
-    sort(0);
-}
+    auto* nodeAttributeTableModel = qobject_cast<NodeAttributeTableModel*>(sourceModel());
+    if(nodeAttributeTableModel == nullptr)
+        return;
 
-bool TableProxyModel::lessThan(const QModelIndex& a, const QModelIndex& b) const
-{
-    auto rowA = a.row();
-    auto rowB = b.row();
+    std::vector<SortKeysAndOrder> sortKeysAndOrders;
+    auto numRows = static_cast<size_t>(nodeAttributeTableModel->rowCount());
 
-    for(const auto& sortColumnAndOrder : _sortColumnAndOrders)
+    for(const auto& [sortColumn, order] : _sortColumnAndOrders)
     {
-        auto column = _unorderedSourceToProxyColumn.at(sortColumnAndOrder.first);
-        auto order = sortColumnAndOrder.second;
-
-        auto indexA = sourceModel()->index(rowA, column);
-        auto indexB = sourceModel()->index(rowB, column);
-
-        auto valueA = sourceModel()->data(indexA, Qt::DisplayRole);
-        auto valueB = sourceModel()->data(indexB, Qt::DisplayRole);
+        if(sortColumn < 0 || static_cast<size_t>(sortColumn) >= _unorderedSourceToProxyColumn.size())
+            continue;
 
-        if(valueA == valueB)
+        auto column = _unorderedSourceToProxyColumn.at(static_cast<size_t>(sortColumn));
+        if(column < 0)
             continue;
 
-        if(static_cast<QMetaType::Type>(valueA.type()) == QMetaType::QString &&
-            static_cast<QMetaType::Type>(valueB.type()) == QMetaType::QString)
-        {
-            return order == Qt::DescendingOrder ?
-                _collator.compare(valueB.toString(), valueA.toString()) < 0 :
-                _collator.compare(valueA.toString(), valueB.toString()) < 0;
-        }
+        auto sortKeys = nodeAttributeTableModel->sortKeys(static_cast<size_t>(column));
+        if(sortKeys == nullptr || sortKeys->size() != numRows)
+            continue;
 
-        return order == Qt::DescendingOrder ?
-            QSortFilterProxyModel::lessThan(indexB, indexA) :
-            QSortFilterProxyModel::lessThan(indexA, indexB);
+        sortKeysAndOrders.emplace_back(sortKeys, order);
     }
 
-    return false;
+    // Any sort that's in progress is now out of date
+    auto sortGeneration = ++_sortGeneration;
+
+    u::doAsync([sortKeysAndOrders, numRows]
+    {
+        return sortedRowRanks(sortKeysAndOrders, numRows);
+    }).then([self = QPointer<TableProxyModel>(this), sortGeneration](const std::vector<int>& ranks)
+    {
+        if(self == nullptr || sortGeneration != self->_sortGeneration)
+            return;
+
+        self->_sourceRowRanks = ranks;
+        self->invalidate();
+
+        // The parameters to this don't really matter, because the actual ordering is determined
+        // by the implementation of lessThan, in combination with _sourceRowRanks
+        self->sort(0);
+    });
+}
+
+bool TableProxyModel::lessThan(const QModelIndex& a, const QModelIndex& b) const
+{
+    auto rowA = static_cast<size_t>(a.row());
+    auto rowB = static_cast<size_t>(b.row());
+
+    // The ranks are for a different number of rows, so they're out of date; use the source
+    // order until the ranks for the current data arrive, when everything will be resorted
+    if(rowA >= _sourceRowRanks.size() || rowB >= _sourceRowRanks.size())
+        return rowA < rowB;
+
+    return _sourceRowRanks[rowA] < _sourceRowRanks[rowB];
 }
@@ -28,10 +28,10 @@
 #include <QDebug>
 #include <QItemSelectionRange>
 #include <QStandardItemModel>
-#include <QCollator>
 
 #include <deque>
 #include <utility>
+#include <vector>
 
 // As QSortFilterProxyModel cannot set column orders, we do it ourselves by translating columns
 // in the data() function. This has a number of consequences regarding proxy/source mappings.
@@ -65,9 +65,13 @@ private:
     std::vector<int> _orderedProxyToSourceColumn;
     std::vector<int> _unorderedSourceToProxyColumn;
 
-    QCollator _collator;
     std::deque<std::pair<int, Qt::SortOrder>> _sortColumnAndOrders;
 
+    // The position of each source row in the sorted order, which is determined
+    // on a worker thread; lessThan then only needs to compare these
+    std::vector<int> _sourceRowRanks;
+    int _sortGeneration = 0;
+
     enum Roles
     {
         SubSelectedRole = Qt::UserRole + 999
@@ -0,0 +1,97 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef ELEMENTVISUAL_H
+#define ELEMENTVISUAL_H
+
+#include "shared/utils/flags.h"
+#include "shared/utils/stringtable.h"
+
+#include <QColor>
+
+#include <cstdint>
+#include <type_traits>
+
+enum VisualFlags : uint8_t
+{
+    None          = 0x0,
+    Selected      = 0x1,
+    Unhighlighted = 0x2
+};
+
+// A colour packed as 8 bits per channel, in the RGBA byte order that the
+// GPU consumes; an invalid QColor is packed as all zeros
+struct PackedColor
+{
+    uint8_t _rgba[4] = {0, 0, 0, 0};
+
+    PackedColor() = default;
+
+    // cppcheck-suppress noExplicitConstructor
+    PackedColor(const QColor& color) // NOLINT
+    {
+        if(!color.isValid())
+            return;
+
+        _rgba[0] = static_cast<uint8_t>(color.red());
+        _rgba[1] = static_cast<uint8_t>(color.green());
+        _rgba[2] = static_cast<uint8_t>(color.blue());
+        _rgba[3] = static_cast<uint8_t>(color.alpha());
+    }
+
+    // Fully transparent black is indistinguishable from an unset colour
+    bool isValid() const { return _rgba[0] != 0 || _rgba[1] != 0 || _rgba[2] != 0 || _rgba[3] != 0; }
+
+    QColor toColor() const
+    {
+        if(!isValid())
+            return {};
+
+        return QColor(_rgba[0], _rgba[1], _rgba[2], _rgba[3]);
+    }
+
+    bool operator==(const PackedColor& other) const
+    {
+        return _rgba[0] == other._rgba[0] && _rgba[1] == other._rgba[1] &&
+            _rgba[2] == other._rgba[2] && _rgba[3] == other._rgba[3];
+    }
+
+    bool operator!=(const PackedColor& other) const { return !operator==(other); }
+};
+
+// The visual attributes of a node or edge, kept compact and trivially copyable
+// so that the renderer can walk them quickly; text is held as a handle into
+// the StringTable owned by the GraphModel
+struct ElementVisual
+{
+    float _size = -1.0f;
+    PackedColor _outerColor;
+    PackedColor _innerColor;
+    StringTable::Handle _text = StringTable::Empty;
+    Flags<VisualFlags> _state = VisualFlags::None;
+
+    float size() const { return _size; }
+    QColor outerColor() const { return _outerColor.toColor(); }
+    QColor innerColor() const { return _innerColor.toColor(); }
+    StringTable::Handle text() const { return _text; }
+    Flags<VisualFlags> state() const { return _state; }
+};
+
+static_assert(std::is_trivially_copyable_v<ElementVisual>);
+
+#endif // ELEMENTVISUAL_H
@@ -0,0 +1,97 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SCRATCHARRAY_H
+#define SCRATCHARRAY_H
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#include <QtGlobal>
+
+// A fixed size array for temporary per-pass state, typically one per worker
+// thread, that can be reset to its default value in constant time. Each element
+// carries the generation in which it was last written; an element stamped with
+// an older generation reads as the default value, so a pass that touches few
+// elements doesn't pay for clearing the whole array; use uint8_t rather than
+// bool, since std::vector<bool> can't hand out references to its elements
+template<typename T> class ScratchArray
+{
+    static_assert(!std::is_same_v<T, bool>, "ScratchArray<bool> is not supported, use uint8_t");
+
+private:
+    std::vector<T> _values;
+    std::vector<uint32_t> _generations;
+    uint32_t _generation = 1;
+    T _defaultValue;
+
+public:
+    explicit ScratchArray(size_t size = 0, const T& defaultValue = T()) :
+        _values(size, defaultValue),
+        _generations(size, 0),
+        _defaultValue(defaultValue)
+    {}
+
+    size_t size() const { return _values.size(); }
+
+    void resize(size_t size)
+    {
+        _values.resize(size, _defaultValue);
+        _generations.resize(size, 0);
+    }
+
+    void reset()
+    {
+        _generation++;
+
+        if(_generation == 0)
+        {
+            // Wrapped around, so the stamps must be cleared for real
+            std::fill(_generations.begin(), _generations.end(), 0);
+            _generation = 1;
+        }
+    }
+
+    bool touched(size_t index) const
+    {
+        Q_ASSERT(index < _values.size());
+        return _generations[index] == _generation;
+    }
+
+    const T& get(size_t index) const
+    {
+        return touched(index) ? _values[index] : _defaultValue;
+    }
+
+    T& operator[](size_t index)
+    {
+        if(!touched(index))
+        {
+            _values[index] = _defaultValue;
+            _generations[index] = _generation;
+        }
+
+        return _values[index];
+    }
+
+    const T& operator[](size_t index) const { return get(index); }
+};
+
+#endif // SCRATCHARRAY_H
@@ -0,0 +1,128 @@
+/* Copyright © 2013-2020 Graphia Technologies Ltd.
+ *
+ * This file is part of Graphia.
+ *
+ * Graphia is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Graphia is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with Graphia.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STRINGTABLE_H
+#define STRINGTABLE_H
+
+#include <QString>
+#include <QHash>
+#include <QtGlobal>
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Interns strings so that they can be referred to by a small integer handle.
+// The empty string always has the handle Empty. The table only ever grows, so
+// users that repeatedly intern changing sets of strings should periodically
+// build a new table containing only the strings they still refer to, and
+// replace the old one with it. Readers on other threads should not use the
+// table directly, but instead take a Snapshot, which can be read without locking.
+class StringTable
+{
+public:
+    using Handle = uint32_t;
+    static constexpr Handle Empty = 0;
+
+    // An immutable copy of the strings in a table, at the time it was taken
+    class Snapshot
+    {
+        friend class StringTable;
+
+    private:
+        std::shared_ptr<const std::vector<QString>> _strings;
+
+    public:
+        // Handles that were issued after the snapshot was taken resolve to the empty string
+        const QString& at(Handle handle) const
+        {
+            static const QString empty;
+
+            if(_strings == nullptr || handle >= _strings->size())
+                return empty;
+
+            return (*_strings)[handle];
+        }
+
+        size_t size() const { return _strings != nullptr ? _strings->size() : 0; }
+    };
+
+private:
+    mutable std::mutex _mutex;
+    std::deque<QString> _strings{QString()};
+    QHash<QString, Handle> _handles;
+
+public:
+    Handle intern(const QString& string)
+    {
+        if(string.isEmpty())
+            return Empty;
+
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        auto it = _handles.constFind(string);
+        if(it != _handles.constEnd())
+            return it.value();
+
+        auto handle = static_cast<Handle>(_strings.size());
+        _strings.push_back(string);
+        _handles.insert(string, handle);
+
+        return handle;
+    }
+
+    const QString& at(Handle handle) const
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        Q_ASSERT(handle < _strings.size());
+        return _strings[handle];
+    }
+
+    size_t size() const
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        return _strings.size();
+    }
+
+    // Takes the contents of other, invalidating every handle previously issued by this table
+    void replaceWith(StringTable&& other)
+    {
+        std::scoped_lock lock(_mutex, other._mutex);
+
+        _strings = std::move(other._strings);
+        _handles = std::move(other._handles);
+
+        other._strings = {QString()};
+        other._handles.clear();
+    }
+
+    Snapshot snapshot() const
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+
+        Snapshot snapshot;
+        snapshot._strings = std::make_shared<const std::vector<QString>>(_strings.begin(), _strings.end());
+
+        return snapshot;
+    }
+};
+
+#endif // STRINGTABLE_H
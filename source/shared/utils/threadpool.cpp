@@ -20,32 +20,45 @@
 
 #include "thread.h"
 
+namespace
+{
+thread_local const ThreadPool* currentThreadPool = nullptr;
+thread_local int currentThreadPoolIndex = -1;
+thread_local int currentIndexedChunkDepth = 0;
+} // namespace
+
 ThreadPool::ThreadPool(const QString& threadNamePrefix, unsigned int numThreads) :
-    _stop(false), _activeThreads(0)
+    _numQueuedTasks(0), _nextWorkerIndex(0), _stop(false), _activeThreads(0)
 {
+    // There must always be at least one thread to execute tasks on
+    numThreads = std::max(numThreads, 1U);
+
+    for(unsigned int i = 0U; i < numThreads; i++)
+        _workers.emplace_back(std::make_unique<Worker>());
+
     for(unsigned int i = 0U; i < numThreads; i++)
     {
         _threads.emplace_back([threadNamePrefix, i, this]
             {
                 u::setCurrentThreadName(QStringLiteral("%1%2").arg(threadNamePrefix).arg(i + 1));
 
+                currentThreadPool = this;
+                currentThreadPoolIndex = static_cast<int>(i);
+
                 while(!_stop)
                 {
-                    std::unique_lock<std::mutex> lock(_mutex);
+                    Task task;
 
-                    if(!_tasks.empty())
+                    if(takeTask(i, task))
                     {
-                        auto task = _tasks.front();
-                        _tasks.pop();
-                        lock.unlock();
                         task();
                         _activeThreads--;
+                        continue;
                     }
-                    else if(!_stop)
-                    {
-                        // Block until a new task is queued
-                        _waitForNewTask.wait(lock);
-                    }
+
+                    // Block until a new task is queued
+                    std::unique_lock<std::mutex> lock(_mutex);
+                    _waitForNewTask.wait(lock, [this] { return _stop || _numQueuedTasks > 0; });
                 }
             });
     }
@@ -56,8 +69,11 @@ ThreadPool::~ThreadPool()
     // Cancel all pending tasks
     std::unique_lock<std::mutex> lock(_mutex);
     _stop = true;
-    while(!_tasks.empty())
-        _tasks.pop();
+    for(auto& worker : _workers)
+    {
+        std::unique_lock<std::mutex> workerLock(worker->_mutex);
+        worker->_tasks.clear();
+    }
     lock.unlock();
 
     // Tell all idle threads to unblock
@@ -70,3 +86,99 @@ ThreadPool::~ThreadPool()
             thread.join();
     }
 }
+
+int ThreadPool::currentThreadIndex() const
+{
+    return currentThreadPool == this ? currentThreadPoolIndex : -1;
+}
+
+void ThreadPool::enterIndexedChunk()
+{
+    currentIndexedChunkDepth++;
+}
+
+void ThreadPool::leaveIndexedChunk()
+{
+    Q_ASSERT(currentIndexedChunkDepth > 0);
+    currentIndexedChunkDepth--;
+}
+
+bool ThreadPool::inIndexedChunk() const
+{
+    return currentIndexedChunkDepth > 0;
+}
+
+void ThreadPool::enqueue(Task&& task)
+{
+    // Tasks created by one of our own threads are kept on that thread's deque, so
+    // that nested work stays local; anything else is distributed round robin
+    auto threadIndex = currentThreadIndex();
+    auto workerIndex = threadIndex >= 0 ? static_cast<size_t>(threadIndex) :
+        _nextWorkerIndex++ % _workers.size();
+
+    auto& worker = *_workers.at(workerIndex);
+
+    {
+        std::unique_lock<std::mutex> lock(worker._mutex);
+        worker._tasks.push_back(std::move(task));
+    }
+
+    _numQueuedTasks++;
+
+    {
+        // Taking the lock here ensures a thread that is about to wait
+        // doesn't miss the notification
+        std::unique_lock<std::mutex> lock(_mutex);
+    }
+
+    // Wake a thread up
+    _waitForNewTask.notify_one();
+}
+
+bool ThreadPool::takeTask(size_t workerIndex, Task& task)
+{
+    const auto numWorkers = _workers.size();
+
+    for(size_t i = 0; i < numWorkers; i++)
+    {
+        auto& worker = *_workers.at((workerIndex + i) % numWorkers);
+        std::unique_lock<std::mutex> lock(worker._mutex);
+
+        if(worker._tasks.empty())
+            continue;
+
+        if(i == 0)
+        {
+            // Our own deque
+            task = std::move(worker._tasks.front());
+            worker._tasks.pop_front();
+        }
+        else
+        {
+            // Steal from someone else's
+            task = std::move(worker._tasks.back());
+            worker._tasks.pop_back();
+        }
+
+        _numQueuedTasks--;
+        return true;
+    }
+
+    return false;
+}
+
+bool ThreadPool::runPendingTask()
+{
+    auto threadIndex = currentThreadIndex();
+    if(threadIndex < 0)
+        return false;
+
+    Task task;
+    if(!takeTask(static_cast<size_t>(threadIndex), task))
+        return false;
+
+    task();
+    _activeThreads--;
+
+    return true;
+}
@@ -23,17 +23,20 @@
 #include "function_traits.h"
 #include "is_std_container.h"
 #include "is_detected.h"
+#include "scope_exit.h"
 
 #include <QString>
+#include <QtGlobal>
 
 #include <algorithm>
 #include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <deque>
 #include <functional>
 #include <future>
 #include <memory>
 #include <mutex>
-#include <queue>
 #include <thread>
 #include <vector>
 #include <utility>
@@ -42,13 +45,69 @@
 class ThreadPool
 {
 private:
+    using Task = std::function<void()>;
+
+    // Each thread has its own deque of tasks; it takes work from the front of its own
+    // deque and, when that is empty, steals from the back of the other threads' deques
+    struct Worker
+    {
+        std::mutex _mutex;
+        std::deque<Task> _tasks;
+    };
+
     std::vector<std::thread> _threads;
+    std::vector<std::unique_ptr<Worker>> _workers;
     std::mutex _mutex;
     std::condition_variable _waitForNewTask;
-    std::queue<std::function<void()>> _tasks;
+    std::atomic<int> _numQueuedTasks;
+    std::atomic<size_t> _nextWorkerIndex;
     std::atomic<bool> _stop;
     std::atomic<int> _activeThreads;
 
+    void enqueue(Task&& task);
+    bool takeTask(size_t workerIndex, Task& task);
+
+    // Execute a single queued task on the calling thread, if it is one of ours
+    bool runPendingTask();
+
+    // Tracks whether the calling thread is executing a chunk whose body takes a thread index
+    void enterIndexedChunk();
+    void leaveIndexedChunk();
+    bool inIndexedChunk() const;
+
+    template<typename T>
+    void waitForFuture(const std::future<T>& future)
+    {
+        if(currentThreadIndex() < 0)
+        {
+            future.wait();
+            return;
+        }
+
+        // Helping below may run a chunk of some other concurrent_for on this thread, with
+        // the same thread index as the body that is waiting, clobbering its per thread state
+        Q_ASSERT(!inIndexedChunk());
+
+        // When waiting on one of our own threads (i.e. a nested concurrent_for), help with
+        // the queued work instead of blocking, otherwise all the threads could end up
+        // waiting on tasks that none of them are free to execute
+        using namespace std::chrono_literals;
+        int failedSteals = 0;
+        while(future.wait_for(0s) != std::future_status::ready)
+        {
+            if(runPendingTask())
+                failedSteals = 0;
+            else if(++failedSteals < 16)
+                std::this_thread::yield();
+            else
+            {
+                // There's been nothing to steal for a while, so block on the future rather
+                // than keep a core busy, waking occasionally in case more work is queued
+                future.wait_for(100us);
+            }
+        }
+    }
+
 public:
     explicit ThreadPool(const QString& threadNamePrefix = QStringLiteral("Worker"),
         unsigned int numThreads = std::thread::hardware_concurrency());
@@ -62,6 +121,11 @@ public:
     bool saturated() const { return _activeThreads >= static_cast<int>(_threads.size()); }
     bool idle() const { return _activeThreads == 0; }
 
+    // The index of the calling thread within the pool, or -1 if it isn't a pool thread
+    int currentThreadIndex() const;
+
+    size_t numThreads() const { return _threads.size(); }
+
     template<typename Fn, typename... Args> using ReturnType = typename std::invoke_result_t<Fn, Args...>;
 
     template<typename Fn, typename... Args> std::future<ReturnType<Fn, Args...>> makeFuture(Fn f, Args&&... args)
@@ -71,18 +135,12 @@ public:
 
         auto taskPtr = std::make_shared<std::packaged_task<ReturnType<Fn, Args...>(Args...)>>(f);
 
+        _activeThreads++;
+        enqueue([taskPtr, args...]() mutable
         {
-            std::unique_lock<std::mutex> lock(_mutex);
-            _tasks.push(
-                [taskPtr, args...]() mutable
-                {
-                    (*taskPtr)(std::forward<Args>(args)...);
-                });
-        }
+            (*taskPtr)(std::forward<Args>(args)...);
+        });
 
-        // Wake a thread up
-        _waitForNewTask.notify_one();
-        _activeThreads++;
         return taskPtr->get_future();
     }
 
@@ -107,10 +165,11 @@ private:
         friend class ThreadPool;
 
     private:
+        ThreadPool* _threadPool = nullptr;
         mutable std::vector<std::future<ResultsVectorOrVoid>> _futures;
 
-        explicit ResultsType(std::vector<std::future<ResultsVectorOrVoid>>&& futures) :
-            _futures(std::move(futures))
+        ResultsType(ThreadPool* threadPool, std::vector<std::future<ResultsVectorOrVoid>>&& futures) :
+            _threadPool(threadPool), _futures(std::move(futures))
         {}
 
     public:
@@ -118,7 +177,7 @@ private:
         {
             for(auto& future : _futures)
             {
-                future.wait();
+                _threadPool->waitForFuture(future);
 
                 if constexpr(!std::is_void_v<ResultsVectorOrVoid>)
                     this->_values.emplace_back(std::move(future.get()));
@@ -471,21 +530,30 @@ public:
     template<typename It, typename Fn> using Results =
         ResultsType<typename Executor<It, Fn>::ResultsVectorOrVoid>;
 
+    static constexpr uint64_t MaxChunksPerThread = 16;
+
     enum ResultsPolicy
     {
         Blocking,
         NonBlocking
     };
 
+    // The range is divided into chunks of decreasing cost; the large early chunks keep
+    // the scheduling overhead low, while the small later chunks give idle threads
+    // something to steal when the cost of each element is uneven
+    // Where Fn takes a thread index argument, it is the index of the pool thread that
+    // is executing the element, so it is always less than numThreads(); such a body
+    // must not block on other pool work (e.g. a nested concurrent_for), since the
+    // waiting thread would execute queued chunks under the same index
     template<typename It, typename Fn>
     auto concurrent_for(It first, It last, Fn f, ResultsPolicy resultsPolicy = Blocking)
     {
         Coster<It> coster(first, last);
 
         const auto totalCost = coster.total(); Q_ASSERT(totalCost > 0);
-        const auto numThreads = static_cast<int>(_threads.size());
-        const auto costPerThread = totalCost / numThreads +
-                ((totalCost % numThreads) ? 1 : 0);
+        const auto numThreads = static_cast<uint64_t>(_threads.size());
+        const auto minimumChunkCost = std::max<uint64_t>(totalCost /
+            (numThreads * MaxChunksPerThread), 1);
 
         static_assert(std::is_convertible_v<FirstArgumentType<Fn>, It> ||
             std::is_convertible_v<FirstArgumentType<Fn>, typename It::value_type>,
@@ -496,32 +564,42 @@ public:
 
         Executor<It, Fn> executor;
         std::vector<std::future<typename Executor<It, Fn>::ResultsVectorOrVoid>> futures;
-        size_t threadIndex = 0;
+        uint64_t remainingCost = totalCost;
 
         for(It it = first; it != last;)
         {
-            It threadLast = it;
+            const auto chunkCost = std::max(remainingCost / (numThreads * 2), minimumChunkCost);
+
+            It chunkLast = it;
             uint64_t cost = 0;
             do
             {
-                cost += coster(threadLast);
-                ++threadLast;
+                cost += coster(chunkLast);
+                ++chunkLast;
             }
-            while(threadLast != last && cost < costPerThread);
-
-            Q_ASSERT(threadIndex < _threads.size());
+            while(chunkLast != last && cost < chunkCost);
 
-            futures.emplace_back(makeFuture([executor, it, threadLast, f, threadIndex]() mutable
+            futures.emplace_back(makeFuture([this, executor, it, chunkLast, f]() mutable
             {
-                executor.setIndex(threadIndex);
-                return executor(it, threadLast, f);
+                auto threadIndex = currentThreadIndex(); Q_ASSERT(threadIndex >= 0);
+                executor.setIndex(static_cast<size_t>(threadIndex));
+
+                if constexpr(HasThreadIndexArgument<Fn>)
+                {
+                    enterIndexedChunk();
+                    auto atExit = std::experimental::make_scope_exit([this] { leaveIndexedChunk(); });
+
+                    return executor(it, chunkLast, f);
+                }
+                else
+                    return executor(it, chunkLast, f);
             }));
 
-            it = threadLast;
-            threadIndex++;
+            remainingCost -= std::min(cost, remainingCost);
+            it = chunkLast;
         }
 
-        auto results = Results<It, Fn>(std::move(futures));
+        auto results = Results<It, Fn>(this, std::move(futures));
 
         if(resultsPolicy == Blocking)
             results.wait();